@@ -0,0 +1,264 @@
+#define _GNU_SOURCE
+#include "bcast_ring.h"
+#include <string.h>
+#include <time.h>
+
+bcast_ring_t* bcastCreate(uint32_t count, uint32_t entry_size)
+{
+    if (count == 0 || (count & (count - 1)) != 0 || entry_size == 0) return NULL;
+
+    bcast_ring_t* ring = (bcast_ring_t*)calloc(1, sizeof(bcast_ring_t));
+    if (ring == NULL) return NULL;
+
+    // entries rounded up to whole cache lines so neighbouring entries never share one
+    ring->entry_size = (entry_size + 63) & ~63u;
+    ring->entries = (uint8_t*)aligned_alloc(64, (size_t)count * ring->entry_size);
+    if (ring->entries == NULL)
+    {
+        free(ring);
+        return NULL;
+    }
+    memset(ring->entries, 0, (size_t)count * ring->entry_size);
+
+    ring->mask = count - 1;
+    atomic_init(&ring->claim, 0);
+    atomic_init(&ring->cursor, 0);
+    atomic_init(&ring->running, true);
+    atomic_init(&ring->sleepers, 0);
+    pthread_mutex_init(&ring->lock, NULL);
+    pthread_cond_init(&ring->cond, NULL);
+    return ring;
+} // end bcastCreate()
+
+int bcastAddSink(bcast_ring_t* ring, const char* name, bcast_handler_fn handler, void* arg,
+                 enum BCAST_WAIT wait, enum BCAST_POLICY policy)
+{
+    if (ring->started || ring->sink_count == BCAST_MAX_SINKS) return -1;
+
+    bcast_sink_t* sink = &ring->sinks[ring->sink_count];
+    atomic_init(&sink->seq, 0);
+    sink->ring = ring;
+    strncpy(sink->name, name, sizeof(sink->name) - 1);
+    sink->handler = handler;
+    sink->arg = arg;
+    sink->wait = wait;
+    sink->policy = policy;
+    return ring->sink_count++;
+} // end bcastAddSink()
+
+static inline void* bcastEntry(bcast_ring_t* ring, uint64_t seq)
+{
+    return ring->entries + (size_t)(seq & ring->mask) * ring->entry_size;
+}
+
+/**Function: bcastWait
+ * Description: Waits by the sink's strategy until an entry past seq is published or the ring
+ *              is stopped. Returns the published count seen.
+ */
+static uint64_t bcastWait(bcast_sink_t* sink, uint64_t seq)
+{
+    bcast_ring_t* ring = sink->ring;
+    struct timespec nap = {.tv_sec = 0, .tv_nsec = BCAST_SLEEP_NSEC};
+    uint64_t avail;
+
+    while ((avail = atomic_load_explicit(&ring->cursor, memory_order_acquire)) == seq &&
+           atomic_load(&ring->running))
+    {
+        switch (sink->wait)
+        {
+        case BCAST_WAIT_SPIN:
+            break;
+        case BCAST_WAIT_YIELD:
+            sched_yield();
+            break;
+        case BCAST_WAIT_SLEEP:
+            nanosleep(&nap, NULL);
+            break;
+        case BCAST_WAIT_BLOCK:
+            // sleepers is raised before the re-check; bcastPublish() stores cursor before
+            // reading sleepers, so one of the two always sees the other
+            pthread_mutex_lock(&ring->lock);
+            atomic_fetch_add(&ring->sleepers, 1);
+            while (atomic_load(&ring->cursor) == seq && atomic_load(&ring->running))
+            {
+                pthread_cond_wait(&ring->cond, &ring->lock);
+            }
+            atomic_fetch_sub(&ring->sleepers, 1);
+            pthread_mutex_unlock(&ring->lock);
+            break;
+        }
+    }
+    return avail;
+} // end bcastWait()
+
+// Sink thread; handles entries until the ring is stopped and every published entry is handled
+static void* bcastSinkMain(void* arg)
+{
+    bcast_sink_t* sink = (bcast_sink_t*)arg;
+    bcast_ring_t* ring = sink->ring;
+    uint64_t size = (uint64_t)ring->mask + 1;
+    uint64_t seq = atomic_load_explicit(&sink->seq, memory_order_relaxed);
+
+    // dropping sinks handle a private copy, so the producer may overwrite the ring entry
+    uint8_t* copy = (sink->policy == BCAST_DROP) ? (uint8_t*)malloc(ring->entry_size) : NULL;
+    if (sink->policy == BCAST_DROP && copy == NULL) return NULL;
+
+    while (1)
+    {
+        uint64_t avail = bcastWait(sink, seq);
+        if (avail == seq) break; // stopped with nothing left
+
+        if (sink->policy == BCAST_DROP && avail - seq > size)
+        {
+            sink->dropped += avail - size - seq; // overwritten before this sink got to them
+            seq = avail - size;
+        }
+
+        uint64_t end = (avail - seq > BCAST_BATCH_MAX) ? seq + BCAST_BATCH_MAX : avail;
+        for (; seq < end; seq++)
+        {
+            void* entry = bcastEntry(ring, seq);
+            if (copy != NULL)
+            {
+                memcpy(copy, entry, ring->entry_size);
+                atomic_thread_fence(memory_order_acquire);
+                if (atomic_load_explicit(&ring->claim, memory_order_relaxed) > seq + size)
+                {
+                    sink->dropped++; // producer reused the entry while it was copied
+                    continue;
+                }
+                entry = copy;
+            }
+            sink->handler(entry, seq, seq + 1 == end, sink->arg);
+            sink->handled++;
+        }
+
+        // a gating sink releases the whole batch to the producer at once
+        atomic_store_explicit(&sink->seq, seq, memory_order_release);
+    }
+
+    free(copy);
+    return NULL;
+} // end bcastSinkMain()
+
+int bcastStart(bcast_ring_t* ring, const cpu_set_t* cpus)
+{
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    if (cpus != NULL)
+    {
+        pthread_attr_setaffinity_np(&attr, sizeof(cpu_set_t), cpus);
+    }
+
+    ring->started = true;
+    for (int i = 0; i < ring->sink_count; i++)
+    {
+        if (pthread_create(&ring->sinks[i].tid, &attr, &bcastSinkMain, &ring->sinks[i]) != 0)
+        {
+            perror("bcastStart");
+            ring->sink_count = i; // bcastStop() joins only the sinks that were started
+            pthread_attr_destroy(&attr);
+            return -1;
+        }
+    }
+    pthread_attr_destroy(&attr);
+    return 0;
+} // end bcastStart()
+
+void* bcastClaim(bcast_ring_t* ring)
+{
+    uint64_t n = atomic_load_explicit(&ring->claim, memory_order_relaxed);
+    uint64_t size = (uint64_t)ring->mask + 1;
+    struct timespec nap = {.tv_sec = 0, .tv_nsec = BCAST_SLEEP_NSEC};
+
+    // entry n replaces entry n - size; every gating sink must be past it
+    while (n >= ring->gate_seq + size)
+    {
+        uint64_t min_seq = n;
+        for (int i = 0; i < ring->sink_count; i++)
+        {
+            if (ring->sinks[i].policy != BCAST_GATE) continue;
+            uint64_t seq = atomic_load_explicit(&ring->sinks[i].seq, memory_order_acquire);
+            if (seq < min_seq) min_seq = seq;
+        }
+        ring->gate_seq = min_seq;
+        if (n < min_seq + size) break;
+
+        ring->gated_waits++;
+        nanosleep(&nap, NULL);
+    }
+
+    // the claim is visible before the entry changes, so dropping sinks can detect overwrites
+    atomic_store_explicit(&ring->claim, n + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    return bcastEntry(ring, n);
+} // end bcastClaim()
+
+void bcastPublish(bcast_ring_t* ring)
+{
+    atomic_store_explicit(&ring->cursor, atomic_load_explicit(&ring->claim, memory_order_relaxed), memory_order_release);
+
+    atomic_thread_fence(memory_order_seq_cst); // cursor store before sleepers load; see bcastWait()
+    if (atomic_load_explicit(&ring->sleepers, memory_order_relaxed) > 0)
+    {
+        pthread_mutex_lock(&ring->lock);
+        pthread_cond_broadcast(&ring->cond);
+        pthread_mutex_unlock(&ring->lock);
+    }
+} // end bcastPublish()
+
+void bcastSync(bcast_ring_t* ring)
+{
+    uint64_t cursor = atomic_load_explicit(&ring->cursor, memory_order_relaxed);
+    struct timespec nap = {.tv_sec = 0, .tv_nsec = BCAST_SLEEP_NSEC};
+
+    for (int i = 0; i < ring->sink_count; i++)
+    {
+        if (ring->sinks[i].policy != BCAST_GATE) continue;
+        while (atomic_load_explicit(&ring->sinks[i].seq, memory_order_acquire) < cursor)
+        {
+            nanosleep(&nap, NULL);
+        }
+    }
+} // end bcastSync()
+
+void bcastStop(bcast_ring_t* ring)
+{
+    if (ring == NULL) return;
+
+    pthread_mutex_lock(&ring->lock);
+    atomic_store(&ring->running, false);
+    pthread_cond_broadcast(&ring->cond);
+    pthread_mutex_unlock(&ring->lock);
+
+    if (!ring->started) return;
+    for (int i = 0; i < ring->sink_count; i++)
+    {
+        pthread_join(ring->sinks[i].tid, NULL);
+    }
+    ring->started = false;
+} // end bcastStop()
+
+void bcastPrintStats(bcast_ring_t* ring, FILE* stream)
+{
+    uint64_t cursor = atomic_load(&ring->cursor);
+    fprintf(stream, "broadcast ring: %llu published, %llu producer waits\n",
+            (unsigned long long)cursor, (unsigned long long)ring->gated_waits);
+    for (int i = 0; i < ring->sink_count; i++)
+    {
+        bcast_sink_t* sink = &ring->sinks[i];
+        fprintf(stream, "  sink %-8s: %llu handled, %llu behind, %llu dropped\n", sink->name,
+                (unsigned long long)sink->handled,
+                (unsigned long long)(cursor - atomic_load(&sink->seq)),
+                (unsigned long long)sink->dropped);
+    }
+} // end bcastPrintStats()
+
+void bcastDestroy(bcast_ring_t* ring)
+{
+    if (ring == NULL) return;
+    pthread_mutex_destroy(&ring->lock);
+    pthread_cond_destroy(&ring->cond);
+    free(ring->entries);
+    free(ring);
+} // end bcastDestroy()
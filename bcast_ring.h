@@ -0,0 +1,123 @@
+#ifndef _BCAST_RING_H_
+#define _BCAST_RING_H_
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sched.h> // cpu_set_t; define _GNU_SOURCE before any include
+
+#define BCAST_MAX_SINKS 8       // sinks per ring
+#define BCAST_BATCH_MAX 64      // entries handled per batch before a sink publishes its progress
+#define BCAST_SLEEP_NSEC 100000 // BCAST_WAIT_SLEEP poll interval; also the producer's back-off when gated
+
+/** Broadcast ring.
+ *  A single producer writes each entry once, in place, into a ring of fixed-size entries;
+ *  every sink reads the same entries through its own cursor on its own thread. Entries are
+ *  never copied into per-consumer queues and a sink that has fallen behind handles everything
+ *  that is ready in one batch.
+ *
+ *  Each sink chooses how it waits for new entries (enum BCAST_WAIT) and what happens when
+ *  it falls a full ring behind (enum BCAST_POLICY):
+ *    BCAST_GATE - the producer waits before reusing an entry this sink has not handled,
+ *                 so the sink sees every entry; the slowest gating sink sets the pace.
+ *    BCAST_DROP - the producer never waits for this sink; entries it was too slow for are
+ *                 skipped and counted. The sink gets a private copy of each entry, checked
+ *                 after copying, so it never handles an entry overwritten mid-read.
+ *
+ *  Usage: bcastCreate(); bcastAddSink() per sink; bcastStart(); then, on the producer
+ *  thread, bcastClaim() an entry, fill it and bcastPublish() it. bcastStop() lets every
+ *  sink finish the published entries and joins the sink threads.
+ */
+
+enum BCAST_WAIT
+{
+    BCAST_WAIT_SPIN,  // busy-wait; lowest latency, occupies a core
+    BCAST_WAIT_YIELD, // sched_yield() between checks
+    BCAST_WAIT_SLEEP, // sleep BCAST_SLEEP_NSEC between checks
+    BCAST_WAIT_BLOCK  // condition variable; the producer signals only while a sink is waiting
+};
+
+enum BCAST_POLICY
+{
+    BCAST_GATE,
+    BCAST_DROP
+};
+
+/**Sink handler, called on the sink's thread for every entry it handles.
+ * entry is valid only for the duration of the call. end_of_batch is true for the last
+ * entry that was ready, e.g. to flush buffered output.
+ */
+typedef void (*bcast_handler_fn)(void* entry, uint64_t seq, bool end_of_batch, void* arg);
+
+struct BcastRing;
+
+typedef struct BcastSink {
+    _Atomic uint64_t seq;       // next entry to handle; read by the producer when gating
+    uint8_t pad[56];            // keeps seq on its own cache line
+    struct BcastRing* ring;
+    char name[16];
+    bcast_handler_fn handler;
+    void* arg;
+    enum BCAST_WAIT wait;
+    enum BCAST_POLICY policy;
+    uint64_t handled;           // entries handled
+    uint64_t dropped;           // entries skipped (BCAST_DROP only)
+    pthread_t tid;
+} bcast_sink_t;
+
+typedef struct BcastRing {
+    uint8_t* entries;
+    uint32_t entry_size;
+    uint32_t mask;              // entry count - 1
+    _Atomic uint64_t claim;     // entries claimed by the producer
+    _Atomic uint64_t cursor;    // entries published
+    uint64_t gate_seq;          // producer's cached minimum of the gating sinks' seq
+    uint64_t gated_waits;       // producer back-offs because a gating sink was a full ring behind
+    atomic_bool running;        // cleared by bcastStop()
+    atomic_int sleepers;        // BCAST_WAIT_BLOCK sinks waiting on cond
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    bcast_sink_t sinks[BCAST_MAX_SINKS];
+    int sink_count;
+    bool started;
+} bcast_ring_t;
+
+/**Allocates a ring of count entries (a power of 2) of entry_size bytes each.
+ * Returns NULL on failure.
+ */
+bcast_ring_t* bcastCreate(uint32_t count, uint32_t entry_size);
+
+/**Adds a sink calling handler(entry, seq, end_of_batch, arg). Only before bcastStart().
+ * Returns the sink index or -1 if the ring already has BCAST_MAX_SINKS sinks.
+ */
+int bcastAddSink(bcast_ring_t* ring, const char* name, bcast_handler_fn handler, void* arg,
+                 enum BCAST_WAIT wait, enum BCAST_POLICY policy);
+
+// Starts one thread per sink, restricted to cpus if not NULL. Returns 0 or -1 on failure.
+int bcastStart(bcast_ring_t* ring, const cpu_set_t* cpus);
+
+/**Returns the next entry for the producer to fill, waiting while a gating sink has not yet
+ * handled the entry it replaces. Producer thread only; follow with bcastPublish().
+ */
+void* bcastClaim(bcast_ring_t* ring);
+
+// Makes the entry from the last bcastClaim() visible to the sinks
+void bcastPublish(bcast_ring_t* ring);
+
+/**Waits until every gating sink has handled every entry published so far, e.g. so that their
+ * output is complete at the end of an acquisition. Producer thread only.
+ */
+void bcastSync(bcast_ring_t* ring);
+
+// Lets the sinks handle every published entry, then joins their threads
+void bcastStop(bcast_ring_t* ring);
+
+// Prints per-sink progress and drop counts
+void bcastPrintStats(bcast_ring_t* ring, FILE* stream);
+
+// Frees the ring; call bcastStop() first if started
+void bcastDestroy(bcast_ring_t* ring);
+
+#endif
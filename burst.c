@@ -0,0 +1,121 @@
+#define _GNU_SOURCE
+#include "burst.h"
+#include <string.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+burst_t* burstCreate(uint32_t capacity, uint32_t out_size)
+{
+    if (capacity == 0 || out_size == 0) return NULL;
+
+    burst_t* burst = (burst_t*)calloc(1, sizeof(burst_t));
+    if (burst == NULL) return NULL;
+
+    size_t frames_len = (size_t)capacity * sizeof(burst_frame_t);
+    size_t out_len = (size_t)capacity * out_size;
+    burst->frames = (burst_frame_t*)malloc(frames_len);
+    burst->out = (uint8_t*)malloc(out_len);
+    if (burst->frames == NULL || burst->out == NULL)
+    {
+        burstDestroy(burst);
+        return NULL;
+    }
+    burst->capacity = capacity;
+    burst->out_size = out_size;
+
+    // touch every page now so no page fault lands inside the shot loop
+    memset(burst->frames, 0, frames_len);
+    memset(burst->out, 0, out_len);
+    burst->locked = (mlock(burst->frames, frames_len) == 0) && (mlock(burst->out, out_len) == 0);
+    if (!burst->locked)
+    {
+        perror("burstCreate: mlock");
+    }
+
+    return burst;
+} // end burstCreate()
+
+void burstReset(burst_t* burst, uint32_t tick, double time)
+{
+    burst->count = 0;
+    burst->start_tick = tick;
+    burst->start_time = time;
+} // end burstReset()
+
+// one decode thread's share of the frames
+struct BurstRange
+{
+    burst_t* burst;
+    burst_decode_fn decode;
+    void* arg;
+    uint32_t first;
+    uint32_t end;
+};
+
+static void* burstDecodeMain(void* arg)
+{
+    struct BurstRange* range = (struct BurstRange*)arg;
+    for (uint32_t i = range->first; i < range->end; i++)
+    {
+        range->decode(&range->burst->frames[i], i, burstOutput(range->burst, i), range->arg);
+    }
+    return NULL;
+} // end burstDecodeMain()
+
+int burstDecode(burst_t* burst, burst_decode_fn decode, void* arg, int threads, const cpu_set_t* cpus)
+{
+    if (threads < 1) threads = 1;
+    if ((uint32_t)threads > burst->count) threads = burst->count ? burst->count : 1;
+
+    pthread_t tids[threads];
+    struct BurstRange ranges[threads];
+    bool started[threads];
+
+    // time-shared even when called from a real-time thread, since they may occupy every core
+    struct sched_param param = {.sched_priority = 0};
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+    pthread_attr_setschedpolicy(&attr, SCHED_OTHER);
+    pthread_attr_setschedparam(&attr, &param);
+    if (cpus != NULL)
+    {
+        pthread_attr_setaffinity_np(&attr, sizeof(cpu_set_t), cpus);
+    }
+
+    // contiguous ranges keep each thread's output entries apart
+    int running = 0;
+    for (int t = 0; t < threads; t++)
+    {
+        ranges[t] = (struct BurstRange){
+            .burst = burst,
+            .decode = decode,
+            .arg = arg,
+            .first = (uint32_t)((uint64_t)burst->count * t / threads),
+            .end = (uint32_t)((uint64_t)burst->count * (t + 1) / threads)};
+        started[t] = pthread_create(&tids[t], &attr, &burstDecodeMain, &ranges[t]) == 0;
+        running += started[t];
+    }
+    pthread_attr_destroy(&attr);
+
+    // ranges whose thread could not be started are decoded here
+    for (int t = 0; t < threads; t++)
+    {
+        if (started[t]) pthread_join(tids[t], NULL);
+        else burstDecodeMain(&ranges[t]);
+    }
+    return running > 0 ? 0 : -1;
+} // end burstDecode()
+
+void burstDestroy(burst_t* burst)
+{
+    if (burst == NULL) return;
+    if (burst->locked)
+    {
+        munlock(burst->frames, (size_t)burst->capacity * sizeof(burst_frame_t));
+        munlock(burst->out, (size_t)burst->capacity * burst->out_size);
+    }
+    free(burst->frames);
+    free(burst->out);
+    free(burst);
+} // end burstDestroy()
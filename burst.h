@@ -0,0 +1,82 @@
+#ifndef _BURST_H_
+#define _BURST_H_
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <sched.h> // cpu_set_t; define _GNU_SOURCE before any include
+#include "tdc_util.h"
+#include "scan_phase.h"
+
+/** Burst capture.
+ *  During a burst the acquisition loop only stores each shot's raw TDC readout and tick in a
+ *  buffer allocated, pre-faulted and locked in RAM at startup; nothing is queued to other
+ *  threads, so the shot loop shares neither cores nor memory bandwidth with processing.
+ *  After the window closes, burstDecode() converts the frames on several threads at once into
+ *  a second preallocated array of caller-defined output entries, in frame order.
+ */
+
+typedef struct BurstFrame {
+    uint32_t tick;              // gpioTick() when the result was read
+    uint8_t tdc;                // TDC id
+    uint8_t meas_mode;          // CONFIG1 measurement mode bits of the shot
+    uint8_t status;             // enum TDC_MEAS_STATUS
+    uint8_t parity_valid;       // tdcReadResult() verdict; 0 unless status is TDC_MEAS_VALID
+    scan_angle_t scan;          // mirror facet and angle when the shot was fired
+    char raw[TDC_READOUT_LEN];  // readout buffer as filled by tdcReadResult()
+} burst_frame_t;
+
+// Decodes frame number idx into out; called concurrently from the decode threads
+typedef void (*burst_decode_fn)(const burst_frame_t* frame, uint32_t idx, void* out, void* arg);
+
+typedef struct Burst {
+    burst_frame_t* frames;
+    uint8_t* out;               // decoded entries, out_size bytes each
+    uint32_t out_size;
+    uint32_t capacity;          // frames per burst
+    uint32_t count;             // frames recorded in the current burst
+    uint32_t start_tick;        // gpioTick() at the start of the burst
+    double start_time;          // seconds since the epoch at start_tick
+    bool locked;                // buffers are locked in RAM
+} burst_t;
+
+/**Allocates room for capacity frames and as many out_size byte decoded entries, touches every
+ * page and locks them in RAM (a failed lock is reported, not fatal). Returns NULL on failure.
+ */
+burst_t* burstCreate(uint32_t capacity, uint32_t out_size);
+
+// Starts a new burst; tick and time mark its start
+void burstReset(burst_t* burst, uint32_t tick, double time);
+
+// Next frame to fill, or NULL when the burst is full
+static inline burst_frame_t* burstNext(burst_t* burst)
+{
+    return (burst->count < burst->capacity) ? &burst->frames[burst->count++] : NULL;
+}
+
+static inline bool burstFull(const burst_t* burst)
+{
+    return burst->count >= burst->capacity;
+}
+
+// Seconds since the epoch at which frame was recorded
+static inline double burstFrameTime(const burst_t* burst, const burst_frame_t* frame)
+{
+    return burst->start_time + (uint32_t)(frame->tick - burst->start_tick) * 1e-6;
+}
+
+// Decoded entry idx
+static inline void* burstOutput(burst_t* burst, uint32_t idx)
+{
+    return burst->out + (size_t)idx * burst->out_size;
+}
+
+/**Decodes every recorded frame with decode(frame, idx, burstOutput(burst, idx), arg), splitting
+ * the frames into contiguous ranges over threads threads placed on cpus (NULL for any core).
+ * Returns when all frames are decoded; 0 on success, -1 if no thread could be started.
+ */
+int burstDecode(burst_t* burst, burst_decode_fn decode, void* arg, int threads, const cpu_set_t* cpus);
+
+void burstDestroy(burst_t* burst);
+
+#endif
@@ -0,0 +1,281 @@
+#include "control.h"
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+ctrl_t* ctrlCreate(const char* sock_path, double max_rate_hz, ctrl_stats_fn stats_fn, void* stats_arg)
+{
+    ctrl_t* ctrl = (ctrl_t*)calloc(1, sizeof(ctrl_t));
+    if (ctrl == NULL) return NULL;
+
+    atomic_init(&ctrl->head, 0);
+    atomic_init(&ctrl->tail, 0);
+    atomic_init(&ctrl->running, true);
+    ctrl->stats_fn = stats_fn;
+    ctrl->stats_arg = stats_arg;
+    ctrl->max_rate_hz = max_rate_hz;
+    ctrl->use_stdin = true;
+    ctrl->listen_fd = -1;
+    for (int i = 0; i < CTRL_MAX_CLIENTS; i++) ctrl->client_fds[i] = -1;
+
+    if (sock_path == NULL) return ctrl;
+
+    /******** Local control socket ********/
+    struct sockaddr_un addr = {.sun_family = AF_UNIX};
+    strncpy(addr.sun_path, sock_path, sizeof(addr.sun_path) - 1);
+    strncpy(ctrl->sock_path, sock_path, sizeof(ctrl->sock_path) - 1);
+
+    ctrl->listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(sock_path); // remove a stale socket left by a previous run
+    if (ctrl->listen_fd < 0 ||
+        bind(ctrl->listen_fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 ||
+        listen(ctrl->listen_fd, CTRL_MAX_CLIENTS) < 0)
+    {
+        perror("ctrlCreate: control socket");
+        if (ctrl->listen_fd >= 0) close(ctrl->listen_fd);
+        ctrl->listen_fd = -1;
+    }
+    /**************************************/
+
+    return ctrl;
+} // end ctrlCreate()
+
+int ctrlParse(const char* line, ctrl_cmd_t* cmd)
+{
+    char word[16] = {0};
+    double value = CTRL_TOGGLE;
+    int n = sscanf(line, " %15s %lf", word, &value);
+    if (n < 1) return -1;
+
+    cmd->value = value;
+
+    // a bare number sets the mirror RPM, as in the old menu
+    if (isdigit((unsigned char)word[0]))
+    {
+        cmd->type = CTRL_CMD_RPM;
+        cmd->value = atof(word);
+        return 0;
+    }
+
+    static const struct {
+        const char* word;
+        const char* letter;
+        enum CTRL_CMD type;
+        bool needs_value;
+    } cmds[] = {
+        {"start", "P", CTRL_CMD_START, false},
+        {"stop", NULL, CTRL_CMD_STOP, false},
+        {"quit", "q", CTRL_CMD_QUIT, false},
+        {"rate", NULL, CTRL_CMD_RATE, true},
+        {"rpm", NULL, CTRL_CMD_RPM, true},
+        {"gate", "G", CTRL_CMD_GATE, false},
+        {"shutter", "S", CTRL_CMD_SHUTTER, false},
+        {"enable", "E", CTRL_CMD_ENABLE, false},
+        {"laser", "L", CTRL_CMD_LASER, false},
+        {"stats", NULL, CTRL_CMD_STATS, false}};
+
+    for (size_t i = 0; i < sizeof(cmds) / sizeof(cmds[0]); i++)
+    {
+        bool match = strcasecmp(word, cmds[i].word) == 0 ||
+                     (cmds[i].letter != NULL && strcasecmp(word, cmds[i].letter) == 0);
+        if (!match) continue;
+        if (cmds[i].needs_value && n < 2) return -1;
+
+        cmd->type = cmds[i].type;
+        return 0;
+    }
+    return -1;
+} // end ctrlParse()
+
+bool ctrlPost(ctrl_t* ctrl, const ctrl_cmd_t* cmd)
+{
+    unsigned head = atomic_load_explicit(&ctrl->head, memory_order_relaxed);
+    if (head - atomic_load_explicit(&ctrl->tail, memory_order_acquire) >= CTRL_MAILBOX_SIZE)
+    {
+        ctrl->dropped++;
+        return false;
+    }
+
+    ctrl->mailbox[head & (CTRL_MAILBOX_SIZE - 1)] = *cmd;
+    atomic_store_explicit(&ctrl->head, head + 1, memory_order_release);
+    return true;
+} // end ctrlPost()
+
+/**Sends len bytes of buf to fd without blocking. Sockets are sent to with MSG_NOSIGNAL, so a
+ * client that has gone away gives EPIPE instead of SIGPIPE; stdout is written to as before.
+ * Returns false if fd did not take all of it.
+ */
+static bool ctrlReply(int fd, const char* buf, size_t len)
+{
+    ssize_t n;
+    if (fd == STDOUT_FILENO)
+    {
+        n = write(fd, buf, len);
+    }
+    else
+    {
+        n = send(fd, buf, len, MSG_NOSIGNAL | MSG_DONTWAIT);
+    }
+    return n == (ssize_t)len;
+} // end ctrlReply()
+
+// Handles one complete command line and replies to fd. Returns false if the reply failed.
+static bool ctrlHandleLine(ctrl_t* ctrl, const char* line, int fd)
+{
+    ctrl_cmd_t cmd;
+    const char* reply = "ok\n";
+
+    if (line[strspn(line, " \t")] == '\0') return true; // blank lines are ignored silently
+
+    if (ctrlParse(line, &cmd) < 0)
+    {
+        reply = "error: unknown command\n";
+    }
+    else if (cmd.type == CTRL_CMD_RATE && !(cmd.value > 0 && cmd.value <= ctrl->max_rate_hz))
+    {
+        reply = "error: rate out of range\n";
+    }
+    else if (cmd.type == CTRL_CMD_STATS)
+    {
+        // report is built in memory so a slow client never blocks the stats callback
+        char* report = NULL;
+        size_t report_len = 0;
+        FILE* stream = open_memstream(&report, &report_len);
+        if (stream != NULL)
+        {
+            if (ctrl->stats_fn != NULL) ctrl->stats_fn(stream, ctrl->stats_arg);
+            fclose(stream);
+            bool sent = ctrlReply(fd, report, report_len);
+            free(report);
+            if (!sent) return false;
+        }
+    }
+    else if (!ctrlPost(ctrl, &cmd))
+    {
+        reply = "busy\n";
+    }
+
+    return ctrlReply(fd, reply, strlen(reply));
+} // end ctrlHandleLine()
+
+/**Appends the bytes available on fd to the line buffer, handling each complete line.
+ * Returns false on EOF or error, or if a reply could not be sent.
+ */
+static bool ctrlReadLines(ctrl_t* ctrl, int fd, int reply_fd, char* line, uint16_t* len)
+{
+    char buff[CTRL_LINE_LEN];
+    ssize_t n = read(fd, buff, sizeof(buff));
+    if (n <= 0) return false;
+
+    for (ssize_t i = 0; i < n; i++)
+    {
+        if (buff[i] == '\n' || buff[i] == '\r')
+        {
+            line[*len] = '\0';
+            *len = 0;
+            if (!ctrlHandleLine(ctrl, line, reply_fd)) return false;
+        }
+        else if (*len < CTRL_LINE_LEN - 1)
+        {
+            line[(*len)++] = buff[i]; // overlong lines are truncated
+        }
+    }
+    return true;
+} // end ctrlReadLines()
+
+void* ctrlMain(void* arg)
+{
+    ctrl_t* ctrl = (ctrl_t*)arg;
+
+    while (atomic_load(&ctrl->running))
+    {
+        /******** Build poll set: stdin, listening socket, clients ********/
+        struct pollfd fds[2 + CTRL_MAX_CLIENTS];
+        int client_slot[2 + CTRL_MAX_CLIENTS];
+        int nfds = 0;
+
+        if (ctrl->use_stdin)
+        {
+            fds[nfds] = (struct pollfd){.fd = STDIN_FILENO, .events = POLLIN};
+            client_slot[nfds++] = -1;
+        }
+        if (ctrl->listen_fd >= 0)
+        {
+            fds[nfds] = (struct pollfd){.fd = ctrl->listen_fd, .events = POLLIN};
+            client_slot[nfds++] = -2;
+        }
+        for (int i = 0; i < CTRL_MAX_CLIENTS; i++)
+        {
+            if (ctrl->client_fds[i] < 0) continue;
+            fds[nfds] = (struct pollfd){.fd = ctrl->client_fds[i], .events = POLLIN};
+            client_slot[nfds++] = i;
+        }
+        /******************************************************************/
+
+        if (poll(fds, nfds, CTRL_POLL_MSEC) <= 0) continue;
+
+        for (int i = 0; i < nfds; i++)
+        {
+            if (!(fds[i].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+
+            if (client_slot[i] == -1) // stdin
+            {
+                if (!ctrlReadLines(ctrl, STDIN_FILENO, STDOUT_FILENO, ctrl->stdin_line, &ctrl->stdin_len))
+                {
+                    ctrl->use_stdin = false; // EOF, e.g. started in the background
+                }
+            }
+            else if (client_slot[i] == -2) // new connection
+            {
+                int fd = accept(ctrl->listen_fd, NULL, NULL);
+                if (fd < 0) continue;
+
+                int slot = 0;
+                while (slot < CTRL_MAX_CLIENTS && ctrl->client_fds[slot] >= 0) slot++;
+                if (slot == CTRL_MAX_CLIENTS)
+                {
+                    close(fd); // too many clients
+                    continue;
+                }
+                ctrl->client_fds[slot] = fd;
+                ctrl->client_lens[slot] = 0;
+            }
+            else
+            {
+                int slot = client_slot[i];
+                int fd = ctrl->client_fds[slot];
+                if (!ctrlReadLines(ctrl, fd, fd, ctrl->client_lines[slot], &ctrl->client_lens[slot]))
+                {
+                    close(fd);
+                    ctrl->client_fds[slot] = -1;
+                }
+            }
+        }
+    }
+    return NULL;
+} // end ctrlMain()
+
+void ctrlStop(ctrl_t* ctrl)
+{
+    atomic_store(&ctrl->running, false);
+} // end ctrlStop()
+
+void ctrlDestroy(ctrl_t* ctrl)
+{
+    if (ctrl == NULL) return;
+
+    for (int i = 0; i < CTRL_MAX_CLIENTS; i++)
+    {
+        if (ctrl->client_fds[i] >= 0) close(ctrl->client_fds[i]);
+    }
+    if (ctrl->listen_fd >= 0)
+    {
+        close(ctrl->listen_fd);
+        unlink(ctrl->sock_path);
+    }
+    free(ctrl);
+} // end ctrlDestroy()
@@ -0,0 +1,109 @@
+#ifndef _CONTROL_H_
+#define _CONTROL_H_
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+#define CTRL_MAILBOX_SIZE 64   // commands buffered between the control thread and acquisition; power of 2
+#define CTRL_MAX_CLIENTS 4     // simultaneous socket connections
+#define CTRL_LINE_LEN 128      // longest accepted command line
+#define CTRL_POLL_MSEC 100     // control thread wake-up interval to check for ctrlStop()
+
+/** Control plane.
+ *  A control thread reads text commands, one per line, from stdin and from clients
+ *  of a local (AF_UNIX) stream socket, e.g. `echo "rate 500" | nc -U /tmp/tdc_ctrl.sock`.
+ *  Parsed commands are handed to the acquisition thread through a single-producer
+ *  single-consumer ring (the mailbox); posting and polling never block or take a lock,
+ *  so the acquisition loop checks for commands once per shot at the cost of one atomic load.
+ *
+ *  Commands (single letters of the old menu in brackets):
+ *    start [P], stop, quit [q], rate <shots/s>, rpm <rpm> [<number>],
+ *    gate [0|1] [G], shutter [0|1] [S], enable [0|1] [E], laser [L], stats
+ *  gate/shutter/enable toggle when given no argument. "stats" is answered directly by
+ *  the control thread through the stats callback; every other command is posted to the
+ *  mailbox and acknowledged with "ok" (or "busy" if the mailbox is full). A rate outside
+ *  (0, max_rate_hz] is answered with an error and never posted.
+ *
+ *  Replies are sent without blocking and without SIGPIPE; a socket client that has gone away
+ *  or does not read its replies is disconnected, so it cannot stall or end the process.
+ */
+
+enum CTRL_CMD
+{
+    CTRL_CMD_START,
+    CTRL_CMD_STOP,
+    CTRL_CMD_QUIT,
+    CTRL_CMD_RATE,
+    CTRL_CMD_RPM,
+    CTRL_CMD_GATE,
+    CTRL_CMD_SHUTTER,
+    CTRL_CMD_ENABLE,
+    CTRL_CMD_LASER,
+    CTRL_CMD_STATS
+};
+
+#define CTRL_TOGGLE -1.0 // value of gate/shutter/enable commands given without an argument
+
+typedef struct CtrlCmd {
+    enum CTRL_CMD type;
+    double value; // rate, rpm or pin state (CTRL_TOGGLE) depending on type
+} ctrl_cmd_t;
+
+// Writes a status report to stream; called on the control thread
+typedef void (*ctrl_stats_fn)(FILE* stream, void* arg);
+
+typedef struct Ctrl {
+    ctrl_cmd_t mailbox[CTRL_MAILBOX_SIZE];
+    atomic_uint head;           // next slot written by the control thread
+    atomic_uint tail;           // next slot read by the acquisition thread
+    atomic_bool running;        // cleared by ctrlStop()
+    uint32_t dropped;           // commands rejected because the mailbox was full
+    double max_rate_hz;         // highest shot rate accepted by "rate"
+    int listen_fd;              // control socket; -1 if it could not be opened
+    char sock_path[108];        // socket path, unlinked on destroy
+    int client_fds[CTRL_MAX_CLIENTS];
+    char client_lines[CTRL_MAX_CLIENTS][CTRL_LINE_LEN];
+    uint16_t client_lens[CTRL_MAX_CLIENTS];
+    bool use_stdin;             // false once stdin reaches EOF
+    char stdin_line[CTRL_LINE_LEN];
+    uint16_t stdin_len;
+    ctrl_stats_fn stats_fn;
+    void* stats_arg;
+} ctrl_t;
+
+/**Allocates a control plane listening on sock_path (NULL for stdin only), accepting rate
+ * commands up to max_rate_hz. stats_fn(stream, stats_arg) answers "stats"; it runs on the
+ * control thread and should only read state. Returns NULL on failure.
+ */
+ctrl_t* ctrlCreate(const char* sock_path, double max_rate_hz, ctrl_stats_fn stats_fn, void* stats_arg);
+
+// Control thread; pass the ctrl_t* from ctrlCreate() as argument. Returns after ctrlStop().
+void* ctrlMain(void* arg);
+
+/**Parses a command line. Returns 0 and fills cmd, or -1 if the line is not a command.
+ */
+int ctrlParse(const char* line, ctrl_cmd_t* cmd);
+
+// Posts cmd to the mailbox. Control thread only. Returns false if the mailbox is full.
+bool ctrlPost(ctrl_t* ctrl, const ctrl_cmd_t* cmd);
+
+// Takes the oldest command from the mailbox. Acquisition thread only. Returns false if empty.
+static inline bool ctrlPoll(ctrl_t* ctrl, ctrl_cmd_t* cmd)
+{
+    unsigned tail = atomic_load_explicit(&ctrl->tail, memory_order_relaxed);
+    if (tail == atomic_load_explicit(&ctrl->head, memory_order_acquire)) return false;
+
+    *cmd = ctrl->mailbox[tail & (CTRL_MAILBOX_SIZE - 1)];
+    atomic_store_explicit(&ctrl->tail, tail + 1, memory_order_release);
+    return true;
+}
+
+// Asks ctrlMain() to return
+void ctrlStop(ctrl_t* ctrl);
+
+// Closes the socket and its clients and frees ctrl; join the control thread first
+void ctrlDestroy(ctrl_t* ctrl);
+
+#endif
@@ -0,0 +1,51 @@
+#include "fast_gpio.h"
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+volatile uint32_t* fast_gpio_regs = NULL;
+static bool fast_gpio_mapped = false; // true if fast_gpio_regs points to hardware
+
+int fastGpioInit()
+{
+    if (fast_gpio_mapped) return 0;
+
+    int mem_file = open(FAST_GPIO_DEV, O_RDWR | O_SYNC);
+    if (mem_file < 0)
+    {
+        perror("fastGpioInit: open " FAST_GPIO_DEV);
+        return -1;
+    }
+
+    //Memory maps GPIO block to userspace; /dev/gpiomem places the block at offset 0
+    void* regs = mmap(NULL, FAST_GPIO_MAP_LEN,
+            PROT_READ | PROT_WRITE,
+            MAP_SHARED, mem_file, 0);
+    close(mem_file); // mapping remains valid after closing the descriptor
+
+    if (regs == MAP_FAILED)
+    {
+        perror("fastGpioInit: mmap");
+        return -1;
+    }
+
+    fast_gpio_regs = (volatile uint32_t*)regs;
+    fast_gpio_mapped = true;
+    return 0;
+} // end fastGpioInit()
+
+void fastGpioInitMock(volatile uint32_t* regs)
+{
+    fastGpioClose();
+    fast_gpio_regs = regs;
+} // end fastGpioInitMock()
+
+void fastGpioClose()
+{
+    if (fast_gpio_mapped)
+    {
+        munmap((void*)fast_gpio_regs, FAST_GPIO_MAP_LEN);
+        fast_gpio_mapped = false;
+    }
+    fast_gpio_regs = NULL;
+} // end fastGpioClose()
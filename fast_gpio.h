@@ -0,0 +1,73 @@
+#ifndef _FAST_GPIO_H_
+#define _FAST_GPIO_H_
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/** Direct GPIO register access.
+ *  Maps the BCM283x GPIO block through /dev/gpiomem (no root required) and
+ *  accesses the level, set and clear registers directly, avoiding the library
+ *  call overhead of gpioRead()/gpioWrite() in hot loops. Writing a mask to
+ *  GPSET0/GPCLR0 changes all selected pins 0-31 in a single bus write.
+ *
+ *  Pin modes are not touched here; configure them with gpioSetMode() first.
+ */
+#define FAST_GPIO_DEV "/dev/gpiomem"
+#define FAST_GPIO_MAP_LEN 0xB4 // bytes of the GPIO block to map; covers all registers used here
+
+// 32-bit word offsets of GPIO registers within the block
+enum FAST_GPIO_REG {
+    FAST_GPIO_GPSET0 = 0x1C / 4,
+    FAST_GPIO_GPCLR0 = 0x28 / 4,
+    FAST_GPIO_GPLEV0 = 0x34 / 4,
+    FAST_GPIO_NUM_REGS = FAST_GPIO_MAP_LEN / 4
+};
+
+// Base of the mapped GPIO registers; NULL until fastGpioInit() or fastGpioInitMock()
+extern volatile uint32_t* fast_gpio_regs;
+
+/**Maps the GPIO registers. Returns 0 on success, -1 on failure,
+ * in which case callers should fall back to pigpio.
+ */
+int fastGpioInit();
+
+/**Points the backend at a caller-owned array of FAST_GPIO_NUM_REGS words
+ * instead of hardware. Used by tests to observe writes and inject levels.
+ */
+void fastGpioInitMock(volatile uint32_t* regs);
+
+// Unmaps the registers (if mapped from hardware)
+void fastGpioClose();
+
+// Returns the levels of pins 0-31
+static inline uint32_t fastGpioReadBits()
+{
+    return fast_gpio_regs[FAST_GPIO_GPLEV0];
+}
+
+// Returns the level (0/1) of pin
+static inline int fastGpioRead(unsigned pin)
+{
+    return (fast_gpio_regs[FAST_GPIO_GPLEV0] >> pin) & 1;
+}
+
+// Drives every pin in mask HI simultaneously
+static inline void fastGpioSetBits(uint32_t mask)
+{
+    fast_gpio_regs[FAST_GPIO_GPSET0] = mask;
+}
+
+// Drives every pin in mask LO simultaneously
+static inline void fastGpioClearBits(uint32_t mask)
+{
+    fast_gpio_regs[FAST_GPIO_GPCLR0] = mask;
+}
+
+static inline void fastGpioWrite(unsigned pin, unsigned level)
+{
+    if (level) fastGpioSetBits(1u << pin);
+    else fastGpioClearBits(1u << pin);
+}
+
+#endif
@@ -0,0 +1,44 @@
+#include "mode_ctrl.h"
+
+mode_ctrl_t* modeCtrlCreate(uint8_t mode, bool enabled, double mode2_tof, double mode1_tof, uint32_t window)
+{
+    if (mode1_tof > mode2_tof || window == 0) return NULL;
+
+    mode_ctrl_t* ctrl = (mode_ctrl_t*)calloc(1, sizeof(mode_ctrl_t));
+    if (ctrl == NULL) return NULL;
+
+    ctrl->enabled = enabled;
+    ctrl->mode = mode ? MODE_CTRL_MODE2 : MODE_CTRL_MODE1;
+    ctrl->mode2_tof = mode2_tof;
+    ctrl->mode1_tof = mode1_tof;
+    ctrl->window = window;
+    return ctrl;
+} // end modeCtrlCreate()
+
+bool modeCtrlUpdate(mode_ctrl_t* ctrl, uint8_t sample_mode, double tof)
+{
+    if (!ctrl->enabled || sample_mode != ctrl->mode) return false;
+
+    if (tof > ctrl->window_max) ctrl->window_max = tof;
+
+    // leave mode 1 as soon as a return beyond its range is seen
+    bool change = (ctrl->mode == MODE_CTRL_MODE1 && ctrl->window_max > ctrl->mode2_tof);
+
+    if (!change && ++ctrl->window_cnt < ctrl->window) return false;
+
+    // window complete; return to mode 1 only if the whole window was short range
+    if (!change) change = (ctrl->mode == MODE_CTRL_MODE2 && ctrl->window_max < ctrl->mode1_tof);
+
+    ctrl->window_cnt = 0;
+    ctrl->window_max = 0;
+    if (!change) return false;
+
+    ctrl->mode = (ctrl->mode == MODE_CTRL_MODE1) ? MODE_CTRL_MODE2 : MODE_CTRL_MODE1;
+    ctrl->switches++;
+    return true;
+} // end modeCtrlUpdate()
+
+void modeCtrlDestroy(mode_ctrl_t* ctrl)
+{
+    free(ctrl);
+} // end modeCtrlDestroy()
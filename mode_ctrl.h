@@ -0,0 +1,58 @@
+#ifndef _MODE_CTRL_H_
+#define _MODE_CTRL_H_
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#define MODE_CTRL_MODE1 0 // CONFIG1 measurement mode bits for mode 1
+#define MODE_CTRL_MODE2 1 // CONFIG1 measurement mode bits for mode 2
+
+/** Automatic TDC measurement mode selection.
+ *  Mode 1 (ring oscillator only) is more precise and needs fewer registers read
+ *  per sample, but is only specified up to ~500 ns. Mode 2 counts reference clock
+ *  periods and covers long ranges, but cannot resolve returns shorter than a
+ *  couple of clock periods.
+ *
+ *  The controller keeps the largest ToF of the last window valid samples. When
+ *  it exceeds mode2_tof the controller requests mode 2; when every sample of a
+ *  window stays below mode1_tof it requests mode 1. The gap between the two
+ *  thresholds is the hysteresis that stops the mode from toggling on a scene
+ *  near the boundary. Samples measured in a mode other than the current request
+ *  (still in flight when the mode changed) are ignored.
+ *
+ *  modeCtrlUpdate() is called by the single thread decoding samples; the
+ *  requested mode is read by the acquisition thread, which applies it with
+ *  tdcSetMeasMode() before arming.
+ */
+typedef struct ModeCtrl {
+    bool enabled;           // if false the requested mode never changes
+    double mode2_tof;       // switch to mode 2 when the window maximum ToF exceeds this (seconds)
+    double mode1_tof;       // switch to mode 1 when the window maximum ToF is below this (seconds)
+    uint32_t window;        // valid samples per decision
+    volatile uint8_t mode;  // requested CONFIG1 measurement mode bits
+    uint32_t window_cnt;    // samples in the current window
+    double window_max;      // largest ToF in the current window
+    uint32_t switches;      // number of mode changes requested
+} mode_ctrl_t;
+
+/**Allocates a controller starting in mode (MODE_CTRL_MODE1 or MODE_CTRL_MODE2).
+ * If enabled is false the controller only reports the fixed mode.
+ * Returns NULL on failure.
+ */
+mode_ctrl_t* modeCtrlCreate(uint8_t mode, bool enabled, double mode2_tof, double mode1_tof, uint32_t window);
+
+/**Adds a valid sample measured in sample_mode with time of flight tof (seconds).
+ * Returns true if the requested mode changed.
+ */
+bool modeCtrlUpdate(mode_ctrl_t* ctrl, uint8_t sample_mode, double tof);
+
+// Returns the currently requested CONFIG1 measurement mode bits
+static inline uint8_t modeCtrlMode(mode_ctrl_t* ctrl)
+{
+    return ctrl->mode;
+}
+
+void modeCtrlDestroy(mode_ctrl_t* ctrl);
+
+#endif
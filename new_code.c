@@ -99,26 +99,13 @@ void *dataprocFunc(void *arg)
     double ToF;
     uint32_t tdc_data[5];
 
-    // static array of rx_buff indices pointing to TDC register data within array of raw bytes
-    static uint8_t const rx_data_idx[] = {
-        1,  // TIME1 data start index
-        4,  // CLOCK_COUNT1 data start index
-        7,  // TIME2 data start index
-        11, // CALIBRATION1 data start index
-        14  // CLAIBRATION2 data start index
-    };
-
     /******** Converting Data into 32-bit Numbers ********/
-    /**Iterate over the indices in rx_data_idx, converting the 
-     * subset of 3 bytes starting at rx_buff[rx_data_idx[i]]
+    /**Iterate over the indices in tdc_readout_idx, converting the 
+     * subset of 3 bytes starting at rx_buff[tdc_readout_idx[i]]
      */
     for (uint8_t i = 0; i < 5; i++)
     {
-        #ifdef USE_AUTOINC_METHOD
-        uint32_t conv = convertSubsetToLong(tdc_arg->raw_tdc_data + rx_data_idx[i], 3, true);
-        #else
-        uint32_t conv = convertSubsetToLong(tdc_arg->raw_tdc_data + i * 4, 4, true);
-        #endif
+        uint32_t conv = convertSubsetToLong(tdc_arg->raw_tdc_data + tdc_readout_idx[i], 3, true);
 
         if (checkOddParity(conv))
         {
@@ -159,7 +146,7 @@ void *dataprocFunc(void *arg)
         }
         else
         {
-            ToF = tdc_data[0]*(cal_periods - 1) / ((double)tdc_data[4] - tdc_data[3]) / (double)tdc_arg->tdc->clk_freq;
+            ToF = calcToFMode1(tdc_data, cal_periods, tdc_arg->tdc->clk_freq);
         }
 
     } // end if (valid_data_flag)
@@ -320,6 +307,7 @@ int main()
         .int_pin = TDC_INT_PIN,
         .clk_pin = TDC_CLK_PIN,
         .clk_freq = TDC_CLK_FREQ,
+        .timeout_us = TDC_TIMEOUT_USEC,
         .cal_periods = TDC_CAL_2};
     tdcInit(&tdc, TDC_BAUD);
 
@@ -328,19 +316,13 @@ int main()
     gpioSetMode(TDC_STOP_PIN, PI_OUTPUT);  // active HI
 
     // TDC must see rising edge of ENABLE while powered for proper internal initializaiton
-    gpioWrite(tdc.enable_pin, 0);
-    gpioDelay(3); // Short delay to make sure TDC sees LOW before rising edge
-    gpioWrite(tdc.enable_pin, 1);
+    tdcEnable(&tdc);
     
-    //Non-incrementing write to CONFIG2 reg (address 0x01)
-    //Clear CONFIG2 to configure 2 calibration clock periods,
-    // no averaging, and single stop signal operation
-    char config2_cmds[] = {
-        TDC_CMD(0, 1, TDC_CONFIG2),
-        TDC_CONFIG2_BITS(tdc.cal_periods, TDC_AVG_1CYC, 1)};
-    char config2_rx[sizeof(config2_cmds)];
-
-    spiXfer(tdc.spi_handle, config2_cmds, config2_rx, sizeof(config2_cmds));
+    // parity and rising edge start, stop, trigger signals
+    tdcSetReg(&tdc, TDC_CONFIG1, TDC_CONFIG1_BITS(0, 1, 0, 0, 0, TDC_MEAS_MODE, 0));
+    // 2 calibration clock periods, no averaging, and single stop signal operation
+    tdcSetReg(&tdc, TDC_CONFIG2, TDC_CONFIG2_BITS(tdc.cal_periods, TDC_AVG_1CYC, 1));
+    tdcConfigure(&tdc);
     /****************************************/
 
     /********* Initializing laser control pins *********/
@@ -441,18 +423,11 @@ int main()
 
             loggerSendLogMsg(logger, hdr_strs, sizeof(hdr_strs), OUT_FILE, 0, true);       
             
-            //start new measurement on TDC
-            static char meas_cmds[2] = {
-                0x40, //Write to CONFIG1
-                TDC_CONFIG1_BITS(0,1,0,0,0,TDC_MEAS_MODE,1)  //Start measurement in mode 1 with parity and rising edge start, stop, trigger signals
-            };
-            char meas_cmds_rx[sizeof(meas_cmds)];
-
             uint32_t start_tick = gpioTick();
             while ((gpioTick() - start_tick) < LASER_ACQ_USEC) // main data acquisition loop
             {
                 // gpioDelay(10); 
-                spiXfer(tdc.spi_handle, meas_cmds, meas_cmds_rx, sizeof(meas_cmds));
+                tdcArm(&tdc); //start new measurement on TDC
                 gpioDelay(1); // small delay to allow TDC to process data
             
                 #ifdef USE_DEBUG
@@ -481,75 +456,14 @@ int main()
                 gpioWrite(TDC_START_PIN, 0);
                 #endif
 
-                //Poll TDC INT pin to signal available data
-                uint32_t curr_tick = gpioTick();
-                while (gpioRead(tdc.int_pin) && (gpioTick() - curr_tick) < tdc.timeout_us);
-
-                if (!gpioRead(tdc.int_pin)) //if TDC returned in time
+                if (tdcWaitResult(&tdc) == TDC_MEAS_VALID) //if TDC returned in time
                 {
+                    // freed inside data processor function
+                    char* rx_buff = (char*) calloc(TDC_READOUT_LEN, sizeof(char));
                     #ifdef USE_AUTOINC_METHOD
-                    /******** Transaction 1 *********/
-                    /**Transaction 1 starts an auto-incrementing read at register TIME1,
-                    * reading 9 bytes to obtain the 3-byte long TIME1, CLOCK_COUNT1, 
-                    * and TIME2 registers.
-                    */
-
-                    /**array to holds return bytes from both SPI transactions retrieving Measurement registers
-                    * TIME1, CLOCK_COUNT1, TIME2, CALIBRATION1, CALIBRATION2 in that order.
-                    * These registers are 24-bits long where the MSb is a parity bit.
-                    * Hence rx_buff holds 5 3-byte data chars and 2 1-byte command chars (17 bytes total)
-                    * rx_buff[0] = 0 (junk data from Transaction 1 command byte)
-                    * rx_buff[1-3] = TIME1 bytes in big-endian order
-                    * rx_buff[4-6] = CLOCK_COUNT1 bytes in big-endian order
-                    * rx_buff[7-9] = TIME2 bytes in big-endian order
-                    * rx_buff[10] = 0 (junk data from Transaction 2 command byte)
-                    * rx_buff[11-13] = CALIBRATION1 in big-endian order
-                    * rx_buff[14-16] = CALIBRATION2 in big-endian order
-                    */
-                    char* rx_buff = (char*) calloc(17,sizeof(char));
-
-                    char tx_buff1[10] = {0x90}; // start an auto incrementing read to read TIME1, CLOCK_COUNT1, TIME2 in a single command
-                    spiXfer(tdc.spi_handle, tx_buff1, rx_buff, sizeof(tx_buff1));
-
-                    //print returned data
-                    // printf("rx_buff after transaction 1=");
-                    // printArray(rx_buff, 17);
-                    // printf("\n");
-                    /*********************************/
-
-                    /********* Transaction 2 *********/
-                    /**Transaciton 2 starts an auto-incrementing read at register CALIBRATION1
-                    * and reads the 24-bit CALIBRATION1 and CALIBRATION2 registers. Hence, 
-                    * the transaction sends 7 bytes (1 command, 6 reading bytes). The first
-                    * byte of the return buffer will always be 0
-                    */
-                    char tx_buff2[7] = {TDC_CMD(1, 0, TDC_CALIBRATION1)}; //auto incrementing read of CALIBRATION1 and CALIBRATION2
-                    spiXfer(tdc.spi_handle, tx_buff2, rx_buff + sizeof(tx_buff1), sizeof(tx_buff2));
-
-                    // printf("rx_buff after txaction 2=");
-                    // printArray(rx_buff, 17);
-                    // printf("\n");
-                    /*********************************/
+                    tdcReadResult(&tdc, rx_buff, true, 0);
                     #else
-                    static char tof_cmds[5] = {
-                        // TDC commands for retrieving TOF
-                        0x10, //Read TIME1
-                        0x11, //Read CLOCK_COUNT1
-                        0x12, //Read TIME2
-                        0x1B, //Read CALIBRATION
-                        0x1C  //Read CALIBRATION2
-                    };
-                    static char rx_buff1[sizeof(tof_cmds) * 4];
-
-                    for (int i = 0; i < sizeof(tof_cmds); i++)
-                    {
-                        char tx_temp[4] = {tof_cmds[i]};
-
-                        spiXfer(tdc.spi_handle, tx_temp, rx_buff1 + i * 4, sizeof(tx_temp));
-                        // printf("Command %02X return=", tof_cmds[i]);
-                        // printArray(rx_buff1 + i * 4, 4);
-                        // printf("\n");
-                    }
+                    tdcReadResult(&tdc, rx_buff, false, 0);
                     #endif
 
                     // allocate argument struct for data processor. Free inside data processor function
@@ -557,18 +471,18 @@ int main()
                     data->data_break = false;
                     data->logger = logger;
                     data->raw_tdc_data = rx_buff;
-                    data->raw_tdc_size = sizeof(rx_buff);
+                    data->raw_tdc_size = TDC_READOUT_LEN;
                     data->tcp_handler = tcp_handler;
                     data->tdc = &tdc;
 
                     // printf("queuing dataproc\n");
                     dataprocSendData(data_proc, &dataprocFunc, (void *)data, 0, true);
                     // printf("queued dataproc\n");
-                }    // end if (!gpioRead(tdc.int_pin)), i.e. no timeout waiting for TDC
+                }    // end if (tdcWaitResult(&tdc) == TDC_MEAS_VALID), i.e. no timeout waiting for TDC
                 else //else timeout occured
                 {
                     // printf("TDC timeout occured\n");
-                } // end else linked to if (!gpioRead(tdc.int_pin))
+                } // end else linked to if (tdcWaitResult(&tdc) == TDC_MEAS_VALID)
             } // end main data acquisitio loop; while((gpioTick() - start_tick) < ...)
             
             gpioPWM(LASER_PULSE_PIN, 0); // stop laser pulse train
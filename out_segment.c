@@ -0,0 +1,110 @@
+#include "out_segment.h"
+#include <string.h>
+#include <stdarg.h>
+#include <time.h>
+
+out_seg_t* outSegCreate(logger_t* logger, const char* path, const char* header, uint32_t segment_sec, uint32_t record_sec)
+{
+    if (strlen(path) >= OUT_SEG_STEM_LEN) return NULL;
+
+    out_seg_t* seg = (out_seg_t*)calloc(1, sizeof(out_seg_t));
+    if (seg == NULL) return NULL;
+
+    seg->logger = logger;
+    seg->header = header;
+    seg->segment_sec = segment_sec;
+    seg->record_sec = record_sec;
+    atomic_init(&seg->restart, true);
+    pthread_mutex_init(&seg->config_lock, NULL);
+
+    // split the extension off the file name (not off a directory name)
+    const char* dot = strrchr(path, '.');
+    const char* slash = strrchr(path, '/');
+    size_t stem_len = (dot != NULL && (slash == NULL || dot > slash) && dot != path) ? (size_t)(dot - path) : strlen(path);
+    if (strlen(path) - stem_len >= sizeof(seg->ext)) stem_len = strlen(path);
+    memcpy(seg->stem, path, stem_len);
+    strcpy(seg->ext, path + stem_len);
+
+    strcpy(seg->paths[0], path);
+    return seg;
+} // end outSegCreate()
+
+void outSegSetConfig(out_seg_t* seg, const char* fmt, ...)
+{
+    if (seg == NULL) return;
+
+    va_list args;
+    va_start(args, fmt);
+    pthread_mutex_lock(&seg->config_lock);
+    vsnprintf(seg->config, sizeof(seg->config), fmt, args);
+    pthread_mutex_unlock(&seg->config_lock);
+    va_end(args);
+} // end outSegSetConfig()
+
+void outSegRestart(out_seg_t* seg)
+{
+    if (seg == NULL) return;
+    atomic_store(&seg->restart, true);
+} // end outSegRestart()
+
+// Writes the config record and the CSV header to the current segment
+static void outSegWriteRecords(out_seg_t* seg, double time)
+{
+    char record[OUT_SEG_CONFIG_LEN + 64];
+    pthread_mutex_lock(&seg->config_lock);
+    int len = snprintf(record, sizeof(record), "# CONFIG time=%lf segment=%u rows=%llu %s\n",
+                       time, seg->segments, (unsigned long long)seg->rows, seg->config);
+    pthread_mutex_unlock(&seg->config_lock);
+    if (len >= (int)sizeof(record)) len = sizeof(record) - 1;
+
+    char* path = seg->paths[seg->path_idx];
+    loggerSendLogMsg(seg->logger, record, len, path, 0, true);
+    loggerSendLogMsg(seg->logger, (char*)seg->header, strlen(seg->header), path, 0, true);
+    seg->last_record = time;
+} // end outSegWriteRecords()
+
+/**Function: outSegWrite
+ * Description: The logger is handed the path of the segment with every message. Path
+ *              buffers are reused round robin over OUT_SEG_PATHS segments rather than
+ *              allocated per segment, so memory use stays constant on unbounded runs while
+ *              a path stays valid long after the logger has written its last queued line.
+ */
+int outSegWrite(out_seg_t* seg, char* row, size_t len, double time)
+{
+    if (seg == NULL || seg->logger == NULL) return 0;
+
+    bool records = atomic_exchange(&seg->restart, false);
+
+    if (seg->segment_sec > 0 && (seg->segments == 0 || time - seg->seg_start >= seg->segment_sec))
+    {
+        // new segment named after its start time
+        seg->path_idx = (seg->path_idx + 1) % OUT_SEG_PATHS;
+        time_t start = (time_t)time;
+        struct tm tm_start;
+        char stamp[16]; // YYYYmmdd-HHMMSS
+        localtime_r(&start, &tm_start);
+        strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", &tm_start);
+        snprintf(seg->paths[seg->path_idx], OUT_SEG_PATH_LEN, "%s_%s%s", seg->stem, stamp, seg->ext);
+
+        seg->seg_start = time;
+        seg->segments++;
+        records = true;
+    }
+    else if (seg->segments == 0)
+    {
+        seg->segments = 1; // single file
+    }
+
+    if (seg->record_sec > 0 && time - seg->last_record >= seg->record_sec) records = true;
+    if (records) outSegWriteRecords(seg, time);
+
+    seg->rows++;
+    return loggerSendLogMsg(seg->logger, row, len, seg->paths[seg->path_idx], 0, true);
+} // end outSegWrite()
+
+void outSegDestroy(out_seg_t* seg)
+{
+    if (seg == NULL) return;
+    pthread_mutex_destroy(&seg->config_lock);
+    free(seg);
+} // end outSegDestroy()
@@ -0,0 +1,67 @@
+#ifndef _OUT_SEGMENT_H_
+#define _OUT_SEGMENT_H_
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "logger.h"
+
+#define OUT_SEG_PATH_LEN 96    // longest segment file path
+#define OUT_SEG_STEM_LEN 64    // longest given path; leaves room for the segment time stamp
+#define OUT_SEG_CONFIG_LEN 256 // longest config record
+#define OUT_SEG_PATHS 4        // segment path buffers reused in turn; see outSegWrite()
+
+/** Segmented data output.
+ *  Rows are written through the threaded logger into a sequence of files. With
+ *  segment_sec = 0 all rows go to path itself (windowed acquisition). Otherwise a
+ *  new file <path stem>_<YYYYmmdd-HHMMSS><path extension> is started every
+ *  segment_sec seconds of row time, so a continuous run never grows one file without
+ *  bound and files can be moved away while acquisition continues.
+ *
+ *  Every segment starts with a config record (a line beginning with '#') and the CSV
+ *  header; both are repeated every record_sec seconds (0 = segment start only) and
+ *  after outSegRestart(), so any part of a long file can be parsed on its own.
+ *
+ *  outSegWrite() is called only by the thread producing rows (the data processor).
+ *  outSegSetConfig() and outSegRestart() may be called from any thread. All functions
+ *  accept a NULL out_seg_t* and do nothing.
+ */
+typedef struct OutSeg {
+    logger_t* logger;               // receives every line; NULL discards output
+    char stem[OUT_SEG_STEM_LEN];    // path up to the extension
+    char ext[16];                   // path extension including the dot, may be empty
+    const char* header;             // CSV header row including newline
+    uint32_t segment_sec;           // seconds per segment; 0 = single file
+    uint32_t record_sec;            // seconds between repeated config/header records; 0 = segment start only
+    char paths[OUT_SEG_PATHS][OUT_SEG_PATH_LEN];
+    uint32_t path_idx;              // paths[] entry of the current segment
+    uint32_t segments;              // segments started
+    uint64_t rows;                  // rows written
+    double seg_start;               // row time at which the current segment started
+    double last_record;             // row time of the last config/header record
+    atomic_bool restart;            // write records before the next row
+    pthread_mutex_t config_lock;    // guards config
+    char config[OUT_SEG_CONFIG_LEN];
+} out_seg_t;
+
+/**Allocates segmented output for path (e.g. "./all_vals.txt") with CSV header row header.
+ * header must stay valid for the lifetime of the returned object. Returns NULL on failure.
+ */
+out_seg_t* outSegCreate(logger_t* logger, const char* path, const char* header, uint32_t segment_sec, uint32_t record_sec);
+
+// Replaces the text of the config record (printf-style); takes effect at the next record
+void outSegSetConfig(out_seg_t* seg, const char* fmt, ...);
+
+// Requests config and header records before the next row, e.g. at the start of a window
+void outSegRestart(out_seg_t* seg);
+
+/**Writes one row with timestamp time (seconds since the epoch), first starting a new
+ * segment or repeating the records if due. Returns the logger status or 0 if output is discarded.
+ */
+int outSegWrite(out_seg_t* seg, char* row, size_t len, double time);
+
+void outSegDestroy(out_seg_t* seg);
+
+#endif
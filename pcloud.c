@@ -0,0 +1,199 @@
+#include "pcloud.h"
+#include <string.h>
+#include <math.h>
+
+#define PCLOUD_DEG2RAD (M_PI / 180.0)
+
+pcloud_t* pcloudCreate(enum PCLOUD_FORMAT format, uint32_t facets, const float* elev_deg, double angle0_deg,
+                       double span_deg)
+{
+    if (facets == 0 || facets > 256 || span_deg <= 0) return NULL;
+
+    pcloud_t* pc = (pcloud_t*)calloc(1, sizeof(pcloud_t));
+    if (pc == NULL) return NULL;
+
+    pc->lut = (float*)malloc(sizeof(float) * 3 * facets * (PCLOUD_LUT_BINS + 1));
+    pc->angle = (float*)malloc(sizeof(float) * PCLOUD_BATCH_MAX);
+    pc->range = (float*)malloc(sizeof(float) * PCLOUD_BATCH_MAX);
+    pc->facet = (uint8_t*)malloc(PCLOUD_BATCH_MAX);
+    pc->chunk = (uint8_t*)malloc(PCLOUD_HDR_MAX + sizeof(pcloud_point_t) * PCLOUD_BATCH_MAX);
+    if (pc->lut == NULL || pc->angle == NULL || pc->range == NULL || pc->facet == NULL || pc->chunk == NULL)
+    {
+        pcloudDestroy(pc);
+        return NULL;
+    }
+    pc->points = (pcloud_point_t*)(pc->chunk + PCLOUD_HDR_MAX);
+    pc->format = format;
+    pc->facets = facets;
+    pc->angle0_deg = angle0_deg;
+    pc->bin_scale = PCLOUD_LUT_BINS / span_deg;
+
+    // direction cosines over each facet's span, one entry past the end for interpolation
+    for (uint32_t f = 0; f < facets; f++)
+    {
+        double el = (elev_deg != NULL) ? elev_deg[f] * PCLOUD_DEG2RAD : 0.0;
+        float* lut = pc->lut + (size_t)3 * f * (PCLOUD_LUT_BINS + 1);
+        for (uint32_t b = 0; b <= PCLOUD_LUT_BINS; b++)
+        {
+            double az = (angle0_deg + span_deg * b / PCLOUD_LUT_BINS) * PCLOUD_DEG2RAD;
+            lut[3 * b] = cos(el) * cos(az);
+            lut[3 * b + 1] = cos(el) * sin(az);
+            lut[3 * b + 2] = sin(el);
+        }
+    }
+    return pc;
+} // end pcloudCreate()
+
+size_t pcloudHeader(const pcloud_t* pc, char* buf, uint64_t npoints)
+{
+    // fixed-width counts keep the header length constant, so a file header can be rewritten in place
+    unsigned long long n = npoints;
+    if (pc->format == PCLOUD_PCD)
+    {
+        return snprintf(buf, PCLOUD_HDR_MAX,
+                        "# .PCD v0.7 - Point Cloud Data file format\n"
+                        "VERSION 0.7\nFIELDS x y z facet\nSIZE 4 4 4 1\nTYPE F F F U\nCOUNT 1 1 1 1\n"
+                        "WIDTH %012llu\nHEIGHT 1\nVIEWPOINT 0 0 0 1 0 0 0\nPOINTS %012llu\nDATA binary\n",
+                        n, n);
+    }
+    return snprintf(buf, PCLOUD_HDR_MAX,
+                    "ply\nformat binary_little_endian 1.0\nelement vertex %012llu\n"
+                    "property float x\nproperty float y\nproperty float z\nproperty uchar facet\nend_header\n",
+                    n);
+} // end pcloudHeader()
+
+int pcloudOpenFile(pcloud_t* pc, const char* path)
+{
+    pc->file = fopen(path, "wb");
+    if (pc->file == NULL)
+    {
+        perror("pcloudOpenFile");
+        return -1;
+    }
+    char hdr[PCLOUD_HDR_MAX];
+    fwrite(hdr, 1, pcloudHeader(pc, hdr, 0), pc->file);
+    fflush(pc->file);
+    pc->file_points = 0;
+    return 0;
+} // end pcloudOpenFile()
+
+void pcloudSetStream(pcloud_t* pc, pcloud_write_fn write, void* arg)
+{
+    pc->write = write;
+    pc->write_arg = arg;
+} // end pcloudSetStream()
+
+// Converts the pending batch into pc->points
+static void pcloudConvert(pcloud_t* pc, uint32_t n)
+{
+    const float* restrict angle = pc->angle;
+    const float* restrict range = pc->range;
+    const uint8_t* restrict facet = pc->facet;
+    const float* restrict lut = pc->lut;
+    pcloud_point_t* restrict points = pc->points;
+    const float angle0 = pc->angle0_deg;
+    const float scale = pc->bin_scale;
+    const float max_pos = PCLOUD_LUT_BINS - 1e-3f;
+
+    for (uint32_t i = 0; i < n; i++)
+    {
+        // angles outside the facet's span are clamped to its ends
+        float pos = fminf(fmaxf((angle[i] - angle0) * scale, 0.0f), max_pos);
+        uint32_t bin = (uint32_t)pos;
+        float t = pos - bin;
+        const float* l = lut + 3 * ((size_t)facet[i] * (PCLOUD_LUT_BINS + 1) + bin);
+        float r = range[i];
+
+        points[i].x = r * (l[0] + t * (l[3] - l[0]));
+        points[i].y = r * (l[1] + t * (l[4] - l[1]));
+        points[i].z = r * (l[2] + t * (l[5] - l[2]));
+        points[i].facet = facet[i];
+    }
+} // end pcloudConvert()
+
+void pcloudAdd(pcloud_t* pc, uint8_t facet, float angle_deg, float range_m, double time)
+{
+    if (facet >= pc->facets) return;
+    if (pc->pending == 0) pc->pending_time = time;
+
+    pc->angle[pc->pending] = angle_deg;
+    pc->range[pc->pending] = range_m;
+    pc->facet[pc->pending] = facet;
+    if (++pc->pending == PCLOUD_BATCH_MAX)
+    {
+        pcloudFlush(pc);
+    }
+} // end pcloudAdd()
+
+void pcloudPoll(pcloud_t* pc, double time)
+{
+    if (pc->pending > 0 && time - pc->pending_time >= PCLOUD_FLUSH_SEC)
+    {
+        pcloudFlush(pc);
+    }
+} // end pcloudPoll()
+
+void pcloudFlush(pcloud_t* pc)
+{
+    uint32_t n = pc->pending;
+    if (n == 0) return;
+    pc->pending = 0;
+
+    pcloudConvert(pc, n);
+    size_t len = n * sizeof(pcloud_point_t);
+    char hdr[PCLOUD_HDR_MAX];
+
+    if (pc->file != NULL)
+    {
+        // points first, then the count, so the header never claims points not yet written
+        fwrite(pc->points, 1, len, pc->file);
+        fflush(pc->file);
+        pc->file_points += n;
+        long end = ftell(pc->file);
+        fseek(pc->file, 0, SEEK_SET);
+        fwrite(hdr, 1, pcloudHeader(pc, hdr, pc->file_points), pc->file);
+        fseek(pc->file, end, SEEK_SET);
+        fflush(pc->file);
+    }
+    if (pc->write != NULL)
+    {
+        // header placed directly in front of the points
+        size_t hdr_len = pcloudHeader(pc, hdr, n);
+        uint8_t* start = (uint8_t*)pc->points - hdr_len;
+        memcpy(start, hdr, hdr_len);
+        if (pc->write(start, hdr_len + len, pc->write_arg) < 0) pc->stream_dropped++;
+    }
+    pc->points_total += n;
+    pc->batches++;
+} // end pcloudFlush()
+
+void pcloudPrintStats(pcloud_t* pc, FILE* stream)
+{
+    fprintf(stream, "point cloud: %llu points in %llu batches (%.1f per batch), %u pending",
+            (unsigned long long)pc->points_total, (unsigned long long)pc->batches,
+            pc->batches ? (double)pc->points_total / pc->batches : 0.0, pc->pending);
+    if (pc->write != NULL)
+    {
+        fprintf(stream, ", %llu batches not streamed", (unsigned long long)pc->stream_dropped);
+    }
+    fprintf(stream, "\n");
+} // end pcloudPrintStats()
+
+void pcloudDestroy(pcloud_t* pc)
+{
+    if (pc == NULL) return;
+    if (pc->lut != NULL && pc->chunk != NULL)
+    {
+        pcloudFlush(pc);
+    }
+    if (pc->file != NULL)
+    {
+        fclose(pc->file);
+    }
+    free(pc->lut);
+    free(pc->angle);
+    free(pc->range);
+    free(pc->facet);
+    free(pc->chunk);
+    free(pc);
+} // end pcloudDestroy()
@@ -0,0 +1,106 @@
+#ifndef _PCLOUD_H_
+#define _PCLOUD_H_
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#define PCLOUD_LUT_BINS 4096    // trig table intervals per facet; interpolated linearly
+#define PCLOUD_BATCH_MAX 1024   // points converted and written at once
+#define PCLOUD_FLUSH_SEC 0.1    // a partial batch is written once its oldest point is this old
+#define PCLOUD_HDR_MAX 512      // longest header
+
+/** Point-cloud builder.
+ *  Turns (facet, scan angle, range) samples into Cartesian points while acquiring, so consumers
+ *  receive x, y, z instead of redoing the geometry over the CSV.
+ *
+ *  Geometry: each facet sweeps the beam through span_deg of optical angle starting at
+ *  angle0_deg, and may tilt it out of the scan plane by the facet's elevation (a pyramidal
+ *  polygon scans one line per facet):
+ *    x = r cos(el) cos(az), y = r cos(el) sin(az), z = r sin(el)
+ *  Each facet has its own table of (cos(el) cos(az), cos(el) sin(az), sin(el)) over its span,
+ *  so a point costs one table lookup, an interpolation and three multiplies; no trig is
+ *  evaluated while acquiring.
+ *
+ *  Samples are gathered into structure-of-arrays batches and converted in one branch-free loop
+ *  per batch, which the compiler can vectorise apart from the table gathers.
+ *
+ *  Output, binary little-endian, points of float x, y, z (m) and uchar facet:
+ *    file   - one PLY or PCD file whose header point count is rewritten after every batch,
+ *             so the file is valid at any time, even if the program is killed
+ *    stream - every batch as a self-contained PLY or PCD chunk (header + points) passed to a
+ *             write function, e.g. a TCP handler; the write function must not block, and a
+ *             chunk it cannot take is dropped and counted
+ */
+
+enum PCLOUD_FORMAT
+{
+    PCLOUD_PLY,
+    PCLOUD_PCD
+};
+
+typedef struct __attribute__((packed)) PcloudPoint {
+    float x;
+    float y;
+    float z;
+    uint8_t facet;
+} pcloud_point_t;
+
+// Receives one streamed chunk; buf is valid only during the call. Returns 0, or -1 if the chunk was dropped.
+typedef int (*pcloud_write_fn)(const void* buf, size_t len, void* arg);
+
+typedef struct Pcloud {
+    enum PCLOUD_FORMAT format;
+    uint32_t facets;
+    float angle0_deg;           // scan angle at the start of each facet
+    float bin_scale;            // table intervals per degree
+    float* lut;                 // [facet][PCLOUD_LUT_BINS + 1][3]
+    // pending batch
+    float* angle;
+    float* range;
+    uint8_t* facet;
+    uint32_t pending;
+    double pending_time;        // sample time of the oldest pending point
+    // converted batch, preceded by room for a chunk header
+    uint8_t* chunk;
+    pcloud_point_t* points;
+    // outputs
+    FILE* file;                 // NULL unless pcloudOpenFile() succeeded
+    uint64_t file_points;
+    pcloud_write_fn write;      // NULL unless pcloudSetStream() was called
+    void* write_arg;
+    uint64_t stream_dropped;    // chunks the write function did not take
+    uint64_t points_total;
+    uint64_t batches;
+} pcloud_t;
+
+/**Allocates a builder for facets facets, each sweeping span_deg from angle0_deg, with elev_deg
+ * the elevation of each facet (NULL for a flat scan). Returns NULL on failure.
+ */
+pcloud_t* pcloudCreate(enum PCLOUD_FORMAT format, uint32_t facets, const float* elev_deg, double angle0_deg,
+                       double span_deg);
+
+// Writes points to path, replacing it. Returns 0 or -1.
+int pcloudOpenFile(pcloud_t* pc, const char* path);
+
+// Passes every batch to write as a self-contained chunk
+void pcloudSetStream(pcloud_t* pc, pcloud_write_fn write, void* arg);
+
+// Queues one point measured at time (seconds); converts and writes the batch when it is full
+void pcloudAdd(pcloud_t* pc, uint8_t facet, float angle_deg, float range_m, double time);
+
+// Converts and writes the pending points if the oldest is PCLOUD_FLUSH_SEC older than time
+void pcloudPoll(pcloud_t* pc, double time);
+
+// Converts and writes the pending points
+void pcloudFlush(pcloud_t* pc);
+
+// Header for npoints points; returns its length
+size_t pcloudHeader(const pcloud_t* pc, char* buf, uint64_t npoints);
+
+void pcloudPrintStats(pcloud_t* pc, FILE* stream);
+
+// Writes the pending points, closes the file and frees the builder
+void pcloudDestroy(pcloud_t* pc);
+
+#endif
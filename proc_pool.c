@@ -0,0 +1,235 @@
+#define _GNU_SOURCE
+#include "proc_pool.h"
+#include <string.h>
+#include <time.h>
+
+proc_pool_t* procPoolCreate(uint32_t slots, uint32_t in_size, uint32_t out_size, int workers,
+                            proc_work_fn work, proc_emit_fn emit, void* arg)
+{
+    if (slots == 0 || (slots & (slots - 1)) != 0 || workers < 0 || workers > PROC_MAX_WORKERS) return NULL;
+
+    proc_pool_t* pool = (proc_pool_t*)aligned_alloc(64, (sizeof(proc_pool_t) + 63) & ~(size_t)63);
+    if (pool == NULL) return NULL;
+    memset(pool, 0, sizeof(proc_pool_t));
+
+    // areas rounded up to whole cache lines so workers on neighbouring slots never share one
+    pool->in_size = (in_size + 63) & ~63u;
+    pool->out_size = (out_size + 63) & ~63u;
+    pool->in = (uint8_t*)aligned_alloc(64, (size_t)slots * pool->in_size);
+    pool->out = (uint8_t*)aligned_alloc(64, (size_t)slots * pool->out_size);
+    pool->done = (_Atomic uint64_t*)calloc(slots, sizeof(uint64_t));
+    if (pool->in == NULL || pool->out == NULL || pool->done == NULL)
+    {
+        procPoolDestroy(pool);
+        return NULL;
+    }
+
+    pool->mask = slots - 1;
+    pool->workers = workers;
+    pool->work = work;
+    pool->emit = emit;
+    pool->arg = arg;
+    atomic_init(&pool->posted, 0);
+    atomic_init(&pool->claimed, 0);
+    atomic_init(&pool->emitted, 0);
+    atomic_init(&pool->running, true);
+    atomic_init(&pool->batches, 0);
+    for (uint32_t i = 0; i < slots; i++) atomic_init(&pool->done[i], 0);
+    return pool;
+} // end procPoolCreate()
+
+// Idle wait: spin for the first PROC_SPIN_CHECKS empty checks, then sleep
+static inline void procIdle(uint32_t* idle)
+{
+    if (++*idle < PROC_SPIN_CHECKS) return;
+    struct timespec nap = {.tv_sec = 0, .tv_nsec = PROC_SLEEP_NSEC};
+    nanosleep(&nap, NULL);
+}
+
+static void* procWorkerMain(void* arg)
+{
+    proc_pool_t* pool = (proc_pool_t*)arg;
+    uint32_t idle = 0;
+
+    while (1)
+    {
+        uint64_t first = atomic_load_explicit(&pool->claimed, memory_order_relaxed);
+        uint64_t posted = atomic_load_explicit(&pool->posted, memory_order_acquire);
+        if (first == posted)
+        {
+            // the producer has finished before the pool is stopped, so posted is final here
+            if (!atomic_load(&pool->running) && posted == atomic_load(&pool->posted)) break;
+            procIdle(&idle);
+            continue;
+        }
+
+        // take every waiting job up to a batch; another worker may have taken them first
+        uint64_t end = (posted - first > PROC_BATCH_MAX) ? first + PROC_BATCH_MAX : posted;
+        if (!atomic_compare_exchange_weak(&pool->claimed, &first, end)) continue;
+        idle = 0;
+        atomic_fetch_add_explicit(&pool->batches, 1, memory_order_relaxed);
+
+        for (uint64_t seq = first; seq < end; seq++)
+        {
+            uint32_t slot = seq & pool->mask;
+            pool->work(pool->in + (size_t)slot * pool->in_size, pool->out + (size_t)slot * pool->out_size, pool->arg);
+            atomic_store_explicit(&pool->done[slot], seq + 1, memory_order_release);
+        }
+    }
+    return NULL;
+} // end procWorkerMain()
+
+// Reassembly thread; emits finished jobs in job order
+static void* procEmitMain(void* arg)
+{
+    proc_pool_t* pool = (proc_pool_t*)arg;
+    uint64_t seq = atomic_load_explicit(&pool->emitted, memory_order_relaxed);
+    uint32_t idle = 0;
+
+    while (1)
+    {
+        uint32_t slot = seq & pool->mask;
+        if (atomic_load_explicit(&pool->done[slot], memory_order_acquire) != seq + 1)
+        {
+            if (!atomic_load(&pool->running) && seq == atomic_load(&pool->posted)) break;
+            procIdle(&idle);
+            continue;
+        }
+        idle = 0;
+
+        // emit every consecutive finished job, then release their slots together
+        do
+        {
+            pool->emit(pool->out + (size_t)slot * pool->out_size, seq, pool->arg);
+            seq++;
+            slot = seq & pool->mask;
+        } while (atomic_load_explicit(&pool->done[slot], memory_order_acquire) == seq + 1);
+
+        atomic_store_explicit(&pool->emitted, seq, memory_order_release);
+    }
+    return NULL;
+} // end procEmitMain()
+
+int procPoolStart(proc_pool_t* pool, const cpu_set_t* cpus)
+{
+    if (pool->workers == 0) return 0; // inline
+
+    // time-shared from creation even when started from a real-time thread; raise with pthread_setschedparam()
+    struct sched_param param = {.sched_priority = 0};
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+    pthread_attr_setschedpolicy(&attr, SCHED_OTHER);
+    pthread_attr_setschedparam(&attr, &param);
+    if (cpus != NULL)
+    {
+        pthread_attr_setaffinity_np(&attr, sizeof(cpu_set_t), cpus);
+    }
+
+    if (pthread_create(&pool->emit_tid, &attr, &procEmitMain, pool) != 0)
+    {
+        perror("procPoolStart");
+        pthread_attr_destroy(&attr);
+        return -1;
+    }
+    pool->started = true;
+
+    for (int i = 0; i < pool->workers; i++)
+    {
+        if (pthread_create(&pool->worker_tids[i], &attr, &procWorkerMain, pool) != 0)
+        {
+            perror("procPoolStart");
+            pool->workers = i; // procPoolStop() joins only the workers that were started
+        }
+    }
+    pthread_attr_destroy(&attr);
+
+    if (pool->workers == 0)
+    {
+        procPoolStop(pool);
+        return -1;
+    }
+    return 0;
+} // end procPoolStart()
+
+void* procPoolClaim(proc_pool_t* pool)
+{
+    uint64_t seq = atomic_load_explicit(&pool->posted, memory_order_relaxed);
+    uint64_t slots = (uint64_t)pool->mask + 1;
+
+    if (seq - atomic_load_explicit(&pool->emitted, memory_order_acquire) >= slots)
+    {
+        pool->producer_waits++;
+        uint32_t idle = 0;
+        while (seq - atomic_load_explicit(&pool->emitted, memory_order_acquire) >= slots)
+        {
+            procIdle(&idle);
+        }
+    }
+    return pool->in + (size_t)(seq & pool->mask) * pool->in_size;
+} // end procPoolClaim()
+
+void procPoolSubmit(proc_pool_t* pool)
+{
+    if (pool->workers == 0) // inline; the job is emitted before it counts as posted
+    {
+        uint64_t seq = atomic_load_explicit(&pool->posted, memory_order_relaxed);
+        uint32_t slot = seq & pool->mask;
+        uint8_t* out = pool->out + (size_t)slot * pool->out_size;
+        pool->work(pool->in + (size_t)slot * pool->in_size, out, pool->arg);
+        pool->emit(out, seq, pool->arg);
+        atomic_store_explicit(&pool->claimed, seq + 1, memory_order_relaxed);
+        atomic_store_explicit(&pool->emitted, seq + 1, memory_order_release);
+    }
+    atomic_fetch_add_explicit(&pool->posted, 1, memory_order_release);
+} // end procPoolSubmit()
+
+void procPoolDrain(proc_pool_t* pool)
+{
+    uint64_t posted = atomic_load_explicit(&pool->posted, memory_order_relaxed);
+    uint32_t idle = 0;
+    while (atomic_load_explicit(&pool->emitted, memory_order_acquire) != posted)
+    {
+        procIdle(&idle);
+    }
+} // end procPoolDrain()
+
+void procPoolStop(proc_pool_t* pool)
+{
+    if (pool == NULL) return;
+
+    atomic_store(&pool->running, false);
+    if (!pool->started) return;
+
+    for (int i = 0; i < pool->workers; i++)
+    {
+        pthread_join(pool->worker_tids[i], NULL);
+    }
+    pthread_join(pool->emit_tid, NULL);
+    pool->started = false;
+} // end procPoolStop()
+
+void procPoolPrintStats(proc_pool_t* pool, FILE* stream)
+{
+    uint64_t posted = atomic_load(&pool->posted);
+    uint64_t batches = atomic_load(&pool->batches);
+    if (pool->workers == 0)
+    {
+        fprintf(stream, "processor pool: inline, %llu jobs\n", (unsigned long long)posted);
+        return;
+    }
+    fprintf(stream, "processor pool: %d workers, %llu jobs, %.1f jobs per batch, %llu in flight, %llu producer waits\n",
+            pool->workers, (unsigned long long)posted,
+            batches ? (double)atomic_load(&pool->claimed) / batches : 0.0,
+            (unsigned long long)(posted - atomic_load(&pool->emitted)),
+            (unsigned long long)pool->producer_waits);
+} // end procPoolPrintStats()
+
+void procPoolDestroy(proc_pool_t* pool)
+{
+    if (pool == NULL) return;
+    free(pool->in);
+    free(pool->out);
+    free((void*)pool->done);
+    free(pool);
+} // end procPoolDestroy()
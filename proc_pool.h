@@ -0,0 +1,90 @@
+#ifndef _PROC_POOL_H_
+#define _PROC_POOL_H_
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sched.h> // cpu_set_t; define _GNU_SOURCE before any include
+
+#define PROC_MAX_WORKERS 8      // worker threads per pool
+#define PROC_BATCH_MAX 32       // jobs a worker takes at once when several are waiting
+#define PROC_SPIN_CHECKS 64     // empty checks before an idle thread starts sleeping
+#define PROC_SLEEP_NSEC 50000   // idle thread poll interval
+
+/** Data processor pool.
+ *  Jobs are submitted by a single producer into a ring of slots, each with a fixed-size input
+ *  and output area, and numbered in submission order. Worker threads take whatever jobs are
+ *  waiting (up to PROC_BATCH_MAX at a time), run work(in, out) on them concurrently and mark
+ *  them done. A reassembly thread passes the outputs to emit(out, seq) strictly in job order,
+ *  so everything downstream of emit sees the same order as the producer, and emit itself never
+ *  runs concurrently with itself.
+ *
+ *  A slot is reused only after its job was emitted; the producer waits in procPoolClaim()
+ *  while every slot is in flight.
+ *
+ *  With no workers the pool runs inline: procPoolSubmit() runs work and emit on the producer
+ *  thread and no threads are started. The pool only pays off where its threads get cores of
+ *  their own; on a shared core the hand-offs cost more than the decode they move.
+ *
+ *  Usage: procPoolCreate(); procPoolStart(); then on the producer thread procPoolClaim() an
+ *  input area, fill it and procPoolSubmit() it. procPoolStop() emits every submitted job
+ *  and joins the threads.
+ */
+
+typedef void (*proc_work_fn)(void* in, void* out, void* arg);      // worker threads, concurrently
+typedef void (*proc_emit_fn)(void* out, uint64_t seq, void* arg);  // reassembly thread, in job order
+
+typedef struct ProcPool {
+    _Atomic uint64_t posted;    // jobs submitted
+    uint8_t pad0[56];
+    _Atomic uint64_t claimed;   // jobs taken by workers
+    uint8_t pad1[56];
+    _Atomic uint64_t emitted;   // jobs passed to emit
+    uint8_t pad2[56];
+    _Atomic uint64_t* done;     // per slot: job number + 1 once the job's work is finished
+    uint8_t* in;
+    uint8_t* out;
+    uint32_t in_size;
+    uint32_t out_size;
+    uint32_t mask;              // slot count - 1
+    proc_work_fn work;
+    proc_emit_fn emit;
+    void* arg;
+    int workers;
+    pthread_t worker_tids[PROC_MAX_WORKERS];
+    pthread_t emit_tid;
+    atomic_bool running;        // cleared by procPoolStop()
+    bool started;
+    _Atomic uint64_t batches;   // worker batches taken; jobs per batch = claimed / batches
+    uint64_t producer_waits;    // procPoolClaim() calls that found every slot in flight
+} proc_pool_t;
+
+/**Allocates a pool of slots slots (a power of 2) with in_size byte inputs and out_size byte
+ * outputs, served by workers worker threads, or inline if workers is 0. Returns NULL on failure.
+ */
+proc_pool_t* procPoolCreate(uint32_t slots, uint32_t in_size, uint32_t out_size, int workers,
+                            proc_work_fn work, proc_emit_fn emit, void* arg);
+
+// Starts the worker and reassembly threads, SCHED_OTHER and restricted to cpus if not NULL; none if inline. Returns 0 or -1.
+int procPoolStart(proc_pool_t* pool, const cpu_set_t* cpus);
+
+// Input area of the next job, waiting while every slot is in flight. Producer thread only.
+void* procPoolClaim(proc_pool_t* pool);
+
+// Submits the job from the last procPoolClaim()
+void procPoolSubmit(proc_pool_t* pool);
+
+// Waits until every submitted job has been emitted. Producer thread only.
+void procPoolDrain(proc_pool_t* pool);
+
+// Emits every submitted job, then joins the threads
+void procPoolStop(proc_pool_t* pool);
+
+void procPoolPrintStats(proc_pool_t* pool, FILE* stream);
+
+// Frees the pool; call procPoolStop() first if started
+void procPoolDestroy(proc_pool_t* pool);
+
+#endif
@@ -0,0 +1,281 @@
+#define _GNU_SOURCE
+#include "rt_profile.h"
+#include <string.h>
+#include <ctype.h>
+#include <malloc.h>
+#include <sys/mman.h>
+#include <sys/sysinfo.h>
+
+static const char* const role_names[RT_ROLE_NUM] = {
+    [RT_ROLE_ACQ] = "acq",
+    [RT_ROLE_PROC] = "proc",
+    [RT_ROLE_SINK] = "sink",
+    [RT_ROLE_LOGGER] = "logger",
+    [RT_ROLE_TCP] = "tcp",
+    [RT_ROLE_CTRL] = "ctrl"};
+
+const char* rtRoleName(enum RT_ROLE role)
+{
+    return (role < RT_ROLE_NUM) ? role_names[role] : "?";
+}
+
+void rtProfileInit(rt_profile_t* profile, int acq_core, int acq_priority)
+{
+    memset(profile, 0, sizeof(rt_profile_t));
+
+    cpu_set_t rest;
+    CPU_ZERO(&rest);
+    for (int i = 0; i < get_nprocs_conf(); i++)
+    {
+        if (i != acq_core) CPU_SET(i, &rest);
+    }
+    for (int r = 0; r < RT_ROLE_NUM; r++)
+    {
+        profile->roles[r].cpus = rest;
+    }
+
+    CPU_ZERO(&profile->roles[RT_ROLE_ACQ].cpus);
+    CPU_SET(acq_core, &profile->roles[RT_ROLE_ACQ].cpus);
+    profile->roles[RT_ROLE_ACQ].priority = acq_priority;
+} // end rtProfileInit()
+
+// Parses a core list such as "0-1,3" up to the first character that is not part of it.
+// Returns a pointer past the list, or NULL if it is malformed or empty.
+static const char* parseCpuList(const char* str, cpu_set_t* cpus)
+{
+    CPU_ZERO(cpus);
+    int count = 0;
+    while (isdigit((unsigned char)*str))
+    {
+        char* end;
+        long first = strtol(str, &end, 10);
+        long last = first;
+        if (*end == '-')
+        {
+            str = end + 1;
+            if (!isdigit((unsigned char)*str)) return NULL;
+            last = strtol(str, &end, 10);
+        }
+        if (first > last || last >= CPU_SETSIZE) return NULL;
+        for (long i = first; i <= last; i++, count++) CPU_SET(i, cpus);
+
+        str = end;
+        if (*str != ',') break;
+        str++;
+    }
+    return count ? str : NULL;
+} // end parseCpuList()
+
+int rtProfileParse(rt_profile_t* profile, const char* spec)
+{
+    const char* eq = strchr(spec, '=');
+    if (eq == NULL) return -1;
+
+    int role = 0;
+    while (role < RT_ROLE_NUM &&
+           !(strlen(role_names[role]) == (size_t)(eq - spec) && strncmp(spec, role_names[role], eq - spec) == 0))
+    {
+        role++;
+    }
+    if (role == RT_ROLE_NUM) return -1;
+
+    cpu_set_t cpus;
+    const char* rest = parseCpuList(eq + 1, &cpus);
+    if (rest == NULL) return -1;
+
+    int priority = profile->roles[role].priority;
+    if (*rest == ':')
+    {
+        char* end;
+        priority = (int)strtol(rest + 1, &end, 10);
+        if (end == rest + 1 || priority < 0 || priority > sched_get_priority_max(SCHED_FIFO)) return -1;
+        rest = end;
+    }
+    if (*rest != '\0') return -1;
+
+    profile->roles[role].cpus = cpus;
+    profile->roles[role].priority = priority;
+    return 0;
+} // end rtProfileParse()
+
+void rtProfileSetAttr(const rt_profile_t* profile, enum RT_ROLE role, pthread_attr_t* attr)
+{
+    const rt_thread_cfg_t* cfg = &profile->roles[role];
+    struct sched_param param = {.sched_priority = cfg->priority};
+    pthread_attr_setaffinity_np(attr, sizeof(cpu_set_t), &cfg->cpus);
+
+    // explicit even for SCHED_OTHER, so a thread created by a real-time thread does not inherit its policy
+    pthread_attr_setinheritsched(attr, PTHREAD_EXPLICIT_SCHED);
+    pthread_attr_setschedpolicy(attr, cfg->priority > 0 ? SCHED_FIFO : SCHED_OTHER);
+    pthread_attr_setschedparam(attr, &param);
+} // end rtProfileSetAttr()
+
+int rtProfileApplyThread(const rt_profile_t* profile, enum RT_ROLE role, pthread_t tid)
+{
+    const rt_thread_cfg_t* cfg = &profile->roles[role];
+    int ret = 0;
+    if (pthread_setaffinity_np(tid, sizeof(cpu_set_t), &cfg->cpus) != 0)
+    {
+        fprintf(stderr, "rtProfileApplyThread: %s affinity not applied\n", role_names[role]);
+        ret = -1;
+    }
+
+    struct sched_param param = {.sched_priority = cfg->priority};
+    if (pthread_setschedparam(tid, cfg->priority > 0 ? SCHED_FIFO : SCHED_OTHER, &param) != 0)
+    {
+        fprintf(stderr, "rtProfileApplyThread: %s priority %d not applied\n", role_names[role], cfg->priority);
+        ret = -1;
+    }
+    return ret;
+} // end rtProfileApplyThread()
+
+// Touches size bytes of the calling thread's stack so it is resident before the shot loop runs
+static void __attribute__((noinline)) prefaultStack(size_t size)
+{
+    char stack[size];
+    memset(stack, 0, size);
+    __asm__ volatile("" : : "r"(stack) : "memory"); // keeps the writes
+}
+
+int rtProfileLockMemory(rt_profile_t* profile)
+{
+    // freed heap memory stays mapped, and large blocks come from the heap, not fresh mappings
+    mallopt(M_TRIM_THRESHOLD, -1);
+    mallopt(M_MMAP_MAX, 0);
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, RT_STACK_SIZE);
+    pthread_setattr_default_np(&attr);
+    pthread_attr_destroy(&attr);
+
+    profile->locked = (mlockall(MCL_CURRENT | MCL_FUTURE) == 0);
+    if (!profile->locked)
+    {
+        perror("rtProfileLockMemory: mlockall");
+    }
+    prefaultStack(RT_STACK_PREFAULT);
+    return profile->locked ? 0 : -1;
+} // end rtProfileLockMemory()
+
+// Reads a sysfs core list; an empty or missing file gives an empty set. Returns false if missing.
+static bool readCpuFile(const char* path, cpu_set_t* cpus)
+{
+    CPU_ZERO(cpus);
+    FILE* fp = fopen(path, "r");
+    if (fp == NULL) return false;
+
+    char line[256] = {0};
+    if (fgets(line, sizeof(line), fp) != NULL && isdigit((unsigned char)line[0]))
+    {
+        parseCpuList(line, cpus);
+    }
+    fclose(fp);
+    return true;
+} // end readCpuFile()
+
+// Prints cpus as a core list
+static void printCpus(FILE* stream, const cpu_set_t* cpus)
+{
+    if (CPU_COUNT(cpus) == 0)
+    {
+        fprintf(stream, "none");
+        return;
+    }
+    const char* sep = "";
+    for (int i = 0; i < CPU_SETSIZE; i++)
+    {
+        if (!CPU_ISSET(i, cpus)) continue;
+        int last = i;
+        while (last + 1 < CPU_SETSIZE && CPU_ISSET(last + 1, cpus)) last++;
+        fprintf(stream, (last > i) ? "%s%d-%d" : "%s%d", sep, i, last);
+        sep = ",";
+        i = last;
+    }
+} // end printCpus()
+
+int rtProfileCheck(const rt_profile_t* profile, FILE* stream)
+{
+    int warnings = 0;
+    bool any_rt = false;
+    cpu_set_t isolated, nohz;
+    readCpuFile(RT_ISOLATED_PATH, &isolated);
+    bool nohz_known = readCpuFile(RT_NOHZ_FULL_PATH, &nohz);
+
+    fprintf(stream, "isolated cores: ");
+    printCpus(stream, &isolated);
+    fprintf(stream, ", nohz_full cores: ");
+    if (nohz_known) printCpus(stream, &nohz);
+    else fprintf(stream, "unsupported");
+    fprintf(stream, ", memory %slocked\n", profile->locked ? "" : "NOT ");
+
+    for (int r = 0; r < RT_ROLE_NUM; r++)
+    {
+        const rt_thread_cfg_t* cfg = &profile->roles[r];
+        cpu_set_t shared;
+        if (cfg->priority > 0)
+        {
+            any_rt = true;
+
+            // a real-time role should own cores the scheduler leaves alone
+            CPU_AND(&shared, &cfg->cpus, &isolated);
+            if (!CPU_EQUAL(&shared, &cfg->cpus))
+            {
+                fprintf(stream, "WARNING: real-time role %s runs on cores not in isolcpus\n", role_names[r]);
+                warnings++;
+            }
+            CPU_AND(&shared, &cfg->cpus, &nohz);
+            if (nohz_known && !CPU_EQUAL(&shared, &cfg->cpus))
+            {
+                fprintf(stream, "WARNING: real-time role %s runs on cores not in nohz_full\n", role_names[r]);
+                warnings++;
+            }
+            for (int o = 0; o < RT_ROLE_NUM; o++)
+            {
+                CPU_AND(&shared, &cfg->cpus, &profile->roles[o].cpus);
+                if (o != r && CPU_COUNT(&shared) > 0)
+                {
+                    fprintf(stream, "WARNING: real-time role %s shares cores with %s\n", role_names[r], role_names[o]);
+                    warnings++;
+                }
+            }
+        }
+        else
+        {
+            // the kernel does not balance threads across isolated cores, so they pile onto one
+            CPU_AND(&shared, &cfg->cpus, &isolated);
+            if (CPU_COUNT(&shared) > 0)
+            {
+                fprintf(stream, "WARNING: role %s is placed on isolated cores\n", role_names[r]);
+                warnings++;
+            }
+        }
+    }
+
+    // with throttling enabled, busy-waiting SCHED_FIFO threads are stopped for the rest of each period
+    FILE* fp = any_rt ? fopen(RT_RUNTIME_PATH, "r") : NULL;
+    long rt_runtime = -1;
+    if (fp != NULL)
+    {
+        if (fscanf(fp, "%ld", &rt_runtime) != 1) rt_runtime = -1;
+        fclose(fp);
+    }
+    if (rt_runtime >= 0)
+    {
+        fprintf(stream, "WARNING: real-time throttling enabled (%s = %ld); write -1 to disable it\n",
+                RT_RUNTIME_PATH, rt_runtime);
+        warnings++;
+    }
+    return warnings;
+} // end rtProfileCheck()
+
+void rtProfilePrint(const rt_profile_t* profile, FILE* stream)
+{
+    for (int r = 0; r < RT_ROLE_NUM; r++)
+    {
+        fprintf(stream, "%-7s cores ", role_names[r]);
+        printCpus(stream, &profile->roles[r].cpus);
+        if (profile->roles[r].priority > 0) fprintf(stream, ", SCHED_FIFO %d\n", profile->roles[r].priority);
+        else fprintf(stream, ", SCHED_OTHER\n");
+    }
+} // end rtProfilePrint()
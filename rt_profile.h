@@ -0,0 +1,87 @@
+#ifndef _RT_PROFILE_H_
+#define _RT_PROFILE_H_
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sched.h> // cpu_set_t; define _GNU_SOURCE before any include
+
+#define RT_STACK_SIZE (256 * 1024)         // default stack of threads created after rtProfileLockMemory()
+#define RT_STACK_PREFAULT (64 * 1024)      // calling thread's stack touched by rtProfileLockMemory()
+#define RT_ISOLATED_PATH "/sys/devices/system/cpu/isolated"
+#define RT_NOHZ_FULL_PATH "/sys/devices/system/cpu/nohz_full"
+#define RT_RUNTIME_PATH "/proc/sys/kernel/sched_rt_runtime_us"
+
+/** Real-time profile.
+ *  Holds where each thread of the program runs and at what priority, chosen once at startup:
+ *  a CPU set per role and, for roles that must meet shot deadlines, a SCHED_FIFO priority.
+ *  Roles with priority 0 keep the default time-sharing policy.
+ *
+ *  rtProfileParse() overrides a role from a "role=cpus[:priority]" string, e.g. "acq=3:80"
+ *  or "logger=0-1,3"; cpus is a list of cores and core ranges.
+ *
+ *  rtProfileLockMemory() locks all current and future mappings in RAM (mlockall), keeps freed
+ *  heap memory mapped, caps the stack of threads created afterwards to RT_STACK_SIZE so their
+ *  locked stacks stay small, and touches the calling thread's stack. Mappings locked with
+ *  MCL_FUTURE are populated when they are created, so buffers allocated afterwards are already
+ *  resident when the shot loop first writes them.
+ *
+ *  rtProfileCheck() reports the kernel's isolated and nohz_full cores and warns when a
+ *  real-time role shares a core the kernel still balances or ticks on, when a time-sharing
+ *  role was placed on an isolated core, or when real-time throttling can preempt a
+ *  busy-waiting SCHED_FIFO thread.
+ */
+
+enum RT_ROLE
+{
+    RT_ROLE_ACQ,    // acquisition loop; the main thread
+    RT_ROLE_PROC,   // processor pool workers and reassembly thread
+    RT_ROLE_SINK,   // broadcast ring output sinks
+    RT_ROLE_LOGGER, // data file logger
+    RT_ROLE_TCP,    // TCP handler
+    RT_ROLE_CTRL,   // control plane
+    RT_ROLE_NUM
+};
+
+typedef struct RtThreadCfg {
+    cpu_set_t cpus;             // cores the role's threads may run on
+    int priority;               // SCHED_FIFO priority; 0 for SCHED_OTHER
+} rt_thread_cfg_t;
+
+typedef struct RtProfile {
+    rt_thread_cfg_t roles[RT_ROLE_NUM];
+    bool locked;                // rtProfileLockMemory() succeeded
+} rt_profile_t;
+
+/**Fills profile with the default placement: acquisition on acq_core at SCHED_FIFO acq_priority,
+ * every other role on the remaining cores at priority 0.
+ */
+void rtProfileInit(rt_profile_t* profile, int acq_core, int acq_priority);
+
+// Applies one "role=cpus[:priority]" override. Returns 0, or -1 if spec is malformed.
+int rtProfileParse(rt_profile_t* profile, const char* spec);
+
+// Name of role as accepted by rtProfileParse()
+const char* rtRoleName(enum RT_ROLE role);
+
+// Sets the role's CPU set and scheduling policy on attr, for threads created with it
+void rtProfileSetAttr(const rt_profile_t* profile, enum RT_ROLE role, pthread_attr_t* attr);
+
+/**Moves an existing thread to the role's CPU set and scheduling policy, e.g. threads started by
+ * a module from a CPU set alone. Returns 0, or -1 if either could not be applied.
+ */
+int rtProfileApplyThread(const rt_profile_t* profile, enum RT_ROLE role, pthread_t tid);
+
+/**Locks memory and prefaults the calling thread's stack as described above.
+ * Call before creating threads. Returns 0, or -1 if mlockall() failed (not fatal).
+ */
+int rtProfileLockMemory(rt_profile_t* profile);
+
+// Reports isolation state and profile misconfiguration to stream; returns the number of warnings
+int rtProfileCheck(const rt_profile_t* profile, FILE* stream);
+
+// Prints each role's cores and policy
+void rtProfilePrint(const rt_profile_t* profile, FILE* stream);
+
+#endif
@@ -0,0 +1,200 @@
+#include "sample_shm.h"
+#include <string.h>
+#include <stddef.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+// the layout is shared with other processes; keep it fixed
+_Static_assert(sizeof(sample_shm_slot_t) == 64, "sample_shm_slot_t must be 64 bytes");
+_Static_assert(offsetof(sample_shm_header_t, head) == 64, "head must start at offset 64");
+_Static_assert(sizeof(sample_shm_header_t) <= SAMPLE_SHM_HDR_SIZE, "header overlaps the slots");
+
+// sequence counters are shared between processes, which requires lock-free 64 bit atomics
+#if ATOMIC_LLONG_LOCK_FREE != 2
+#error "sample_shm requires lock-free 64 bit atomics (ARMv7 or later)"
+#endif
+
+sample_shm_t* sampleShmCreate(const char* name, uint32_t slot_count)
+{
+    if (slot_count == 0 || (slot_count & (slot_count - 1)) != 0) return NULL;
+    if (strlen(name) >= sizeof(((sample_shm_t*)0)->name)) return NULL;
+
+    sample_shm_t* shm = (sample_shm_t*)calloc(1, sizeof(sample_shm_t));
+    if (shm == NULL) return NULL;
+
+    // start from a fresh object so readers of a previous run see it closed, not reused
+    shm_unlink(name);
+    int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0644);
+    shm->map_len = SAMPLE_SHM_HDR_SIZE + (size_t)slot_count * sizeof(sample_shm_slot_t);
+    if (fd < 0 || ftruncate(fd, shm->map_len) < 0)
+    {
+        perror("sampleShmCreate");
+        if (fd >= 0) close(fd);
+        shm_unlink(name);
+        free(shm);
+        return NULL;
+    }
+
+    void* map = mmap(NULL, shm->map_len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd); // the mapping keeps the object open
+    if (map == MAP_FAILED)
+    {
+        perror("sampleShmCreate: mmap");
+        shm_unlink(name);
+        free(shm);
+        return NULL;
+    }
+
+    shm->hdr = (sample_shm_header_t*)map;
+    shm->slots = (sample_shm_slot_t*)((char*)map + SAMPLE_SHM_HDR_SIZE);
+    shm->mask = slot_count - 1;
+    shm->producer = true;
+    strcpy(shm->name, name);
+
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+
+    // ftruncate zero-filled the object, so every slot and head start at 0
+    shm->hdr->version = SAMPLE_SHM_VERSION;
+    shm->hdr->slot_size = sizeof(sample_shm_slot_t);
+    shm->hdr->slot_count = slot_count;
+    shm->hdr->start_usec = (uint64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+    atomic_store_explicit(&shm->hdr->state, SAMPLE_SHM_LIVE, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    shm->hdr->magic = SAMPLE_SHM_MAGIC; // readers accept the header from here on
+
+    return shm;
+} // end sampleShmCreate()
+
+void sampleShmPublish(sample_shm_t* shm, const sample_shm_slot_t* sample)
+{
+    uint64_t n = shm->cursor++;
+    sample_shm_slot_t* slot = &shm->slots[n & shm->mask];
+
+    // odd sequence marks the slot as being written before any field changes
+    atomic_store_explicit(&slot->seq, 2 * n + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    slot->time = sample->time;
+    slot->dist = sample->dist;
+    slot->tof = sample->tof;
+    memcpy(slot->raw, sample->raw, sizeof(slot->raw));
+    slot->tdc = sample->tdc;
+    slot->mode = sample->mode;
+    slot->flags = sample->flags;
+    slot->facet = sample->facet;
+    slot->angle = sample->angle;
+
+    atomic_store_explicit(&slot->seq, 2 * n + 2, memory_order_release);
+    atomic_store_explicit(&shm->hdr->head, n + 1, memory_order_release);
+} // end sampleShmPublish()
+
+void sampleShmDestroy(sample_shm_t* shm)
+{
+    if (shm == NULL) return;
+
+    atomic_store_explicit(&shm->hdr->state, SAMPLE_SHM_CLOSED, memory_order_release);
+    munmap(shm->hdr, shm->map_len);
+    shm_unlink(shm->name);
+    free(shm);
+} // end sampleShmDestroy()
+
+/******** Client ********/
+sample_shm_t* sampleShmOpen(const char* name)
+{
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) return NULL;
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < SAMPLE_SHM_HDR_SIZE)
+    {
+        close(fd);
+        return NULL;
+    }
+
+    void* map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return NULL;
+
+    sample_shm_header_t* hdr = (sample_shm_header_t*)map;
+    bool ok = hdr->magic == SAMPLE_SHM_MAGIC;
+    atomic_thread_fence(memory_order_acquire);
+    ok = ok && hdr->version == SAMPLE_SHM_VERSION &&
+         hdr->slot_size == sizeof(sample_shm_slot_t) &&
+         hdr->slot_count != 0 && (hdr->slot_count & (hdr->slot_count - 1)) == 0 &&
+         (size_t)st.st_size >= SAMPLE_SHM_HDR_SIZE + (size_t)hdr->slot_count * sizeof(sample_shm_slot_t);
+
+    sample_shm_t* shm = ok ? (sample_shm_t*)calloc(1, sizeof(sample_shm_t)) : NULL;
+    if (shm == NULL)
+    {
+        munmap(map, st.st_size);
+        return NULL;
+    }
+
+    shm->hdr = hdr;
+    shm->slots = (sample_shm_slot_t*)((char*)map + SAMPLE_SHM_HDR_SIZE);
+    shm->map_len = st.st_size;
+    shm->mask = hdr->slot_count - 1;
+    shm->cursor = atomic_load_explicit(&hdr->head, memory_order_acquire);
+    return shm;
+} // end sampleShmOpen()
+
+int sampleShmRead(sample_shm_t* shm, sample_shm_slot_t* out, int max)
+{
+    // state is read before head so a close is only reported after the final head is seen
+    bool closed = atomic_load_explicit(&shm->hdr->state, memory_order_acquire) == SAMPLE_SHM_CLOSED;
+    uint64_t head = atomic_load_explicit(&shm->hdr->head, memory_order_acquire);
+    uint64_t slot_count = (uint64_t)shm->mask + 1;
+    int n = 0;
+
+    while (n < max && shm->cursor < head)
+    {
+        // skip samples the producer has already lapped
+        if (head - shm->cursor > slot_count)
+        {
+            shm->lost += head - slot_count - shm->cursor;
+            shm->cursor = head - slot_count;
+        }
+
+        const sample_shm_slot_t* slot = &shm->slots[shm->cursor & shm->mask];
+        uint64_t want = 2 * shm->cursor + 2;
+
+        uint64_t s1 = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        out[n].time = slot->time;
+        out[n].dist = slot->dist;
+        out[n].tof = slot->tof;
+        memcpy(out[n].raw, slot->raw, sizeof(out[n].raw));
+        out[n].tdc = slot->tdc;
+        out[n].mode = slot->mode;
+        out[n].flags = slot->flags;
+        out[n].facet = slot->facet;
+        out[n].angle = slot->angle;
+        atomic_thread_fence(memory_order_acquire);
+        uint64_t s2 = atomic_load_explicit(&slot->seq, memory_order_relaxed);
+
+        if (s1 == want && s2 == want)
+        {
+            atomic_store_explicit(&out[n].seq, shm->cursor, memory_order_relaxed);
+            n++;
+        }
+        else
+        {
+            shm->lost++; // overwritten while being read; catch up with the producer
+            head = atomic_load_explicit(&shm->hdr->head, memory_order_acquire);
+        }
+        shm->cursor++;
+    }
+
+    return (n == 0 && closed && shm->cursor >= head) ? -1 : n;
+} // end sampleShmRead()
+
+void sampleShmClose(sample_shm_t* shm)
+{
+    if (shm == NULL) return;
+    munmap(shm->hdr, shm->map_len);
+    free(shm);
+} // end sampleShmClose()
+/************************/
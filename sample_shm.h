@@ -0,0 +1,118 @@
+#ifndef _SAMPLE_SHM_H_
+#define _SAMPLE_SHM_H_
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdatomic.h>
+
+/** Shared-memory sample ring.
+ *  The acquisition program publishes every processed sample into a POSIX shared-memory
+ *  object (SAMPLE_SHM_NAME, i.e. /dev/shm/tdc_samples) so that programs on the same host
+ *  can read samples at full rate without TCP, text parsing or a syscall per sample.
+ *  The producer never waits for readers; a reader that falls more than slot_count samples
+ *  behind loses the overwritten samples and is told how many.
+ *
+ *  Layout (all fields little-endian, offsets in bytes):
+ *    0     sample_shm_header_t   magic, version, slot_size, slot_count, start_usec, state
+ *    64    head                  number of samples published so far; own cache line
+ *    4096  slot_count slots of sample_shm_slot_t (64 bytes each)
+ *  Sample n lives in slot n % slot_count. slot_count is a power of 2.
+ *
+ *  Sequence protocol (per slot seqlock):
+ *    producer: slot.seq = 2n+1; write fields; slot.seq = 2n+2; head = n+1
+ *    reader:   s1 = slot.seq; copy fields; s2 = slot.seq
+ *              the copy is sample n only if s1 == s2 == 2n+2; anything else means the
+ *              slot was overwritten by a later lap and sample n is lost
+ *  Each reader keeps its own cursor (the next sample number it wants), so any number of
+ *  readers can attach and detach without coordinating with the producer or each other.
+ *
+ *  Producer: sampleShmCreate(), sampleShmPublish(), sampleShmDestroy().
+ *  Client:   sampleShmOpen(), sampleShmRead(), sampleShmClose(); link sample_shm.o only
+ *            (plus -lrt on older glibc), no pigpio or submodules are needed.
+ */
+
+#define SAMPLE_SHM_NAME "/tdc_samples"
+#define SAMPLE_SHM_MAGIC 0x53434454u // "TDCS"
+#define SAMPLE_SHM_VERSION 2
+#define SAMPLE_SHM_SLOTS 65536       // default slot count; 4 MiB of samples
+#define SAMPLE_SHM_HDR_SIZE 4096     // offset of the first slot
+
+#define SAMPLE_FLAG_VALID 0x01 // a return was measured and passed the parity check
+#define SAMPLE_FLAG_ANGLE 0x02 // facet and angle hold the shot's scan position
+#define SAMPLE_FLAG_DARK 0x04  // taken with the laser shuttered, e.g. for a dark-count reference
+#define SAMPLE_FLAG_END 0x08   // no sample; marks the end of an acquisition to tdc_test's sinks, never published here
+
+enum SAMPLE_SHM_STATE
+{
+    SAMPLE_SHM_INIT,   // producer is still filling in the header
+    SAMPLE_SHM_LIVE,   // samples are being published
+    SAMPLE_SHM_CLOSED  // producer exited; no more samples will follow
+};
+
+typedef struct SampleShmSlot {
+    _Atomic uint64_t seq;   // 2n+1 while sample n is written, 2n+2 once complete
+    double time;            // seconds since the epoch
+    double dist;            // meters; -999 if not valid
+    double tof;             // seconds, after the per-TDC offset; -999 if not valid
+    uint32_t raw[5];        // TIME1, CLOCK_COUNT1, TIME2, CAL1, CAL2
+    uint8_t tdc;            // TDC id
+    uint8_t mode;           // measurement mode, 1 or 2
+    uint8_t flags;          // SAMPLE_FLAG_*
+    uint8_t facet;          // mirror facet of the shot
+    float angle;            // optical scan angle in degrees; -999 if not known
+    uint32_t reserved;
+} sample_shm_slot_t;
+
+typedef struct SampleShmHeader {
+    uint32_t magic;               // SAMPLE_SHM_MAGIC once the header is complete
+    uint32_t version;             // SAMPLE_SHM_VERSION
+    uint32_t slot_size;           // sizeof(sample_shm_slot_t)
+    uint32_t slot_count;          // power of 2
+    uint64_t start_usec;          // producer start time; differs after a restart
+    _Atomic uint32_t state;       // enum SAMPLE_SHM_STATE
+    uint8_t reserved[36];
+    _Atomic uint64_t head;        // samples published (offset 64)
+} sample_shm_header_t;
+
+// Producer handle or client handle, depending on how it was obtained
+typedef struct SampleShm {
+    sample_shm_header_t* hdr;
+    sample_shm_slot_t* slots;
+    size_t map_len;
+    uint32_t mask;          // slot_count - 1
+    bool producer;
+    char name[64];          // unlinked by the producer on destroy
+    uint64_t cursor;        // producer: next sample number; client: next sample to read
+    uint64_t lost;          // client: samples overwritten before they were read
+} sample_shm_t;
+
+/**Creates (replacing any old object) and maps the ring name with slot_count slots
+ * (a power of 2). Returns NULL on failure.
+ */
+sample_shm_t* sampleShmCreate(const char* name, uint32_t slot_count);
+
+/**Publishes sample as the next sample; its seq field is ignored.
+ * Producer only; one thread at a time.
+ */
+void sampleShmPublish(sample_shm_t* shm, const sample_shm_slot_t* sample);
+
+// Marks the ring closed, unmaps and unlinks it
+void sampleShmDestroy(sample_shm_t* shm);
+
+/**Attaches to the ring name read-only. The cursor starts at the newest sample, so only
+ * samples published after attaching are read. Returns NULL if the ring does not exist
+ * or its layout does not match this library.
+ */
+sample_shm_t* sampleShmOpen(const char* name);
+
+/**Copies up to max samples, oldest first, into out; out[i].seq holds the sample number.
+ * Returns the number copied (0 if none are new), or -1 once the producer has closed the
+ * ring and every sample has been read. Samples lost to overwriting are added to shm->lost.
+ */
+int sampleShmRead(sample_shm_t* shm, sample_shm_slot_t* out, int max);
+
+// Detaches a client
+void sampleShmClose(sample_shm_t* shm);
+
+#endif
@@ -0,0 +1,122 @@
+#include "scan_phase.h"
+#include <string.h>
+#include <math.h>
+
+void scanPhaseInit(scan_phase_t* phase, uint32_t facets)
+{
+    memset(phase, 0, sizeof(scan_phase_t));
+    phase->facets = (facets == 0) ? 1 : (facets > SCAN_MAX_FACETS) ? SCAN_MAX_FACETS : facets;
+    for (uint32_t f = 0; f < SCAN_MAX_FACETS; f++)
+    {
+        phase->facet_scale[f] = 1.0f;
+    }
+} // end scanPhaseInit()
+
+void scanPhaseUpdate(scan_phase_t* phase, uint32_t tick)
+{
+    uint32_t raw_interval = tick - phase->last_tick; // unsigned difference survives the tick wrap
+    phase->last_tick = tick;
+    if (phase->edges++ == 0)
+    {
+        phase->edge_tick = tick;
+        phase->sync_edges = 1;
+        return;
+    }
+    if (phase->period_usec == 0) // second edge seeds the period
+    {
+        phase->period_usec = raw_interval;
+        phase->edge_tick = tick;
+        phase->facet = (phase->facet + 1) % phase->facets;
+        return;
+    }
+
+    // duration of the current facet, measured from its estimated start
+    double interval = (uint32_t)(tick - phase->edge_tick) - phase->edge_adj;
+    double expect = phase->period_usec * phase->facet_scale[phase->facet];
+    double err = interval - expect;
+
+    if (fabs(err) > SCAN_SLIP_FRAC * expect)
+    {
+        phase->slips++;
+        phase->locked = 0;
+        if (++phase->slip_run >= SCAN_RELOCK_SLIPS) // rpm changed; start over from raw edges
+        {
+            // every edge since the loop last settled was real, including those taken as spurious
+            phase->period_usec = raw_interval;
+            phase->slip_run = 0;
+            phase->facet = (phase->sync_facet + (uint32_t)(phase->edges - phase->sync_edges)) % phase->facets;
+        }
+        else if (interval < expect) // spurious edge
+        {
+            return;
+        }
+        else // missed edges; keep the facet count in step with the mirror
+        {
+            phase->facet = (phase->facet + (uint32_t)lround(interval / phase->period_usec)) % phase->facets;
+        }
+        phase->edge_tick = tick;
+        phase->edge_adj = 0;
+        return;
+    }
+
+    // an unsettled edge is still tracked but withholds angles, and does not train the jitter so
+    // that a transient cannot widen its own limit
+    bool settled = fabs(err) <= fmax(SCAN_LOCK_JITTERS * phase->jitter_usec, SCAN_LOCK_MIN_USEC);
+
+    phase->period_usec += SCAN_PLL_BETA * err;
+    phase->facet_scale[phase->facet] += SCAN_FACET_GAIN * (interval / phase->period_usec - phase->facet_scale[phase->facet]);
+    phase->edge_tick = tick;
+    phase->edge_adj = -(1.0 - SCAN_PLL_ALPHA) * err; // estimated edge = tick - (1 - alpha) * err
+    phase->facet = (phase->facet + 1) % phase->facets;
+    if (settled)
+    {
+        phase->jitter_usec += SCAN_FACET_GAIN * (fabs(err) - phase->jitter_usec);
+        phase->slip_run = 0;
+        phase->sync_facet = phase->facet;
+        phase->sync_edges = phase->edges;
+        if (phase->locked < UINT32_MAX) phase->locked++;
+    }
+    else
+    {
+        phase->locked = 0;
+    }
+
+    // keep the facet widths averaging to one period, once per revolution
+    if (phase->facet == 0)
+    {
+        float sum = 0;
+        for (uint32_t f = 0; f < phase->facets; f++) sum += phase->facet_scale[f];
+        for (uint32_t f = 0; f < phase->facets; f++) phase->facet_scale[f] *= phase->facets / sum;
+    }
+} // end scanPhaseUpdate()
+
+scan_angle_t scanPhaseAngle(const scan_phase_t* phase, uint32_t tick, double offset_deg)
+{
+    if (!scanPhaseLocked(phase)) return SCAN_ANGLE_NONE;
+
+    // time since the latest estimated edge; slightly negative if the shot preceded it
+    double dt = (double)(int32_t)(tick - phase->edge_tick) - phase->edge_adj;
+    uint32_t facet = phase->facet;
+    double width = phase->period_usec * phase->facet_scale[facet];
+
+    for (uint32_t steps = 0; dt < 0 && steps < phase->facets; steps++)
+    {
+        facet = (facet + phase->facets - 1) % phase->facets;
+        width = phase->period_usec * phase->facet_scale[facet];
+        dt += width;
+    }
+    // step across edges whose alerts have not been delivered yet
+    for (uint32_t steps = 0; dt >= width; steps++)
+    {
+        if (steps >= SCAN_STALE_FACETS) return SCAN_ANGLE_NONE;
+        dt -= width;
+        facet = (facet + 1) % phase->facets;
+        width = phase->period_usec * phase->facet_scale[facet];
+    }
+    if (dt < 0) return SCAN_ANGLE_NONE;
+
+    return (scan_angle_t){
+        .angle_deg = (float)(offset_deg + dt / width * 720.0 / phase->facets),
+        .facet = (uint8_t)facet,
+        .valid = true};
+} // end scanPhaseAngle()
@@ -0,0 +1,84 @@
+#ifndef _SCAN_PHASE_H_
+#define _SCAN_PHASE_H_
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#define SCAN_MAX_FACETS 16      // largest supported polygon
+#define SCAN_PLL_ALPHA 0.25     // phase gain; fraction of an edge's timing error taken as real
+#define SCAN_PLL_BETA 0.02      // period gain; fraction of the timing error added to the period
+#define SCAN_FACET_GAIN 0.01    // per-facet width filter gain
+#define SCAN_SLIP_FRAC 0.3      // an edge further than this fraction of a facet from its prediction slips
+#define SCAN_LOCK_JITTERS 4.0   // an edge further than this many jitters from its prediction drops the lock
+#define SCAN_LOCK_MIN_USEC 2.0  // ... or than this, if more; pigpio timestamps edges to 1 us
+#define SCAN_RELOCK_SLIPS 4     // consecutive slips after which the period is re-seeded from raw edges
+#define SCAN_LOCK_REVS 2        // revolutions of settled edges before angles are reported
+#define SCAN_STALE_FACETS 4     // facets without an edge after which the mirror is taken as stopped
+
+/** Scan phase estimator.
+ *  Tracks the rotation of the polygon mirror from start-of-scan (SOS) edge ticks with a
+ *  second-order phase-locked loop: each edge is compared with the edge time predicted from the
+ *  previous estimate, and the error corrects the phase (SCAN_PLL_ALPHA) and the facet period
+ *  (SCAN_PLL_BETA). Facets of a real polygon are not exactly equal, so the duration of each
+ *  facet relative to the mean period is filtered separately (SCAN_FACET_GAIN).
+ *
+ *  An edge far from its prediction is a slip: one that comes late is taken as missed edges and
+ *  the facet count advanced to match; one that comes early is ignored as spurious. Repeated
+ *  slips (e.g. after an rpm change) re-seed the period from the raw edge interval, and the
+ *  facet count from the edges seen since the loop last settled.
+ *
+ *  Angles are only reported while the loop is locked: SCAN_LOCK_REVS revolutions of edges within
+ *  SCAN_LOCK_JITTERS times the filtered jitter (or SCAN_LOCK_MIN_USEC) of their prediction. A
+ *  larger error drops the lock even when it is no slip, since while the loop is pulling in to a
+ *  new rpm its extrapolated angles can be off by tens of degrees. The jitter is only filtered
+ *  from edges within that limit, so a transient cannot widen the limit it is tested against.
+ *
+ *  scanPhaseAngle() extrapolates from the latest edge to any later tick, across edges that have
+ *  not been delivered yet, and returns the facet and optical scan angle of that tick:
+ *    angle = offset + (time since the facet's SOS edge / facet duration) * 720 / facets
+ *  i.e. each facet sweeps the beam through twice its mechanical angle. Facet indices count
+ *  from the first edge seen, not from a physical mark on the polygon.
+ */
+
+typedef struct ScanPhase {
+    uint32_t facets;
+    uint32_t facet;             // facet that started at the latest edge
+    uint32_t edge_tick;         // tick of the latest accepted edge
+    double edge_adj;            // estimated edge time - edge_tick (usec)
+    uint32_t last_tick;         // tick of the latest raw edge, accepted or not
+    double period_usec;         // mean facet duration; 0 until two edges were seen
+    float facet_scale[SCAN_MAX_FACETS]; // facet duration / period_usec
+    double jitter_usec;         // filtered magnitude of the edge timing error, over settled edges
+    uint32_t locked;            // settled edges since the lock was last dropped
+    uint32_t slip_run;          // slips since the loop last settled
+    uint32_t sync_facet;        // facet that started at the latest settled edge
+    uint64_t sync_edges;        // raw edges seen at the latest settled edge
+    uint64_t edges;             // raw edges seen
+    uint64_t slips;             // edges that did not match the prediction
+} scan_phase_t;
+
+// Facet and angle of one shot
+typedef struct ScanAngle {
+    float angle_deg;            // optical scan angle; -999 if not valid
+    uint8_t facet;
+    bool valid;                 // false until the estimator is locked, or if the mirror stopped
+} scan_angle_t;
+
+static const scan_angle_t SCAN_ANGLE_NONE = {.angle_deg = -999.0f, .facet = 0, .valid = false};
+
+// Resets the estimator for a polygon with facets facets (at most SCAN_MAX_FACETS)
+void scanPhaseInit(scan_phase_t* phase, uint32_t facets);
+
+// Feeds one SOS edge; ticks must come in order
+void scanPhaseUpdate(scan_phase_t* phase, uint32_t tick);
+
+// Facet and scan angle at tick, with offset_deg the optical angle of the beam at each SOS edge
+scan_angle_t scanPhaseAngle(const scan_phase_t* phase, uint32_t tick, double offset_deg);
+
+static inline bool scanPhaseLocked(const scan_phase_t* phase)
+{
+    return phase->locked >= SCAN_LOCK_REVS * phase->facets;
+}
+
+#endif
@@ -0,0 +1,165 @@
+#include "shot_sched.h"
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+
+#define NSEC_PER_SEC 1000000000ULL
+
+uint64_t shotSchedNowNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+shot_sched_t* shotSchedCreate(double rate_hz, uint32_t spin_ns, uint32_t hist_size)
+{
+    shot_sched_t* sched = (shot_sched_t*)calloc(1, sizeof(shot_sched_t));
+    if (sched == NULL) return NULL;
+
+    if (hist_size > 0)
+    {
+        sched->intervals_ns = (uint32_t*)calloc(hist_size, sizeof(uint32_t));
+        if (sched->intervals_ns == NULL)
+        {
+            free(sched);
+            return NULL;
+        }
+    }
+    sched->interval_cap = hist_size;
+    sched->spin_ns = spin_ns;
+    if (shotSchedSetRate(sched, rate_hz) < 0)
+    {
+        shotSchedDestroy(sched);
+        return NULL;
+    }
+
+    return sched;
+} // end shotSchedCreate()
+
+int shotSchedSetRate(shot_sched_t* sched, double rate_hz)
+{
+    // a zero period would divide by zero in shotSchedWait(); NaN fails both comparisons
+    double period_ns = NSEC_PER_SEC / rate_hz;
+    if (!(period_ns >= 1.0 && period_ns <= SHOT_SCHED_MAX_PERIOD_SEC * (double)NSEC_PER_SEC)) return -1;
+    sched->period_ns = (uint64_t)period_ns;
+    return 0;
+} // end shotSchedSetRate()
+
+void shotSchedStart(shot_sched_t* sched)
+{
+    sched->shots = 0;
+    sched->missed = 0;
+    sched->late = 0;
+    sched->late_max_ns = 0;
+    sched->interval_cnt = 0;
+    sched->interval_idx = 0;
+    sched->start_ns = shotSchedNowNs();
+    sched->last_ns = 0;
+    sched->deadline_ns = sched->start_ns + sched->period_ns;
+} // end shotSchedStart()
+
+bool shotSchedWait(shot_sched_t* sched)
+{
+    uint64_t now = shotSchedNowNs();
+
+    // deadline already passed by a full period or more; skip the lost slots
+    if (now >= sched->deadline_ns + sched->period_ns)
+    {
+        uint64_t skipped = (now - sched->deadline_ns) / sched->period_ns;
+        sched->missed += skipped;
+        sched->deadline_ns += skipped * sched->period_ns;
+    }
+
+    // sleep through the bulk of the wait, leaving spin_ns for the busy-wait tail
+    if (now + sched->spin_ns < sched->deadline_ns)
+    {
+        uint64_t wake_ns = sched->deadline_ns - sched->spin_ns;
+        struct timespec wake = {
+            .tv_sec = wake_ns / NSEC_PER_SEC,
+            .tv_nsec = wake_ns % NSEC_PER_SEC
+        };
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wake, NULL) == EINTR);
+    }
+
+    // spin tail
+    while ((now = shotSchedNowNs()) < sched->deadline_ns);
+
+    // lateness of this release, whether or not slots were skipped
+    uint64_t late_ns = now - sched->deadline_ns;
+    bool on_time = (late_ns <= SHOT_SCHED_LATE_NSEC);
+    if (!on_time) sched->late++;
+    if (late_ns > sched->late_max_ns) sched->late_max_ns = late_ns;
+
+    // record inter-shot interval for jitter statistics
+    if (sched->shots > 0 && sched->interval_cap > 0)
+    {
+        uint64_t interval = now - sched->last_ns;
+        sched->intervals_ns[sched->interval_idx] = interval > UINT32_MAX ? UINT32_MAX : (uint32_t)interval;
+        sched->interval_idx = (sched->interval_idx + 1) % sched->interval_cap;
+        if (sched->interval_cnt < sched->interval_cap) sched->interval_cnt++;
+    }
+
+    sched->last_ns = now;
+    sched->shots++;
+    sched->deadline_ns += sched->period_ns;
+
+    return on_time;
+} // end shotSchedWait()
+
+static int cmpDouble(const void* a, const void* b)
+{
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+void shotSchedGetStats(shot_sched_t* sched, shot_stats_t* stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    stats->shots = sched->shots;
+    stats->missed = sched->missed;
+    stats->late = sched->late;
+    stats->late_max_us = sched->late_max_ns * 1e-3;
+    stats->target_hz = (double)NSEC_PER_SEC / sched->period_ns;
+
+    if (sched->shots > 0 && sched->last_ns > sched->start_ns)
+    {
+        stats->achieved_hz = sched->shots * (double)NSEC_PER_SEC / (sched->last_ns - sched->start_ns);
+    }
+
+    if (sched->interval_cnt == 0) return;
+
+    // jitter = absolute deviation of each interval from the nominal period
+    double* jitter = (double*)malloc(sched->interval_cnt * sizeof(double));
+    if (jitter == NULL) return;
+    for (uint32_t i = 0; i < sched->interval_cnt; i++)
+    {
+        jitter[i] = fabs((double)sched->intervals_ns[i] - (double)sched->period_ns) * 1e-3;
+    }
+    qsort(jitter, sched->interval_cnt, sizeof(double), cmpDouble);
+
+    uint32_t last = sched->interval_cnt - 1;
+    stats->jitter_p50_us = jitter[last * 50 / 100];
+    stats->jitter_p90_us = jitter[last * 90 / 100];
+    stats->jitter_p99_us = jitter[last * 99 / 100];
+    stats->jitter_max_us = jitter[last];
+    free(jitter);
+} // end shotSchedGetStats()
+
+void shotSchedPrintStats(shot_sched_t* sched, FILE* stream)
+{
+    shot_stats_t stats;
+    shotSchedGetStats(sched, &stats);
+    fprintf(stream, "shots=%llu missed=%llu late=%llu (max %.2f us) rate=%.1f/%.1f Hz jitter(us) p50=%.2f p90=%.2f p99=%.2f max=%.2f\n",
+            (unsigned long long)stats.shots, (unsigned long long)stats.missed, (unsigned long long)stats.late, stats.late_max_us,
+            stats.achieved_hz, stats.target_hz,
+            stats.jitter_p50_us, stats.jitter_p90_us, stats.jitter_p99_us, stats.jitter_max_us);
+} // end shotSchedPrintStats()
+
+void shotSchedDestroy(shot_sched_t* sched)
+{
+    if (sched == NULL) return;
+    free(sched->intervals_ns);
+    free(sched);
+} // end shotSchedDestroy()
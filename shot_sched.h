@@ -0,0 +1,85 @@
+#ifndef _SHOT_SCHED_H_
+#define _SHOT_SCHED_H_
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+#define SHOT_SCHED_SPIN_NSEC_DEFAULT 50000 // default length of the busy-wait tail before each deadline
+#define SHOT_SCHED_MAX_PERIOD_SEC 3600     // slowest accepted rate: one shot per hour
+#define SHOT_SCHED_LATE_NSEC 2000          // a shot released this long after its deadline is late; well above the spin loop's resolution
+
+/** Periodic shot scheduler.
+ *  Shots are fired on an absolute grid of deadlines (start + k*period) so that
+ *  timing errors of one shot do not accumulate into the next. Each wait sleeps
+ *  with clock_nanosleep(TIMER_ABSTIME) until spin_ns before the deadline, then
+ *  busy-waits the remaining tail to remove the kernel wake-up latency.
+ *
+ *  A shot released more than SHOT_SCHED_LATE_NSEC after its deadline is counted
+ *  as late. If a deadline has already passed by a full period or more, the
+ *  skipped grid slots are also counted as missed and the shot is released at
+ *  once for the latest passed slot, rather than as a burst of catch-up shots.
+ */
+typedef struct ShotSched {
+    uint64_t period_ns;     // time between consecutive deadlines
+    uint32_t spin_ns;       // length of busy-wait tail before each deadline
+    uint64_t deadline_ns;   // absolute CLOCK_MONOTONIC time of the next shot
+    uint64_t start_ns;      // time of shotSchedStart()
+    uint64_t last_ns;       // time at which the previous shot was released
+    uint64_t shots;         // number of shots released since shotSchedStart()
+    uint64_t missed;        // number of deadlines skipped because they had already passed
+    uint64_t late;          // shots released more than SHOT_SCHED_LATE_NSEC after their deadline
+    uint64_t late_max_ns;   // largest release delay after a deadline
+    uint32_t* intervals_ns; // ring buffer of recent inter-shot intervals
+    uint32_t interval_cap;  // capacity of intervals_ns
+    uint32_t interval_cnt;  // number of valid entries in intervals_ns
+    uint32_t interval_idx;  // next write position in intervals_ns
+} shot_sched_t;
+
+// Summary of scheduler performance since shotSchedStart()
+typedef struct ShotStats {
+    uint64_t shots;
+    uint64_t missed;
+    uint64_t late;
+    double late_max_us; // largest release delay after a deadline
+    double target_hz;   // configured shot rate
+    double achieved_hz; // shots / elapsed time
+    double jitter_p50_us; // percentiles of |interval - period| in microseconds
+    double jitter_p90_us;
+    double jitter_p99_us;
+    double jitter_max_us;
+} shot_stats_t;
+
+// Returns the current CLOCK_MONOTONIC time in nanoseconds
+uint64_t shotSchedNowNs();
+
+/**Allocates a scheduler firing at rate_hz. spin_ns is the busy-wait tail
+ * (0 for pure sleeping) and hist_size the number of recent intervals kept
+ * for jitter statistics. Returns NULL on failure.
+ */
+shot_sched_t* shotSchedCreate(double rate_hz, uint32_t spin_ns, uint32_t hist_size);
+
+/**Changes the shot rate; takes effect from the next deadline. Returns -1, leaving the rate
+ * unchanged, unless the period is between 1 ns and SHOT_SCHED_MAX_PERIOD_SEC.
+ */
+int shotSchedSetRate(shot_sched_t* sched, double rate_hz);
+
+// Resets statistics and places the first deadline one period from now
+void shotSchedStart(shot_sched_t* sched);
+
+/**Blocks until the next deadline and advances the schedule.
+ * Returns true if the shot was released on time, false if it was late
+ * (including when deadlines had already passed and were skipped).
+ */
+bool shotSchedWait(shot_sched_t* sched);
+
+// Fills stats with the achieved rate, missed deadlines, late shots and jitter percentiles
+void shotSchedGetStats(shot_sched_t* sched, shot_stats_t* stats);
+
+// Prints a one-line summary of shotSchedGetStats() to stream
+void shotSchedPrintStats(shot_sched_t* sched, FILE* stream);
+
+void shotSchedDestroy(shot_sched_t* sched);
+
+#endif
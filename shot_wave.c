@@ -0,0 +1,117 @@
+#include "shot_wave.h"
+
+// single pin transition used while building a shot
+struct ShotEdge {
+    uint32_t t_us;
+    uint32_t on_mask;
+    uint32_t off_mask;
+};
+
+static int cmpEdge(const void* a, const void* b)
+{
+    const struct ShotEdge* x = (const struct ShotEdge*)a;
+    const struct ShotEdge* y = (const struct ShotEdge*)b;
+    return (x->t_us > y->t_us) - (x->t_us < y->t_us);
+}
+
+uint32_t shotWaveLengthUs(shot_wave_t* wave)
+{
+    return wave->pulse_count * wave->pulse_period_us;
+}
+
+int shotWaveBuild(shot_wave_t* wave, gpioPulse_t* pulses, int max_pulses)
+{
+    uint32_t half_us = wave->pulse_period_us / 2;
+    if (wave->pulse_count == 0 || half_us == 0 || wave->start_pulse >= wave->pulse_count) return -1;
+    if (max_pulses < SHOT_WAVE_MAX_STEPS(wave)) return -1;
+    if (wave->laser_pin == wave->start_pin || wave->laser_pin > 31 || wave->start_pin > 31) return -1;
+
+    uint32_t laser_bit = 1u << wave->laser_pin;
+    uint32_t start_bit = 1u << wave->start_pin;
+    uint32_t end_us = shotWaveLengthUs(wave);
+    uint32_t start_us = wave->start_pulse * wave->pulse_period_us + wave->start_delay_us;
+    if (start_us >= end_us) return -1;
+
+    /******** Collect every edge of the shot ********/
+    struct ShotEdge edges[SHOT_WAVE_MAX_STEPS(wave)];
+    int n_edges = 0;
+    for (uint16_t i = 0; i < wave->pulse_count; i++)
+    {
+        uint32_t lead_us = i * wave->pulse_period_us;
+        edges[n_edges++] = (struct ShotEdge){
+            .t_us = lead_us,
+            .on_mask = wave->laser_pol ? laser_bit : 0,
+            .off_mask = wave->laser_pol ? 0 : laser_bit};
+        edges[n_edges++] = (struct ShotEdge){
+            .t_us = lead_us + half_us,
+            .on_mask = wave->laser_pol ? 0 : laser_bit,
+            .off_mask = wave->laser_pol ? laser_bit : 0};
+    }
+    edges[n_edges++] = (struct ShotEdge){.t_us = start_us, .on_mask = start_bit, .off_mask = 0};
+    edges[n_edges++] = (struct ShotEdge){.t_us = end_us, .on_mask = 0, .off_mask = start_bit};
+    qsort(edges, n_edges, sizeof(edges[0]), cmpEdge);
+    /************************************************/
+
+    /******** Merge simultaneous edges into pulse steps ********/
+    int n_pulses = 0;
+    for (int i = 0; i < n_edges; i++)
+    {
+        if (n_pulses > 0 && pulses[n_pulses - 1].usDelay == 0 &&
+            edges[i].t_us == edges[i - 1].t_us)
+        {
+            pulses[n_pulses - 1].gpioOn |= edges[i].on_mask;
+            pulses[n_pulses - 1].gpioOff |= edges[i].off_mask;
+        }
+        else
+        {
+            pulses[n_pulses++] = (gpioPulse_t){
+                .gpioOn = edges[i].on_mask,
+                .gpioOff = edges[i].off_mask,
+                .usDelay = 0};
+        }
+
+        // step lasts until the next distinct edge
+        if (i + 1 < n_edges && edges[i + 1].t_us != edges[i].t_us)
+        {
+            pulses[n_pulses - 1].usDelay = edges[i + 1].t_us - edges[i].t_us;
+        }
+    }
+    /***********************************************************/
+
+    return n_pulses;
+} // end shotWaveBuild()
+
+int shotWaveCreate(shot_wave_t* wave)
+{
+    gpioPulse_t pulses[SHOT_WAVE_MAX_STEPS(wave)];
+    int n_pulses = shotWaveBuild(wave, pulses, SHOT_WAVE_MAX_STEPS(wave));
+
+    wave->wave_id = -1;
+    if (n_pulses < 0) return n_pulses;
+
+    gpioWaveAddNew();
+    int status = gpioWaveAddGeneric(n_pulses, pulses);
+    if (status < 0) return status;
+
+    wave->wave_id = gpioWaveCreate();
+    return wave->wave_id;
+} // end shotWaveCreate()
+
+int shotWaveFire(shot_wave_t* wave)
+{
+    if (wave->wave_id < 0) return PI_WAVE_NOT_FOUND;
+    return gpioWaveTxSend(wave->wave_id, PI_WAVE_MODE_ONE_SHOT_SYNC);
+} // end shotWaveFire()
+
+bool shotWaveBusy()
+{
+    return gpioWaveTxBusy();
+}
+
+void shotWaveDelete(shot_wave_t* wave)
+{
+    if (wave->wave_id < 0) return;
+    gpioWaveTxStop();
+    gpioWaveDelete(wave->wave_id);
+    wave->wave_id = -1;
+} // end shotWaveDelete()
@@ -0,0 +1,62 @@
+#ifndef _SHOT_WAVE_H_
+#define _SHOT_WAVE_H_
+#include <pigpio.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/** DMA-timed laser shot.
+ *  A shot is the train of pulse_count laser trigger pulses (50% duty, period
+ *  pulse_period_us) plus the TDC START edge. Both are built into a single
+ *  pigpio waveform so the relative timing of every edge is fixed by the DMA
+ *  engine rather than by gpioWrite()/gpioDelay() on the calling core. Edges
+ *  that fall on the same microsecond share one pulse step and are therefore
+ *  written to the GPIO set/clear registers simultaneously.
+ *
+ *  START is raised start_delay_us after the leading edge of pulse start_pulse
+ *  and lowered at the end of the train. It needs a pin of its own: on the laser
+ *  pin its edges would merge into the trigger pulses.
+ */
+typedef struct ShotWave {
+    uint8_t laser_pin;          // outputs trigger pulses to laser driver
+    uint8_t start_pin;          // TDC START input
+    bool laser_pol;             // 1 = laser line normally LO and pulsed HI
+    uint16_t pulse_count;       // number of trigger pulses per shot
+    uint32_t pulse_period_us;   // period of the trigger pulses
+    uint16_t start_pulse;       // index of the pulse whose leading edge START is referenced to
+    uint32_t start_delay_us;    // delay from that leading edge to START rising
+    int wave_id;                // pigpio wave id; < 0 if not created
+} shot_wave_t;
+
+// Maximum number of pulse steps a shot can produce
+#define SHOT_WAVE_MAX_STEPS(wave) (2 * (wave)->pulse_count + 2)
+
+/**Builds the pulse steps of a shot into pulses without touching hardware.
+ * pulses must hold SHOT_WAVE_MAX_STEPS(wave) entries.
+ * Returns the number of steps written, or -1 on an invalid configuration, including
+ * a laser and START pin that are the same or not in the first GPIO bank.
+ */
+int shotWaveBuild(shot_wave_t* wave, gpioPulse_t* pulses, int max_pulses);
+
+/**Builds the shot and uploads it as a pigpio waveform.
+ * Returns the wave id (also stored in wave->wave_id) or a negative pigpio error.
+ */
+int shotWaveCreate(shot_wave_t* wave);
+
+/**Transmits the shot once. If a previous shot is still being transmitted,
+ * the new one starts as soon as it ends.
+ * Returns the number of DMA control blocks sent or a negative pigpio error.
+ */
+int shotWaveFire(shot_wave_t* wave);
+
+// Returns true while a shot is being transmitted
+bool shotWaveBusy();
+
+// Returns the total duration of one shot in microseconds
+uint32_t shotWaveLengthUs(shot_wave_t* wave);
+
+// Stops any transmission and deletes the pigpio waveform
+void shotWaveDelete(shot_wave_t* wave);
+
+#endif
@@ -0,0 +1,106 @@
+#include "sos.h"
+#include <pigpio.h>
+
+sos_t* sosCreate(unsigned pin, int level, uint32_t facets, uint32_t glitch_usec)
+{
+    if (facets == 0) return NULL;
+
+    sos_t* sos = (sos_t*)calloc(1, sizeof(sos_t));
+    if (sos == NULL) return NULL;
+
+    atomic_init(&sos->seq, 0);
+    sos->pin = pin;
+    sos->level = level;
+    sos->facets = facets;
+    sos->glitch_usec = glitch_usec;
+    return sos;
+} // end sosCreate()
+
+// pigpio alert callback; runs on pigpio's alert thread, the only writer of sos->state
+static void sosAlert(int gpio, int level, uint32_t tick, void* arg)
+{
+    (void)gpio;
+    sos_t* sos = (sos_t*)arg;
+    if (level != sos->level) return; // inactive edge or watchdog timeout (level 2)
+
+    unsigned seq = atomic_load_explicit(&sos->seq, memory_order_relaxed);
+    atomic_store_explicit(&sos->seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    sos_state_t* state = &sos->state;
+    state->period_usec = state->edges ? tick - state->tick : 0; // unsigned difference survives the tick wrap
+    state->tick = tick;
+    state->edges++;
+    scanPhaseUpdate(&state->phase, tick);
+
+    atomic_store_explicit(&sos->seq, seq + 2, memory_order_release);
+} // end sosAlert()
+
+int sosStart(sos_t* sos)
+{
+    sos->state = (sos_state_t){0};
+    scanPhaseInit(&sos->state.phase, sos->facets);
+    if (gpioSetMode(sos->pin, PI_INPUT) != 0 ||
+        gpioGlitchFilter(sos->pin, sos->glitch_usec) != 0 ||
+        gpioSetAlertFuncEx(sos->pin, &sosAlert, sos) != 0)
+    {
+        fprintf(stderr, "sosStart: failed to register alert on GPIO %u\n", sos->pin);
+        return -1;
+    }
+    sos->started = true;
+    return 0;
+} // end sosStart()
+
+bool sosRead(sos_t* sos, sos_state_t* state)
+{
+    unsigned s1, s2;
+    do
+    {
+        s1 = atomic_load_explicit(&sos->seq, memory_order_acquire);
+        *state = sos->state;
+        atomic_thread_fence(memory_order_acquire);
+        s2 = atomic_load_explicit(&sos->seq, memory_order_relaxed);
+    } while (s1 != s2 || (s1 & 1));
+    return state->edges > 0;
+} // end sosRead()
+
+scan_angle_t sosAngle(sos_t* sos, uint32_t tick, double offset_deg)
+{
+    sos_state_t state;
+    if (!sosRead(sos, &state)) return SCAN_ANGLE_NONE;
+    return scanPhaseAngle(&state.phase, tick, offset_deg);
+} // end sosAngle()
+
+void sosStop(sos_t* sos)
+{
+    if (sos == NULL || !sos->started) return;
+    gpioSetAlertFuncEx(sos->pin, NULL, NULL);
+    sos->started = false;
+} // end sosStop()
+
+void sosPrintStats(sos_t* sos, FILE* stream)
+{
+    sos_state_t state;
+    if (!sosRead(sos, &state))
+    {
+        fprintf(stream, "start-of-scan: no edges\n");
+        return;
+    }
+    const scan_phase_t* phase = &state.phase;
+    fprintf(stream, "start-of-scan: %llu edges, facet %u, last period %u us, %s",
+            (unsigned long long)state.edges, phase->facet, state.period_usec,
+            scanPhaseLocked(phase) ? "locked" : "NOT locked");
+    if (phase->period_usec > 0)
+    {
+        fprintf(stream, ", filtered period %.2lf us (%.1lf rpm), jitter %.2lf us",
+                phase->period_usec, 60e6 / (phase->period_usec * phase->facets), phase->jitter_usec);
+    }
+    fprintf(stream, ", %llu slips\n", (unsigned long long)phase->slips);
+} // end sosPrintStats()
+
+void sosDestroy(sos_t* sos)
+{
+    if (sos == NULL) return;
+    sosStop(sos);
+    free(sos);
+} // end sosDestroy()
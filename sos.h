@@ -0,0 +1,64 @@
+#ifndef _SOS_H_
+#define _SOS_H_
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include "scan_phase.h"
+
+/** Start-of-scan capture.
+ *  Edges of the start-of-scan detector are captured through pigpio alerts instead of a polling
+ *  thread: pigpio samples the GPIO levels by DMA every microsecond (see gpioCfgClock()) and
+ *  calls sosAlert() on its own thread with the tick at which the level changed, so the
+ *  timestamp is exact even though the callback itself may run up to a millisecond later.
+ *  Pulses shorter than glitch_usec are rejected by pigpio's glitch filter.
+ *
+ *  Each active edge updates the latest SOS tick, the interval since the previous edge and the
+ *  scan phase estimator (scan_phase.h), which tracks the facet index and the filtered facet
+ *  period. They are published under a seqlock, so the acquisition loop reads a consistent
+ *  snapshot with sosRead() or sosAngle() without taking a lock and never delays the writer:
+ *    writer: seq = odd; write fields; seq = even
+ *    reader: s1 = seq; copy fields; s2 = seq; retry unless s1 == s2 and even
+ */
+
+typedef struct SosState {
+    uint32_t tick;          // gpioTick() of the latest active edge
+    uint32_t period_usec;   // interval between the latest two active edges; 0 until two were seen
+    uint64_t edges;         // active edges seen since sosStart()
+    scan_phase_t phase;     // mirror phase estimated from the edges
+} sos_state_t;
+
+typedef struct Sos {
+    atomic_uint seq;        // seqlock sequence; odd while state is being written
+    sos_state_t state;
+    unsigned pin;
+    int level;              // active level of the detector
+    uint32_t facets;        // facets per mirror revolution
+    uint32_t glitch_usec;
+    bool started;
+} sos_t;
+
+/**Allocates the capture state for the detector on pin, active at level, on a mirror with facets
+ * facets. Returns NULL on failure.
+ */
+sos_t* sosCreate(unsigned pin, int level, uint32_t facets, uint32_t glitch_usec);
+
+// Configures the pin and registers the alert; call after gpioInitialise(). Returns 0 or -1.
+int sosStart(sos_t* sos);
+
+// Copies the latest state to state; false if no edge has been seen yet. Never blocks the writer.
+bool sosRead(sos_t* sos, sos_state_t* state);
+
+// Facet and scan angle of a shot fired at tick (see scanPhaseAngle())
+scan_angle_t sosAngle(sos_t* sos, uint32_t tick, double offset_deg);
+
+// Cancels the alert
+void sosStop(sos_t* sos);
+
+void sosPrintStats(sos_t* sos, FILE* stream);
+
+// Frees the capture state; calls sosStop() first
+void sosDestroy(sos_t* sos);
+
+#endif
@@ -4,11 +4,23 @@
 #include <sys/sysinfo.h>
 #include <sched.h>
 #include "tdc_util.h"
+#include "shot_sched.h"
+#include "shot_wave.h"
+#include "fast_gpio.h"
+#include "mode_ctrl.h"
+#include "control.h"
+#include "out_segment.h"
+#include "sample_shm.h"
+#include "bcast_ring.h"
+#include "burst.h"
+#include "proc_pool.h"
+#include "rt_profile.h"
+#include "sos.h"
+#include "pcloud.h"
+#include "tof_hist.h"
 #include "logger.h"
-#include "data_processor.h"
 #include "tcp_handler.h"
 #include "scanmirror.h"
-#include "pinpoller.h"
 #include "MLD019.h"
 #include <stdint.h>
 
@@ -18,6 +30,11 @@
 
 // TCP Port definition
 #define TCP_PORT 49417
+#define PCLOUD_TCP_PORT 49418 // point-cloud chunks; only with -o
+
+// Control plane definitions
+#define CTRL_SOCK_PATH "/tmp/tdc_ctrl.sock" // local socket accepting control commands (see control.h)
+#define CTRL_IDLE_USEC 1000                 // mailbox polling interval while not acquiring
 
 // MLD-019 definitions
 #define MLD_TTY "/dev/ttyAMA0"
@@ -27,13 +44,37 @@
 #define TDC_CLK_PIN 4     // physical pin 7; GPIOCLK0 for TDC reference
 #define TDC_ENABLE_PIN 27 // physical pin 13; TDC Enable
 #define TDC_INT_PIN 22    // physical pin 15; TDC interrupt pin
-#define TDC_BAUD (uint32_t)250E6 / 64
-#define TDC_START_PIN 23                  // physical pin 18; provides TDC start signal for debugging
+#define TDC_BAUD (uint32_t)250E6 / 64     // starting (known good) SPI clock; raised by the autotuner at startup
+#define TDC_START_PIN 24                  // physical pin 18; provides TDC start signal for debugging
 #define TDC_STOP_PIN 18                   // physical pin 12; provides TDC stop signal for debugging
-#define TDC_TIMEOUT_USEC (uint32_t)5E6    // time to wait for TDC INT pin to go LO
+#define TDC_TIMEOUT_USEC (uint32_t)20E3   // backstop wait for TDC INT pin to go LO if START never arrives
+#define TDC_MAX_RANGE_M 3000.0            // maximum range; the TDC overflow registers end a measurement after this window
+#define TDC_MIN_RANGE_M 0.0               // near-field gate; stops closer than this are ignored by the TDC (mode 2 only)
 #define TDC_CLK_FREQ (uint32_t)19.2e6 / 2 // TDC ref clock frequency from Pi
-#define TDC_MEAS_MODE 1                   //0 = mode 1; 1 = mode 2
+#define TDC_MEAS_MODE 1                   //0 = mode 1; 1 = mode 2; starting mode unless overridden with -m
+#define TDC_MODE2_TOF_NSEC 400.0          // auto mode: switch to mode 2 once a return beyond this is seen (mode 1 limit ~500 ns)
+#define TDC_MODE1_TOF_NSEC 300.0          // auto mode: return to mode 1 when a whole window of returns is below this
+#define TDC_MODE_WINDOW 256               // auto mode: valid samples per mode decision
 #define TDC_DELAY_USEC 10                 // delay between TDC_START and TDC_STOP
+#define TDC_SPI_BACKEND_DEFAULT TDC_SPI_PIGPIO // SPI driver unless overridden with -s on the command line
+#define TDC_SPI_TUNE_TRIALS 16               // register read-back trials per SPI clock step at startup
+#define TDC_SPI_TUNE_MARGIN 0.2              // settle this fraction below the fastest verified SPI clock
+#define TDC_PARITY_CHECK_SHOTS 1000          // shots between parity fallback checks
+#define TDC_PARITY_MAX_ERRORS 10             // parity errors tolerated per check before lowering the SPI clock
+#define TDC_PARITY_RETRIES 2                 // re-reads of a register failing parity before the frame is marked bad
+
+/** Multiple TDCs:
+ *  Shots alternate between TDC_COUNT TDCs. While one TDC measures the current shot,
+ *  the TDC of the previous shot is read out. All TDCs share the reference clock and
+ *  START/STOP signals; each has its own chip select, enable and interrupt pin.
+ *  Entry i of the arrays below describes TDC i; only the first TDC_COUNT entries are used.
+ */
+#define TDC_COUNT 1                                // number of TDCs in use (max 2 with the arrays below)
+#define TDC_SPI_CHANNELS {0, 2}                    // TDC 1 on aux SPI CE2 (physical pin 36); main CE1 is the SOS input
+#define TDC_SPI_FLAGS {0, (1 << 8) | (0b011 << 5)} // TDC 1 on aux SPI; aux CE0/CE1 not reserved (GPIO 18 is the mirror)
+#define TDC_ENABLE_PINS {TDC_ENABLE_PIN, 12}       // TDC 1 enable on physical pin 32
+#define TDC_INT_PINS {TDC_INT_PIN, 25}             // TDC 1 interrupt on physical pin 22
+#define TDC_TOF_OFFSETS_SEC {0.0, 0.0}             // per-TDC zero-range offset subtracted from ToF
 
 // Laser pin defintions
 #define DETECTOR_GATE_PIN 5 // physical pin 29; controls photon detector gate
@@ -56,13 +97,31 @@
 #define LASER_PULSE_FREQ_HZ 2e2
 #define LASER_PULSE_PERIOD_USEC 1 / (LASER_PULSE_FREQ_HZ)*1E6
 #define LASER_PULSE_POL 1                  // Determines laser pulse polarity; 1 means pulse line is normally LO and pulsed HI
+#define LASER_START_PULSE 1                // index of the trigger pulse that fires the laser; TDC START is referenced to its leading edge
+#define TDC_START_DELAY_USEC 25            // delay from the leading edge of LASER_START_PULSE to TDC START
 #define LASER_ACQ_USEC (uint32_t)10e6      // Time in usec to acquire ToF data
 #define LASER_ACQ_PERIOD_USEC (uint32_t)67 // minimum TDC sampling period; minimum delay between TDC measurements
+#define LASER_SHOT_RATE_HZ (LASER_PULSE_FREQ_HZ / LASER_PULSE_COUNT) // shots per second; one shot per pulse train
+#define SHOT_SPIN_NSEC SHOT_SCHED_SPIN_NSEC_DEFAULT // busy-wait tail before each shot deadline
+#define SHOT_HIST_SIZE 4096                         // number of inter-shot intervals kept for jitter statistics
 #define OUT_FILE "./all_vals.txt"
+#define OUT_SEGMENT_SEC 3600 // continuous mode: start a new output file every hour
+#define OUT_RECORD_SEC 60    // continuous mode: repeat the config record and header every minute
+#define SAMPLE_RING_ENTRIES 4096 // broadcast ring between the processor pool and the output sinks
+#define PCLOUD_FILE "./points"   // point-cloud file with -o; .ply or .pcd is appended
+#define HIST_FILE "./all_hist.txt" // ToF histograms with -H; returns go to OUT_FILE
+#define HIST_BIN_NSEC 0.5          // histogram bin width; 7.5 cm of range
+#define HIST_MAX_RANGE_M 300.0     // histograms cover 0 to this range; stops beyond are counted, not binned
+#define HIST_WINDOW_SEC 1.0        // shots accumulated per histogram
+#define HIST_ANGLE_BINS 32         // -H angle: histograms per facet
+#define HIST_DARK_SEC 2.0          // -R dark: laser-off acquisition recorded as the dark-count reference
+#define HIST_REF_FILE "./hist_ref.txt" // dark-count reference recorded with -R dark; load it again with -R <file>
+#define BURST_FRAMES (LASER_ACQ_USEC / LASER_ACQ_PERIOD_USEC) // burst capacity; one window at the maximum sampling rate
 
 // Core definitinos
-#define MAIN_CORE 3 // isolated core for DAQ and instrument control, i.e. main
-#define POLL_CORE 2 // isolated core for pin polling
+// default RT profile (see rt_profile.h); -p role=cpus[:priority] overrides any role
+#define MAIN_CORE 3      // isolated core for DAQ and instrument control, i.e. main
+#define MAIN_PRIORITY 80 // SCHED_FIFO priority of main
 
 //Mirror pin definitions
 #define MIRROR_FREQ_PIN 18    //phyiscal pin 12; PWM mirror control signal
@@ -70,65 +129,270 @@
 #define MIRROR_ENABLE_PIN -1  // -1 for unused
 
 //Start-of-scan definitions
-#define SOS_PIN 7         // physical pin 26; start-of-scan detector input
-#define SOS_LEVEL 0       // detector is active LO
-#define SOS_DELAY_USEC 10 // usecs to hold spinlock when SOS goes LO
+#define SOS_PIN 7          // physical pin 26; start-of-scan detector input
+#define SOS_LEVEL 0        // detector is active LO
+#define SOS_GLITCH_USEC 10 // SOS pulses must be steady this long to count
+#define MIRROR_FACETS 6    // polygon facets; one SOS pulse per facet
+#define MIRROR_SOS_ANGLE_DEG 0.0 // optical scan angle of the beam at each SOS edge
+#define MIRROR_FACET_ELEV_DEG {0, 0, 0, 0, 0, 0} // beam elevation of each facet; nonzero for a pyramidal polygon
 
 // Module selectors
-/** Synchronous acquisition process (i.e. USE_SYNC_ACQ macro defined):
+/** Acquisition variants:
+ *  The trigger method, readout method and optional consumers are chosen at startup with
+ *  command line flags; the defaults below apply when a flag is not given. Each combination
+ *  of trigger, readout and mode control has its own copy of the acquisition loop, generated
+ *  at compile time (see ACQ_LOOP_VARIANT), so the hot loop holds no branches for options
+ *  that are off and changing them only needs a restart.
+ *
+ *  Synchronous acquisition process (-t sync):
  *  1)	Send laser trigger pulses to create 1 laser pulse; TDC started 
  *  2)	Wait for TDC stop
  *  3)	Collect data and send to processing loop
  *  4)	Repeat from step 1)
  * 
- *  Asynchronous acquisition process (i.e. USE_SYNC_ACQ macro undefined):
+ *  Asynchronous acquisition process (-t async):
  *  1)	Start continuous laser emission
  *  2)	Start TDC
  *  3)	Wait for TDC stop
  *  4)	Collect data and send to processing loop
  *  5)	Repeat from step 2)
+ *
+ *  TDC Debugging (-t debug):
+ *  Other gpio pins on the RPi are used for the TDC start and stop signal rather than
+ *  external hardware (i.e. single photon detector). These pins are defined by the
+ *  TDC_START_PIN and TDC_STOP_PIN macros.
  */
-#define USE_SYNC_ACQ // comment out this line for asynchronous acquisition
+enum ACQ_TRIGGER
+{
+    ACQ_TRIG_ASYNC, // free-running PWM laser, TDC START raised by software
+    ACQ_TRIG_SYNC,  // trigger pulse train and TDC START as one DMA waveform per shot
+    ACQ_TRIG_DEBUG, // START and STOP generated on debug pins with a known delay
+    ACQ_TRIG_NUM
+};
+#define ACQ_TRIGGER_DEFAULT ACQ_TRIG_SYNC // trigger method unless overridden with -t sync|async|debug
 
-/** Non-Autoincrement method:
+/** Non-Autoincrement method (-r single):
  *  ToF data from the TDC requires reading 5 values from the TDC internal registers
  *  In the non-autoinc method, these values are read in 5 separate SPI transactions.
  * 
- *  Autoincrement method:
+ *  Autoincrement method (-r autoinc):
  *  The autoincrement feature of the TDC7200 allows read/write operations to continue
  *  on the next consecutive register. This is convenient as the data required for ToF
  *  calculations are in consecutive registers. This allows all the necessary data to be
  *  obtained in 2 separate SPI transactions as opposed to 5.
  */
-#define USE_AUTOINC_METHOD // comment out this line to use 5 separate SPI transactions to retrieve data (SLOWER)
+#define ACQ_AUTOINC_DEFAULT true // readout method unless overridden with -r autoinc|single
 
-/** TDC Debugging:
- *  The USE_DEBUG macro is used to switch into TDC debugging.
- *  In this mode, other gpio pins on the RPi are used for the TDC
- *  start and stop signal rather than external hardware (i.e. single photon detector).
- *  
- * These pins are defined by the TDC_START_PIN and TDC_STOP_PIN macros.
+// optional consumers and peripherals; disable with -d logger, -d tcp, -d shm or -d mirror
+#define USE_LOGGER_DEFAULT true // threaded logger
+#define USE_TCP_DEFAULT true    // threaded tcp handler
+#define USE_SHM_DEFAULT true    // shared-memory sample ring for local readers (see sample_shm.h)
+#define USE_MIRROR_DEFAULT true // GECKO scanning mirror; also enables start-of-scan capture (see sos.h)
+// #define USE_MLD019          // comment out this line to not use serial commands to MLD-019 driver
+
+/** Fast GPIO:
+ *  If USE_FAST_GPIO is defined, the GPIO registers are mapped through /dev/gpiomem and the
+ *  TDC INT pin is polled (and simultaneous debug edges written) directly, bypassing pigpio.
+ *  If mapping fails at startup, pigpio gpioRead()/gpioWrite() are used instead.
+ */
+#define USE_FAST_GPIO // comment out this line to always use pigpio for INT polling
+
+// true if GPIO registers are mapped; set at startup when USE_FAST_GPIO is defined
+bool fast_gpio = false;
+
+/** Output sinks:
+ *  emitSample copies each decoded sample, in shot order, into an entry of a broadcast ring
+ *  (bcast_ring.h). The file, TCP, shared-memory and metrics sinks each read the entries
+ *  through their own cursor on their own thread:
+ *    file    - gating; every row reaches the data file, acquisition waits if it falls a ring behind
+ *    shm     - gating; publishing is cheap, and slow shared-memory readers are handled by that ring
+ *    tcp     - dropping; a slow network client loses rows instead of stalling acquisition
+ *    metrics - dropping; running totals for the "stats" report
+ *    pcloud  - gating, with -o; converts angle-tagged returns to x, y, z points (see pcloud.h).
+ *              Only the point-cloud file gates; chunks for TCP clients are queued without
+ *              blocking and dropped if the client falls behind
+ *    hist    - gating, with -H; replaces file and tcp, accumulating ToF histograms and writing
+ *              only their counts and the returns found in them (see tof_hist.h). Dark samples
+ *              (SAMPLE_FLAG_DARK) are recorded as the dark-count reference instead.
+ *  Every acquisition ends with a marker entry (SAMPLE_FLAG_END) that carries no sample:
+ *  sinks that buffer output write it out (the last histogram window, the last point-cloud
+ *  batch; after a dark acquisition the reference takes effect), and the other sinks skip it.
  */
-// #define USE_DEBUG           // comment out this line to use LASER pin definitions instead of TDC_START_PIN and TDC_STOP_PIN
+struct SampleEntry
+{
+    sample_shm_slot_t sample; // binary sample; seq unused
+    uint16_t len;             // length of line
+    char line[128];           // CSV row as written to the data file and TCP clients
+};
 
-#define USE_LOGGER // comment out this line to not use the threaded logger
-#define USE_TCP    // comment out this line to not use the threaded tcp handler
-// #define USE_POLLER          // comment out this line to not use pin polling
-// #define USE_MLD019          // comment out this line to not use serial commands to MLD-019 driver
-#define USE_MIRROR // comment out this line to not use the GECKO scanning mirror
-
-// structure defining argument to dataprocFunc
-struct DataProcArg
-{
-    logger_t *logger;           // reference to logger
-    tcp_handler_t *tcp_handler; // reference to tcp handler
-    tdc_t *tdc;                 // reference to tdc configuration
-    char *raw_tdc_data;
-    int raw_tdc_size;
-    bool data_break;   // add extra line break if true
-    bool timeout_flag; // if true, log dummy data
+// running totals kept by the metrics sink; read without locking by printAcqStats()
+struct SampleMetrics
+{
+    uint64_t samples; // samples seen, including no-return samples
+    uint64_t returns; // samples with a valid return
+    uint64_t no_returns; // overflow, timeout or parity failure; counted per cause in the TDC stats
+    double range_sum; // sum of valid ranges in meters
+    double range_min;
+    double range_max;
 };
 
+static void fileSink(void *entry, uint64_t seq, bool end_of_batch, void *arg)
+{
+    (void)seq, (void)end_of_batch;
+    struct SampleEntry *e = (struct SampleEntry *)entry;
+    if (e->sample.flags & SAMPLE_FLAG_END) return;
+    outSegWrite((out_seg_t *)arg, e->line, e->len, e->sample.time);
+}
+
+static void tcpSink(void *entry, uint64_t seq, bool end_of_batch, void *arg)
+{
+    (void)seq, (void)end_of_batch;
+    struct SampleEntry *e = (struct SampleEntry *)entry;
+    tcp_handler_t *tcp_handler = (tcp_handler_t *)arg;
+    if (tcp_handler->tcp_state == TCPH_STATE_CONNECTED && !(e->sample.flags & SAMPLE_FLAG_END))
+    {
+        tcpHandlerWrite(tcp_handler, e->line, e->len, 0, true);
+    }
+}
+
+static void shmSink(void *entry, uint64_t seq, bool end_of_batch, void *arg)
+{
+    (void)seq, (void)end_of_batch;
+    struct SampleEntry *e = (struct SampleEntry *)entry;
+    if (e->sample.flags & SAMPLE_FLAG_END) return;
+    sampleShmPublish((sample_shm_t *)arg, &e->sample);
+}
+
+static void pcloudSink(void *entry, uint64_t seq, bool end_of_batch, void *arg)
+{
+    (void)seq;
+    struct SampleEntry *e = (struct SampleEntry *)entry;
+    pcloud_t *pc = (pcloud_t *)arg;
+
+    if ((e->sample.flags & (SAMPLE_FLAG_VALID | SAMPLE_FLAG_ANGLE | SAMPLE_FLAG_DARK)) ==
+        (SAMPLE_FLAG_VALID | SAMPLE_FLAG_ANGLE))
+    {
+        pcloudAdd(pc, e->sample.facet, e->sample.angle, e->sample.dist, e->sample.time);
+    }
+    if (e->sample.flags & SAMPLE_FLAG_END)
+    {
+        pcloudFlush(pc);
+    }
+    else if (end_of_batch) // caught up; write a partial batch rather than hold it indefinitely
+    {
+        pcloudPoll(pc, e->sample.time);
+    }
+}
+
+// Streams point-cloud chunks to the point-cloud TCP client; never blocks the gating pcloud sink
+static int pcloudTcpWrite(const void *buf, size_t len, void *arg)
+{
+    tcp_handler_t *tcp_handler = (tcp_handler_t *)arg;
+    if (tcp_handler->tcp_state != TCPH_STATE_CONNECTED)
+    {
+        return 0;
+    }
+    return (tcpHandlerWrite(tcp_handler, (char *)buf, len, 0, false) < 0) ? -1 : 0; // queue full; chunk dropped
+}
+
+// histogram output of the hist sink; histHandler() runs on the sink's thread
+struct HistOut
+{
+    tof_hist_t *hist;
+    out_seg_t *peak_seg;        // return rows; the data file
+    out_seg_t *hist_seg;        // histogram rows
+    tcp_handler_t *tcp_handler; // return rows; NULL if TCP is disabled
+    uint64_t tcp_dropped;       // return rows the TCP queue had no room for
+    char *row;                  // histogram row buffer
+};
+
+// Makes the dark samples recorded so far the reference and saves it to HIST_REF_FILE
+static void histUseDark(tof_hist_t *hist)
+{
+    uint32_t shots = hist->dark_shots;
+    if (tofHistUseDark(hist) < 0) return;
+    printf("Dark-count reference of %u shots in use", shots);
+    if (tofHistSaveReference(hist, HIST_REF_FILE) == 0)
+    {
+        printf("; saved to %s", HIST_REF_FILE);
+    }
+    printf("\n");
+}
+
+static void histSink(void *entry, uint64_t seq, bool end_of_batch, void *arg)
+{
+    (void)seq, (void)end_of_batch;
+    struct SampleEntry *e = (struct SampleEntry *)entry;
+    struct HistOut *out = (struct HistOut *)arg;
+    if ((e->sample.flags & (SAMPLE_FLAG_END | SAMPLE_FLAG_DARK)) == (SAMPLE_FLAG_END | SAMPLE_FLAG_DARK))
+    {
+        histUseDark(out->hist);
+    }
+    else if (e->sample.flags & SAMPLE_FLAG_END) // write the last window now, under this acquisition's header
+    {
+        tofHistFlush(out->hist);
+    }
+    else if (e->sample.flags & SAMPLE_FLAG_DARK)
+    {
+        tofHistAddDark(out->hist, e->sample.flags & SAMPLE_FLAG_VALID, e->sample.tof);
+    }
+    else
+    {
+        tofHistAdd(out->hist, e->sample.time, e->sample.flags & SAMPLE_FLAG_VALID, e->sample.tof,
+                   e->sample.flags & SAMPLE_FLAG_ANGLE, e->sample.facet, e->sample.angle);
+    }
+}
+
+/**Function: histHandler
+ * Description: tofHist emit function. Writes one row per return to the data file and TCP clients,
+ *              and the histogram as one row of ';'-separated counts to HIST_FILE. Rows are queued
+ *              to TCP without blocking, and dropped if a slow client has filled the queue.
+ */
+static void histHandler(const tof_hist_t *hist, double time, uint32_t group, const uint32_t *counts,
+                        uint32_t shots, const hist_peak_t *peaks, int npeaks, void *arg)
+{
+    struct HistOut *out = (struct HistOut *)arg;
+    int facet = hist->facets ? (int)(group / hist->angle_bins) : -1;
+    double angle = hist->facets ? tofHistGroupAngle(hist, group) : -999.0;
+
+    char line[192];
+    for (int p = 0; p < npeaks; p++)
+    {
+        int len = sprintf(line, "%lf,%u,%d,%.4lf,%u,%d,%lf,%lf,%.1lf,%.4lf,%u,%.3lf,%.1lf\n", time, group, facet,
+                          angle, shots, p, peaks[p].tof * 1e6, calcDist(peaks[p].tof), peaks[p].amplitude,
+                          peaks[p].width * 1e9, peaks[p].counts, peaks[p].background, peaks[p].log_p);
+        outSegWrite(out->peak_seg, line, len, time);
+        if (out->tcp_handler != NULL && out->tcp_handler->tcp_state == TCPH_STATE_CONNECTED &&
+            tcpHandlerWrite(out->tcp_handler, line, len, 0, false) < 0) // never blocks the gating hist sink
+        {
+            out->tcp_dropped++;
+        }
+    }
+
+    int len = tofHistFormatRow(hist, out->row, time, group, counts, shots);
+    outSegWrite(out->hist_seg, out->row, len, time);
+} // end histHandler()
+
+static void metricsSink(void *entry, uint64_t seq, bool end_of_batch, void *arg)
+{
+    (void)seq, (void)end_of_batch;
+    struct SampleEntry *e = (struct SampleEntry *)entry;
+    struct SampleMetrics *m = (struct SampleMetrics *)arg;
+    if (e->sample.flags & SAMPLE_FLAG_END) return;
+
+    m->samples++;
+    if (!(e->sample.flags & SAMPLE_FLAG_VALID))
+    {
+        m->no_returns++;
+        return;
+    }
+
+    if (m->returns++ == 0) m->range_min = m->range_max = e->sample.dist;
+    m->range_sum += e->sample.dist;
+    if (e->sample.dist < m->range_min) m->range_min = e->sample.dist;
+    if (e->sample.dist > m->range_max) m->range_max = e->sample.dist;
+}
+
 double getEpochTime()
 {
     static struct timeval tv;
@@ -137,69 +401,70 @@ double getEpochTime()
     return tv.tv_sec + tv.tv_usec * 1E-6;
 }
 
-// This funciton will be executed in the data processor's thread
-void *dataprocFunc(void *arg)
+/**Function: decodeSample
+ * Parameters: tdc_t* tdc - TDC the sample was measured with
+ *             const char* raw - readout buffer filled by tdcReadResult(); NULL if no stop was measured
+ *             bool parity_valid - parity verdict from the acquisition core
+ *             uint8_t meas_mode - CONFIG1 measurement mode bits the sample was taken in
+ *             double time - seconds-from-the-epoch timestamp of the sample
+ *             scan_angle_t scan - mirror facet and scan angle when the shot was fired
+ *             bool data_break - add extra line break if true
+ *             struct SampleEntry* entry - receives the CSV row and the binary sample
+ *             double* raw_tof - receives the ToF before the per-TDC offset
+ *
+ * Description: Converts one TDC readout into a sample. Returns true if the sample holds a
+ *              valid return; otherwise entry is filled with dummy data. Runs concurrently on
+ *              decode threads, so shots without a return are counted by the metrics sink
+ *              rather than reported here.
+ */
+bool decodeSample(tdc_t *tdc, const char *raw, bool parity_valid, uint8_t meas_mode, double time,
+                  scan_angle_t scan, bool data_break, struct SampleEntry *entry, double *raw_tof)
 {
-    struct DataProcArg *tdc_arg = (struct DataProcArg *)arg;
-    // printf("dataprocFunc: %p\n", tdc_arg->raw_tdc_data);
-
     // variable declarations
-    bool valid_data_flag = true; // data validity flag; true if TDC data passes parity check
+    bool valid_data_flag = false; // data validity flag; true if TDC data passed parity check
     double ToF;                  // Time of flight
     double dist;                 // distance
-    double time;                 // seconds-from-the-epoch timestamp
-    char data_str[80];           // holds string to write to data file or TCP socket
-    int data_str_len;            // final length of data_str
     uint32_t tdc_data[5];        // TDC data converted from raw bytes to integers
-
-    // static array of rx_buff indices pointing to TDC register data within array of raw bytes
-    static uint8_t const rx_data_idx[] = {
-        1,  // TIME1 data start index
-        4,  // CLOCK_COUNT1 data start index
-        7,  // TIME2 data start index
-        11, // CALIBRATION1 data start index
-        14  // CLAIBRATION2 data start index
-    };
+    char *data_str = entry->line; // holds string to write to data file or TCP socket
+    int data_str_len;             // final length of data_str
 
     // initialize data string to dummy data. Floats are -999, unsigned ints are 0
     // if valid data received, data_str will be rewritten
-    data_str_len = sprintf(data_str, "%1$lf,%1$lf,%1$lf,%2$u,%2$u,%2$u,%2$u,%2$u\n",-999,0);
-
-    if (tdc_arg->raw_tdc_data != NULL) // if data pointer is valid, proceed to data processing;
+    // the scan position is known even without a return
+    data_str_len = sprintf(data_str, "%1$lf,%1$lf,%1$lf,%2$u,%2$u,%2$u,%2$u,%2$u,%3$u,%4$u,%5$u,%6$.4f\n",-999.0,0,tdc->id,meas_mode + 1,
+                           scan.facet, scan.angle_deg);
+    entry->sample = (sample_shm_slot_t){
+        .time = time,
+        .dist = -999.0,
+        .tof = -999.0,
+        .tdc = tdc->id,
+        .mode = meas_mode + 1,
+        .flags = scan.valid ? SAMPLE_FLAG_ANGLE : 0,
+        .facet = scan.facet,
+        .angle = scan.angle_deg};
+
+    if (raw != NULL) // if data pointer is valid, proceed to data processing;
     {
         /******** Converting Data into 32-bit Numbers ********/
-        /**Iterate over the indices in rx_data_idx, converting the 
-         * subset of 3 bytes (if using autoinc method) starting at rx_buff[rx_data_idx[i]]
+        /**Iterate over the indices in tdc_readout_idx, converting the 
+         * subset of 3 bytes starting at rx_buff[tdc_readout_idx[i]]
          */
-        for (uint8_t i = 0; i < 5; i++)
+        for (uint8_t i = 0; i < TDC_MEAS_NUM_REGS; i++)
         {
-            // convert data
-            #ifdef USE_AUTOINC_METHOD
-            uint32_t conv = convertSubsetToLong(tdc_arg->raw_tdc_data + rx_data_idx[i], 3, true);
-            #else
-            uint32_t conv = convertSubsetToLong(tdc_arg->raw_tdc_data + i * 4, 4, true);
-            #endif
-
-            // validate data
-            if (checkOddParity(conv))
-            {
-                valid_data_flag = false;
-                break;
-            }
-
+            uint32_t conv = convertSubsetToLong((char *)raw + tdc_readout_idx[i], 3, true);
             tdc_data[i] = conv & 0x7FFFFF; // clear the parity bit from data
         }
         /*****************************************************/
 
-        valid_data_flag = true; // NOTE: this line forces all data to be valid
-        // printf("valid=%d\n", valid_data_flag);
+        // parity was checked (and failing registers re-read) on the acquisition core
+        valid_data_flag = parity_valid;
 
         // if received data valid (i.e. passed parity check), continue with processing and
         // reformat data_str.
         if (valid_data_flag) 
         {
             uint8_t cal_periods;
-            switch (tdc_arg->tdc->cal_periods)
+            switch (tdc->cal_periods)
             {
                 default:
                 case TDC_CAL_2:
@@ -216,61 +481,632 @@ void *dataprocFunc(void *arg)
                     break;
             }
 
-            // ToF calculation
-            if (TDC_MEAS_MODE)
+            // ToF calculation for the mode this sample was measured in
+            if (meas_mode)
             {
-                ToF = calcToF(tdc_data, cal_periods, tdc_arg->tdc->clk_freq);
+                ToF = calcToF(tdc_data, cal_periods, tdc->clk_freq);
             }
             else
             {
-                ToF = tdc_data[0] * (cal_periods - 1) / ((double)tdc_data[4] - tdc_data[3]) / (double)tdc_arg->tdc->clk_freq;
+                ToF = calcToFMode1(tdc_data, cal_periods, tdc->clk_freq);
             }
+            *raw_tof = ToF;
+            ToF -= tdc->tof_offset; // per-TDC zero-range calibration
 
             dist = calcDist(ToF);
-            time = getEpochTime();
 
             // Reformat data_str
-            data_str_len = sprintf(data_str, "%lf,%lf,%lf,%u,%u,%u,%u,%u\n",
-                                time, dist, ToF * 1e6, tdc_data[0], tdc_data[1], tdc_data[2], tdc_data[3], tdc_data[4]);
-            if (tdc_arg->data_break) // add extra line break
+            data_str_len = sprintf(data_str, "%lf,%lf,%lf,%u,%u,%u,%u,%u,%u,%u,%u,%.4f\n",
+                                time, dist, ToF * 1e6, tdc_data[0], tdc_data[1], tdc_data[2], tdc_data[3], tdc_data[4],
+                                tdc->id, meas_mode + 1, scan.facet, scan.angle_deg);
+            if (data_break) // add extra line break
             {
                 data_str[data_str_len] = '\n';
                 data_str[++data_str_len] = '\0';
             }
+
+            entry->sample.dist = dist;
+            entry->sample.tof = ToF;
+            entry->sample.flags |= SAMPLE_FLAG_VALID;
+            memcpy(entry->sample.raw, tdc_data, sizeof(entry->sample.raw));
         } // end if (valid_data_flag)
-        else 
-        {
-            // if invalid data, leave data_str unchanged (i.e. leave as dummy data) and notify user.
-            printf("Invalid data. Parity check failed.\n");
-        } //end else linked to if (valid_data_flag)
-    } // end if (tdc_arg->raw_tdc_data != NULL)
-    else
+        // if invalid data (parity check failed), leave data_str unchanged (i.e. leave as dummy data)
+    } // end if (raw != NULL)
+    // if no data (overflow or timeout), leave data_str unchanged (i.e. leave as dummy data)
+
+    entry->len = data_str_len;
+    return valid_data_flag;
+} // end decodeSample()
+
+/** Sample processing:
+ *  The acquisition loop copies each shot's raw readout into a job of a processor pool
+ *  (proc_pool.h). With -w workers, that many threads decode jobs concurrently and the pool's
+ *  reassembly thread hands the results to emitSample() in shot order, so the mode controller
+ *  and the output sinks see samples exactly as they were taken. By default the pool runs
+ *  inline: each job is decoded and emitted on the acquisition thread as it is submitted, a few
+ *  microseconds per shot. testing/proc_bench.c measures whether workers pay off on a given Pi.
+ */
+#define PROC_WORKERS 0       // default worker threads, 0 for inline; -w overrides
+#define PROC_POOL_SLOTS 1024 // jobs in flight before the acquisition loop waits
+
+// a shot as queued by readoutTdc()
+struct ProcIn
+{
+    char raw[TDC_READOUT_LEN]; // readout buffer; unused if has_data is false
+    uint8_t tdc;               // TDC id
+    uint8_t meas_mode;         // CONFIG1 measurement mode bits the sample was taken in
+    bool has_data;             // false on overflow (no return), timeout or no result; dummy data is logged
+    bool parity_valid;         // false if a register still failed parity after re-reads on the acquisition core
+    double time;               // seconds since the epoch when the result was read
+    scan_angle_t scan;         // mirror facet and angle when the shot was fired
+};
+
+// a decoded shot, waiting for its turn in emitSample()
+struct ProcOut
+{
+    struct SampleEntry entry;
+    double raw_tof;
+    uint8_t meas_mode;
+    bool valid;
+};
+
+/** Everything an acquisition loop variant needs, gathered once in main() */
+struct AcqCtx
+{
+    tdc_t *tdcs;                // TDC_COUNT TDCs; shots alternate between them
+    shot_sched_t *shot_sched;   // shot deadline scheduler
+    shot_wave_t *shot_wave;     // shot waveform; used by ACQ_TRIG_SYNC only
+    mode_ctrl_t *mode_ctrl;     // measurement mode controller
+    proc_pool_t *pool;          // processor pool decoding measurements
+    out_seg_t *out_seg;         // data file output; discards rows if the logger is disabled
+    bcast_ring_t *ring;         // broadcast ring feeding the output sinks
+    struct SampleMetrics *metrics; // totals kept by the metrics sink
+    pcloud_t *pcloud;           // NULL unless point-cloud output is enabled
+    tof_hist_t *hist;           // NULL unless histogram output is enabled
+    out_seg_t *hist_seg;        // histogram file output; NULL unless histogram output is enabled
+    bool dark;                  // samples are flagged SAMPLE_FLAG_DARK; set only while the pool is idle
+    ctrl_t *ctrl;               // control plane mailbox, checked once per shot
+    mirror_t *mirror;           // NULL if the mirror is disabled
+    sos_t *sos;                 // start-of-scan capture; NULL if the mirror is disabled
+    uint32_t acq_usec;          // acquisition window; 0 runs until a stop or quit command
+    burst_t *burst;             // raw frame buffer; NULL unless burst capture is enabled
+    const char *config_desc;    // fixed part of the output config record
+    bool auto_mode;             // automatic measurement mode selection in use
+    bool shutter_state;
+    bool enable_state;
+    bool gate_state;
+    volatile bool acquiring;    // true while acquire() runs; read by the control thread
+    bool quit;                  // set by a quit command
+};
+
+// Decodes one queued shot; runs concurrently on the processor pool's workers, or inline
+static void decodeJob(void *in_v, void *out_v, void *arg)
+{
+    struct AcqCtx *ctx = (struct AcqCtx *)arg;
+    struct ProcIn *in = (struct ProcIn *)in_v;
+    struct ProcOut *out = (struct ProcOut *)out_v;
+    out->valid = decodeSample(&ctx->tdcs[in->tdc], in->has_data ? in->raw : NULL, in->parity_valid, in->meas_mode,
+                              in->time, in->scan, false, &out->entry, &out->raw_tof);
+    out->meas_mode = in->meas_mode;
+}
+
+// Passes one decoded shot on; runs on the processor pool's reassembly thread (or inline), in shot
+// order, which makes it the only caller of modeCtrlUpdate() and the only producer of the broadcast ring
+static void emitSample(void *out_v, uint64_t seq, void *arg)
+{
+    (void)seq;
+    struct AcqCtx *ctx = (struct AcqCtx *)arg;
+    struct ProcOut *out = (struct ProcOut *)out_v;
+
+    // raw ToF decides whether the other mode suits the scene better
+    if (out->valid && ctx->mode_ctrl != NULL)
     {
-        // if invalid data pointer received (e.g. in case of timeout) leave data_str unchanged
-        // (i.e. leave as dummy data) and notify user
-        printf("Invalid data. NULL data pointer received\n");
-    } // end else linked to if (tdc_arg->raw_tdc_data != NULL)
+        modeCtrlUpdate(ctx->mode_ctrl, out->meas_mode, out->raw_tof);
+    }
+
+    struct SampleEntry *entry = (struct SampleEntry *)bcastClaim(ctx->ring);
+    memcpy(entry, &out->entry, sizeof(struct SampleEntry));
+    if (ctx->dark)
+    {
+        entry->sample.flags |= SAMPLE_FLAG_DARK;
+    }
+    bcastPublish(ctx->ring); // pass data to the output sinks
+}
 
-    /********** Pass data to logger and tcp consumers if available **********/
-    // printf("logger state = %d\n", tdc_arg->logger->status);
-    if (tdc_arg->logger != NULL)
+/**Function: readoutTdc
+ * Parameters: struct AcqCtx* ctx - processor pool the shot is queued to
+ *             tdc_t* tdc - TDC armed for a shot that has already been fired
+ *             const bool autoinc - read registers with the autoincrement method
+ *             scan_angle_t scan - mirror facet and angle when the shot was fired
+ *
+ * Description: Waits for the TDC interrupt pin (or timeout) and reads the measurement registers
+ *              straight into the next processor pool job; nothing is allocated. On timeout the
+ *              job is queued without data, and dummy data is logged for it.
+ *              Always inlined so autoinc is folded into each acquisition loop variant.
+ */
+static inline __attribute__((always_inline))
+void readoutTdc(struct AcqCtx *ctx, tdc_t *tdc, const bool autoinc, scan_angle_t scan)
+{
+    enum TDC_MEAS_STATUS meas_status = tdcWaitResult(tdc);
+
+    struct ProcIn *job = (struct ProcIn *)procPoolClaim(ctx->pool);
+    job->tdc = tdc->id;
+    job->meas_mode = tdc->meas_mode;
+    job->has_data = (meas_status == TDC_MEAS_VALID); // else overflow (no return), timeout or no result
+    job->parity_valid = false;
+    if (job->has_data)
     {
-        loggerSendLogMsg(tdc_arg->logger, data_str, data_str_len, OUT_FILE, 0, true);
+        job->parity_valid = tdcReadResult(tdc, job->raw, autoinc, TDC_PARITY_RETRIES);
     }
-    // printf("TCP state = %d\n", tdc_arg->tcp_handler->tcp_state);
-    if (tdc_arg->tcp_handler != NULL && tdc_arg->tcp_handler->tcp_state == TCPH_STATE_CONNECTED)
+    job->time = getEpochTime();
+    job->scan = scan;
+    procPoolSubmit(ctx->pool);
+} // end readoutTdc()
+
+/**Function: recordTdc
+ * Description: Burst capture counterpart of readoutTdc(). Waits for the TDC and copies the raw
+ *              readout and tick into the next preallocated burst frame; nothing is allocated
+ *              or queued. A result arriving after the burst is full is discarded.
+ */
+static inline __attribute__((always_inline))
+void recordTdc(struct AcqCtx *ctx, tdc_t *tdc, const bool autoinc, scan_angle_t scan)
+{
+    enum TDC_MEAS_STATUS meas_status = tdcWaitResult(tdc);
+
+    burst_frame_t *frame = burstNext(ctx->burst);
+    if (frame == NULL) return;
+
+    frame->tick = gpioTick();
+    frame->tdc = tdc->id;
+    frame->meas_mode = tdc->meas_mode;
+    frame->status = meas_status;
+    frame->parity_valid = false;
+    frame->scan = scan;
+    if (meas_status == TDC_MEAS_VALID)
     {
-        tcpHandlerWrite(tdc_arg->tcp_handler, data_str, data_str_len, 0, true);
+        frame->parity_valid = tdcReadResult(tdc, frame->raw, autoinc, TDC_PARITY_RETRIES);
     }
-    /*************************************************************************/
+} // end recordTdc()
+
+// Decodes one burst frame into a SampleEntry; called by the burstDecode() threads
+static void decodeBurstFrame(const burst_frame_t *frame, uint32_t idx, void *out, void *arg)
+{
+    (void)idx;
+    struct AcqCtx *ctx = (struct AcqCtx *)arg;
+    double raw_tof;
+    decodeSample(&ctx->tdcs[frame->tdc], frame->status == TDC_MEAS_VALID ? frame->raw : NULL,
+                 frame->parity_valid, frame->meas_mode, burstFrameTime(ctx->burst, frame), frame->scan, false,
+                 (struct SampleEntry *)out, &raw_tof);
+}
 
-    free(tdc_arg->raw_tdc_data);
-    free(tdc_arg);
-    return NULL;
+// Passes the decoded burst to the output sinks in shot order. Called on the main thread once
+// the processor pool is drained, so the ring has a single producer at any time.
+static void publishBurst(struct AcqCtx *ctx)
+{
+    for (uint32_t i = 0; i < ctx->burst->count; i++)
+    {
+        struct SampleEntry *entry = (struct SampleEntry *)bcastClaim(ctx->ring);
+        memcpy(entry, burstOutput(ctx->burst, i), sizeof(struct SampleEntry));
+        bcastPublish(ctx->ring);
+    }
 }
 
-int main()
+/**Function: publishEnd
+ * Description: Publishes the end-of-acquisition marker once the acquisition's samples are all in
+ *              the ring (processor pool drained), and waits until the gating sinks have handled
+ *              it, so their output is complete before the acquisition's stats are printed.
+ */
+static void publishEnd(struct AcqCtx *ctx)
+{
+    struct SampleEntry *entry = (struct SampleEntry *)bcastClaim(ctx->ring);
+    memset(entry, 0, sizeof(struct SampleEntry));
+    entry->sample.time = getEpochTime();
+    entry->sample.flags = SAMPLE_FLAG_END | (ctx->dark ? SAMPLE_FLAG_DARK : 0);
+    bcastPublish(ctx->ring);
+    bcastSync(ctx->ring);
+} // end publishEnd()
+
+// Acquisition options chosen on the command line
+struct AcqConfig
 {
+    enum ACQ_TRIGGER trigger;
+    bool autoinc;    // autoincrement readout method
+    bool auto_mode;  // automatic measurement mode selection
+    bool use_logger;
+    bool use_tcp;
+    bool use_shm;
+    bool use_mirror;
+    bool continuous; // acquire from startup until stopped, in rotating output segments
+    bool burst;      // record raw frames in RAM during the window; decode and write afterwards
+    bool use_pcloud; // build a point cloud from angle-tagged returns
+    enum PCLOUD_FORMAT pcloud_format;
+    bool use_hist;   // write ToF histograms and their peaks instead of every sample
+    bool hist_angle; // one histogram per facet and angle bin rather than one per window
+    const char *hist_ref; // dark-count reference: "dark" records one at startup, anything else is a file to load
+};
+
+// Refreshes the output config record after a setting it reports has changed
+static void updateOutConfig(struct AcqCtx *ctx)
+{
+    outSegSetConfig(ctx->out_seg, "rate_hz=%.3lf %s", 1e9 / ctx->shot_sched->period_ns, ctx->config_desc);
+    outSegSetConfig(ctx->hist_seg, "rate_hz=%.3lf %s", 1e9 / ctx->shot_sched->period_ns, ctx->config_desc);
+}
+
+// Sets *state from a gate/shutter/enable command value (toggle for CTRL_TOGGLE), drives pin
+static void setCtrlPin(bool *state, double value, unsigned pin)
+{
+    *state = (value == CTRL_TOGGLE) ? !*state : (value != 0);
+    gpioWrite(pin, *state);
+}
+
+/**Function: handleCtrlCmd
+ * Description: Applies a control command taken from the mailbox. Runs on the acquisition
+ *              thread, either between shots or while idle. Start and laser commands are
+ *              handled by the idle loop in main(), so they are dropped while acquiring. Shutter
+ *              and enable commands are refused during a dark acquisition, whose samples must all
+ *              be taken with the laser off. Returns false if acquisition should stop.
+ */
+bool handleCtrlCmd(struct AcqCtx *ctx, ctrl_cmd_t *cmd)
+{
+    switch (cmd->type)
+    {
+    case CTRL_CMD_STOP:
+        return false;
+    case CTRL_CMD_QUIT:
+        ctx->quit = true;
+        return false;
+    case CTRL_CMD_RATE: // range checked by the control thread too
+        if (cmd->value > 1e6 / LASER_ACQ_PERIOD_USEC || shotSchedSetRate(ctx->shot_sched, cmd->value) < 0)
+        {
+            printf("Rate command refused: %lf shots/s is outside (0, %.0lf]\n", cmd->value, 1e6 / LASER_ACQ_PERIOD_USEC);
+            break;
+        }
+        updateOutConfig(ctx);
+        break;
+    case CTRL_CMD_RPM:
+        if (ctx->mirror != NULL)
+        {
+            mirrorSetRPM(*ctx->mirror, (int)cmd->value);
+        }
+        break;
+    case CTRL_CMD_GATE: // photon detector gate
+        setCtrlPin(&ctx->gate_state, cmd->value, DETECTOR_GATE_PIN);
+        break;
+    case CTRL_CMD_SHUTTER: // laser shutter
+        if (ctx->dark)
+        {
+            printf("Shutter command refused while recording the dark-count reference\n");
+            break;
+        }
+        setCtrlPin(&ctx->shutter_state, cmd->value, LASER_SHUTTER_PIN);
+        break;
+    case CTRL_CMD_ENABLE: // laser enable
+        if (ctx->dark)
+        {
+            printf("Enable command refused while recording the dark-count reference\n");
+            break;
+        }
+        setCtrlPin(&ctx->enable_state, cmd->value, LASER_ENABLE_PIN);
+        break;
+    default:
+        break; // start/laser are ignored while acquiring
+    }
+    return true;
+} // end handleCtrlCmd()
+
+/**Function: printAcqStats
+ * Description: Prints scheduler, mode and per-TDC statistics. Also used as the control plane
+ *              "stats" callback, where it runs on the control thread while acquisition may be
+ *              updating the counters; values are read without locking and may be mid-update.
+ */
+void printAcqStats(FILE *stream, void *arg)
+{
+    struct AcqCtx *ctx = (struct AcqCtx *)arg;
+
+    fprintf(stream, "acquiring: %s\n", ctx->acquiring ? "yes" : "no");
+    shotSchedPrintStats(ctx->shot_sched, stream);
+    if (ctx->auto_mode)
+    {
+        fprintf(stream, "measurement mode switches: %u (now mode %u)\n", ctx->mode_ctrl->switches, modeCtrlMode(ctx->mode_ctrl) + 1);
+    }
+    for (uint8_t i = 0; i < TDC_COUNT; i++)
+    {
+        tdcPrintParityStats(&ctx->tdcs[i], stream);
+        tdcPrintMeasStats(&ctx->tdcs[i], stream);
+    }
+
+    struct SampleMetrics *m = ctx->metrics;
+    fprintf(stream, "samples: %llu, returns: %llu, no return: %llu", (unsigned long long)m->samples,
+            (unsigned long long)m->returns, (unsigned long long)m->no_returns);
+    if (m->returns > 0)
+    {
+        fprintf(stream, ", range mean %.3lf m (min %.3lf, max %.3lf)", m->range_sum / m->returns, m->range_min, m->range_max);
+    }
+    fprintf(stream, "\n");
+    if (ctx->sos != NULL)
+    {
+        sosPrintStats(ctx->sos, stream);
+    }
+    if (ctx->pcloud != NULL)
+    {
+        pcloudPrintStats(ctx->pcloud, stream);
+    }
+    if (ctx->hist != NULL)
+    {
+        tofHistPrintStats(ctx->hist, stream);
+    }
+    procPoolPrintStats(ctx->pool, stream);
+    bcastPrintStats(ctx->ring, stream);
+} // end printAcqStats()
+
+/**Function: acquire
+ * Parameters: struct AcqCtx* ctx - acquisition resources
+ *             const enum ACQ_TRIGGER trigger - how each shot is started
+ *             const bool autoinc - readout method
+ *             const bool auto_mode - apply measurement mode changes requested by ctx->mode_ctrl
+ *             const bool burst - record raw frames into ctx->burst instead of queuing them for processing;
+ *                                the window also ends when the burst buffer is full
+ *
+ * Description: Runs the shot loop for ctx->acq_usec (without limit if 0) or until a stop or quit
+ *              command arrives.
+ *              Control commands are applied between shots. The option parameters are compile-time
+ *              constants in every caller (see ACQ_LOOP_VARIANT), so after inlining each variant
+ *              contains only the code of the options it was generated for.
+ */
+static inline __attribute__((always_inline))
+void acquire(struct AcqCtx *ctx, const enum ACQ_TRIGGER trigger, const bool autoinc, const bool auto_mode,
+             const bool burst)
+{
+    tdc_t *tdcs = ctx->tdcs;
+    tdc_t *pending_tdc = NULL; // TDC of the previous shot awaiting readout
+    scan_angle_t pending_scan = SCAN_ANGLE_NONE; // scan position of that shot
+    uint32_t shot_idx = 0;     // shot counter; selects the TDC of each shot
+
+    if (trigger == ACQ_TRIG_ASYNC)
+    {
+        gpioSetPWMfrequency(LASER_PULSE_PIN, LASER_PULSE_FREQ_HZ); // config PWM frequency
+        gpioPWM(LASER_PULSE_PIN, 255 / 2);                         // start PWM @ 50% (255/2) duty
+    }
+
+    for (uint8_t i = 0; i < TDC_COUNT; i++)
+    {
+        tdcResetStats(&tdcs[i]); // statistics are reported per acquisition window
+    }
+
+    ctx->acquiring = true;
+    bool run = true;
+    uint32_t acq_start_tick = gpioTick();                  // acquisition start tick
+    if (burst)
+    {
+        burstReset(ctx->burst, acq_start_tick, getEpochTime());
+    }
+    shotSchedStart(ctx->shot_sched);
+    // unsigned tick difference stays correct across the 72 minute gpioTick() wrap
+    while (run && (ctx->acq_usec == 0 || (gpioTick() - acq_start_tick) < ctx->acq_usec) &&
+           !(burst && burstFull(ctx->burst))) // main data acquisition loop
+    {
+        // apply pending control commands without stopping the data flow
+        ctrl_cmd_t cmd;
+        while (ctrlPoll(ctx->ctrl, &cmd))
+        {
+            run &= handleCtrlCmd(ctx, &cmd);
+        }
+
+        shotSchedWait(ctx->shot_sched); // block until this shot's deadline
+
+        tdc_t *shot_tdc = &tdcs[shot_idx++ % TDC_COUNT]; // alternate TDCs shot by shot
+
+        // periodically lower the SPI clock if parity errors appear
+        if (shot_idx % TDC_PARITY_CHECK_SHOTS == 0)
+        {
+            for (uint8_t i = 0; i < TDC_COUNT; i++)
+            {
+                tdcParityFallback(&tdcs[i], TDC_PARITY_MAX_ERRORS);
+            }
+        }
+
+        // apply a mode change requested by the controller; sent with the arm command
+        if (auto_mode && shot_tdc->meas_mode != modeCtrlMode(ctx->mode_ctrl))
+        {
+            tdcSetMeasMode(shot_tdc, modeCtrlMode(ctx->mode_ctrl));
+        }
+
+        tdcArm(shot_tdc);
+        gpioDelay(1); // small delay to allow TDC to process data
+
+        // scan position at the moment of firing, extrapolated from the latest SOS edge
+        scan_angle_t shot_scan = SCAN_ANGLE_NONE;
+        if (ctx->sos != NULL)
+        {
+            shot_scan = sosAngle(ctx->sos, gpioTick(), MIRROR_SOS_ANGLE_DEG);
+        }
+
+        if (trigger == ACQ_TRIG_DEBUG)
+        {
+            //DEBUGGING: wait a know period of time and send a stop pulse
+            gpioWrite(TDC_START_PIN, 1); // start TDC measurement
+            gpioDelay(TDC_DELAY_USEC);   // known delay
+            gpioWrite(TDC_STOP_PIN, 1);  // stop TDC measurement
+
+            if (fast_gpio) // reset both pins to known state in a single write
+            {
+                fastGpioClearBits((1u << TDC_STOP_PIN) | (1u << TDC_START_PIN));
+            }
+            else
+            {
+                gpioWrite(TDC_STOP_PIN, 0);  // reset pins to known state
+                gpioWrite(TDC_START_PIN, 0); // reset pins to known state
+            }
+        }
+        else if (trigger == ACQ_TRIG_SYNC)
+        {
+            // transmit the trigger pulse train and TDC START as one DMA waveform;
+            // START is lowered by the waveform at the end of the train
+            shotWaveFire(ctx->shot_wave);
+        }
+        else
+        {
+            gpioWrite(TDC_START_PIN, 1);
+        }
+
+        // With one TDC the shot just fired is read out immediately. With more, the
+        // TDC of the previous shot is read out while this shot's TDC is measuring
+        if (TDC_COUNT > 1)
+        {
+            if (pending_tdc != NULL)
+            {
+                if (burst) recordTdc(ctx, pending_tdc, autoinc, pending_scan);
+                else readoutTdc(ctx, pending_tdc, autoinc, pending_scan);
+            }
+            pending_tdc = shot_tdc;
+            pending_scan = shot_scan;
+        }
+        else
+        {
+            if (burst) recordTdc(ctx, shot_tdc, autoinc, shot_scan);
+            else readoutTdc(ctx, shot_tdc, autoinc, shot_scan);
+        }
+    } // end main data acquisitio loop; while((gpioTick() - acq_start_tick) < ...)
+
+    if (pending_tdc != NULL) // read out the final shot of a ping-pong acquisition
+    {
+        if (burst) recordTdc(ctx, pending_tdc, autoinc, pending_scan);
+        else readoutTdc(ctx, pending_tdc, autoinc, pending_scan);
+    }
+
+    if (trigger == ACQ_TRIG_ASYNC)
+    {
+        gpioPWM(LASER_PULSE_PIN, 0); // stop laser pulse train
+    }
+    ctx->acquiring = false;
+} // end acquire()
+
+/******** Acquisition loop variants ********/
+// one specialised copy of acquire() per option combination
+#define ACQ_LOOP_VARIANT(name, trigger, autoinc, auto_mode, burst) \
+    static void name(struct AcqCtx *ctx) { acquire(ctx, trigger, autoinc, auto_mode, burst); }
+
+ACQ_LOOP_VARIANT(acqAsyncSingleFixed, ACQ_TRIG_ASYNC, false, false, false)
+ACQ_LOOP_VARIANT(acqAsyncSingleAuto, ACQ_TRIG_ASYNC, false, true, false)
+ACQ_LOOP_VARIANT(acqAsyncAutoincFixed, ACQ_TRIG_ASYNC, true, false, false)
+ACQ_LOOP_VARIANT(acqAsyncAutoincAuto, ACQ_TRIG_ASYNC, true, true, false)
+ACQ_LOOP_VARIANT(acqSyncSingleFixed, ACQ_TRIG_SYNC, false, false, false)
+ACQ_LOOP_VARIANT(acqSyncSingleAuto, ACQ_TRIG_SYNC, false, true, false)
+ACQ_LOOP_VARIANT(acqSyncAutoincFixed, ACQ_TRIG_SYNC, true, false, false)
+ACQ_LOOP_VARIANT(acqSyncAutoincAuto, ACQ_TRIG_SYNC, true, true, false)
+ACQ_LOOP_VARIANT(acqDebugSingleFixed, ACQ_TRIG_DEBUG, false, false, false)
+ACQ_LOOP_VARIANT(acqDebugSingleAuto, ACQ_TRIG_DEBUG, false, true, false)
+ACQ_LOOP_VARIANT(acqDebugAutoincFixed, ACQ_TRIG_DEBUG, true, false, false)
+ACQ_LOOP_VARIANT(acqDebugAutoincAuto, ACQ_TRIG_DEBUG, true, true, false)
+
+// burst capture; samples are decoded after the window, so the measurement mode is fixed
+ACQ_LOOP_VARIANT(acqAsyncSingleBurst, ACQ_TRIG_ASYNC, false, false, true)
+ACQ_LOOP_VARIANT(acqAsyncAutoincBurst, ACQ_TRIG_ASYNC, true, false, true)
+ACQ_LOOP_VARIANT(acqSyncSingleBurst, ACQ_TRIG_SYNC, false, false, true)
+ACQ_LOOP_VARIANT(acqSyncAutoincBurst, ACQ_TRIG_SYNC, true, false, true)
+ACQ_LOOP_VARIANT(acqDebugSingleBurst, ACQ_TRIG_DEBUG, false, false, true)
+ACQ_LOOP_VARIANT(acqDebugAutoincBurst, ACQ_TRIG_DEBUG, true, false, true)
+
+// indexed by [trigger][autoinc][auto_mode]
+static void (*const acq_loops[ACQ_TRIG_NUM][2][2])(struct AcqCtx *) = {
+    [ACQ_TRIG_ASYNC] = {{acqAsyncSingleFixed, acqAsyncSingleAuto}, {acqAsyncAutoincFixed, acqAsyncAutoincAuto}},
+    [ACQ_TRIG_SYNC] = {{acqSyncSingleFixed, acqSyncSingleAuto}, {acqSyncAutoincFixed, acqSyncAutoincAuto}},
+    [ACQ_TRIG_DEBUG] = {{acqDebugSingleFixed, acqDebugSingleAuto}, {acqDebugAutoincFixed, acqDebugAutoincAuto}}};
+
+// indexed by [trigger][autoinc]
+static void (*const burst_loops[ACQ_TRIG_NUM][2])(struct AcqCtx *) = {
+    [ACQ_TRIG_ASYNC] = {acqAsyncSingleBurst, acqAsyncAutoincBurst},
+    [ACQ_TRIG_SYNC] = {acqSyncSingleBurst, acqSyncAutoincBurst},
+    [ACQ_TRIG_DEBUG] = {acqDebugSingleBurst, acqDebugAutoincBurst}};
+/*******************************************/
+
+int main(int argc, char **argv)
+{
+    /***** Command line options *****/
+    // -s pigpio|spidev : SPI backend used to talk to the TDCs
+    // -g meters        : near-field gate; stops closer than this are ignored
+    // -m 1|2|auto      : TDC measurement mode; auto switches between modes with the scene
+    // -t sync|async|debug : trigger method
+    // -r autoinc|single   : TDC register readout method
+    // -d logger|tcp|shm|mirror : disable a consumer or peripheral; may be repeated
+    // -H window|angle  : write ToF histograms and their peaks, per HIST_WINDOW_SEC or per scan angle, instead of samples
+    // -R dark|file     : with -H, subtract a dark-count reference recorded for HIST_DARK_SEC at startup, or loaded from file
+    // -c               : continuous acquisition from startup until stop/quit; output rotated every OUT_SEGMENT_SEC
+    // -b               : burst capture; raw frames held in RAM during each window, decoded and written afterwards
+    enum TDC_SPI_BACKEND spi_backend = TDC_SPI_BACKEND_DEFAULT;
+    double min_range_m = TDC_MIN_RANGE_M;
+    uint8_t meas_mode = TDC_MEAS_MODE;
+    struct AcqConfig acq_cfg = {
+        .trigger = ACQ_TRIGGER_DEFAULT,
+        .autoinc = ACQ_AUTOINC_DEFAULT,
+        .auto_mode = false,
+        .use_logger = USE_LOGGER_DEFAULT,
+        .use_tcp = USE_TCP_DEFAULT,
+        .use_shm = USE_SHM_DEFAULT,
+        .use_mirror = USE_MIRROR_DEFAULT,
+        .continuous = false,
+        .burst = false};
+    int proc_workers = PROC_WORKERS;
+    rt_profile_t rt;
+    rtProfileInit(&rt, MAIN_CORE, MAIN_PRIORITY);
+    int opt;
+    while ((opt = getopt(argc, argv, "s:g:m:t:r:d:w:p:o:H:R:cb")) != -1)
+    {
+        if (opt == 's' && strcmp(optarg, "spidev") == 0) spi_backend = TDC_SPI_SPIDEV;
+        else if (opt == 's' && strcmp(optarg, "pigpio") == 0) spi_backend = TDC_SPI_PIGPIO;
+        else if (opt == 'g') min_range_m = atof(optarg);
+        else if (opt == 'm' && strcmp(optarg, "1") == 0) meas_mode = MODE_CTRL_MODE1;
+        else if (opt == 'm' && strcmp(optarg, "2") == 0) meas_mode = MODE_CTRL_MODE2;
+        else if (opt == 'm' && strcmp(optarg, "auto") == 0) acq_cfg.auto_mode = true;
+        else if (opt == 't' && strcmp(optarg, "sync") == 0) acq_cfg.trigger = ACQ_TRIG_SYNC;
+        else if (opt == 't' && strcmp(optarg, "async") == 0) acq_cfg.trigger = ACQ_TRIG_ASYNC;
+        else if (opt == 't' && strcmp(optarg, "debug") == 0) acq_cfg.trigger = ACQ_TRIG_DEBUG;
+        else if (opt == 'r' && strcmp(optarg, "autoinc") == 0) acq_cfg.autoinc = true;
+        else if (opt == 'r' && strcmp(optarg, "single") == 0) acq_cfg.autoinc = false;
+        else if (opt == 'd' && strcmp(optarg, "logger") == 0) acq_cfg.use_logger = false;
+        else if (opt == 'd' && strcmp(optarg, "tcp") == 0) acq_cfg.use_tcp = false;
+        else if (opt == 'd' && strcmp(optarg, "shm") == 0) acq_cfg.use_shm = false;
+        else if (opt == 'd' && strcmp(optarg, "mirror") == 0) acq_cfg.use_mirror = false;
+        else if (opt == 'w' && atoi(optarg) >= 0 && atoi(optarg) <= PROC_MAX_WORKERS) proc_workers = atoi(optarg);
+        else if (opt == 'p' && rtProfileParse(&rt, optarg) == 0) continue;
+        else if (opt == 'c') acq_cfg.continuous = true;
+        else if (opt == 'b') acq_cfg.burst = true;
+        else if (opt == 'o' && strcmp(optarg, "ply") == 0) acq_cfg.use_pcloud = true, acq_cfg.pcloud_format = PCLOUD_PLY;
+        else if (opt == 'o' && strcmp(optarg, "pcd") == 0) acq_cfg.use_pcloud = true, acq_cfg.pcloud_format = PCLOUD_PCD;
+        else if (opt == 'H' && strcmp(optarg, "window") == 0) acq_cfg.use_hist = true, acq_cfg.hist_angle = false;
+        else if (opt == 'H' && strcmp(optarg, "angle") == 0) acq_cfg.use_hist = true, acq_cfg.hist_angle = true;
+        else if (opt == 'R') acq_cfg.hist_ref = optarg;
+        else
+        {
+            printf("Usage: %s [-s pigpio|spidev] [-g min_range_m] [-m 1|2|auto] [-t sync|async|debug]\n"
+                   "       [-r autoinc|single] [-d logger|tcp|shm|mirror]... [-w workers] [-o ply|pcd]\n"
+                   "       [-H window|angle] [-R dark|file] [-c|-b]\n"
+                   "       [-p acq|proc|sink|logger|tcp|ctrl=cpus[:priority]]...\n", argv[0]);
+            return -1;
+        }
+    }
+    if (acq_cfg.burst && (acq_cfg.continuous || acq_cfg.auto_mode))
+    {
+        printf("Burst capture needs a bounded window and a fixed measurement mode; -b excludes -c and -m auto\n");
+        return -1;
+    }
+    if (acq_cfg.use_pcloud && !acq_cfg.use_mirror)
+    {
+        printf("Point-cloud output needs scan angles from the mirror; -o excludes -d mirror\n");
+        return -1;
+    }
+    if (acq_cfg.hist_ref != NULL && !acq_cfg.use_hist)
+    {
+        printf("A dark-count reference is subtracted from histograms; -R needs -H\n");
+        return -1;
+    }
+    if (acq_cfg.hist_angle && !acq_cfg.use_mirror)
+    {
+        printf("Per-angle histograms need scan angles from the mirror; -H angle excludes -d mirror\n");
+        return -1;
+    }
+    /********************************/
+
     /***** GPIO clock configuration and GPIO library initialisation *****/
     gpioCfgClock(1, PI_CLOCK_PCM, 0); //1us sample rate, PCM clock to free up PWM clock
     if (gpioInitialise() == PI_INIT_FAILED)
@@ -280,98 +1116,215 @@ int main()
     }
     /********************************************************************/
 
-    /********** Building CPU masks and thread attr's **********/
-    cpu_set_t main_cpu;
-    CPU_ZERO(&main_cpu);
-    CPU_SET(MAIN_CORE, &main_cpu);
+    #ifdef USE_FAST_GPIO
+    fast_gpio = (fastGpioInit() == 0);
+    if (!fast_gpio)
+    {
+        printf("WARNING: GPIO registers not mapped; using pigpio for INT polling\n");
+    }
+    #endif
 
-    cpu_set_t poller_cpu;
-    CPU_ZERO(&poller_cpu);
-    CPU_SET(POLL_CORE, &poller_cpu);
+    /********** RT profile **********/
+    // lock memory before any of our threads exist so their stacks are locked and small
+    rtProfileLockMemory(&rt);
+    rtProfilePrint(&rt, stdout);
+    if (rtProfileCheck(&rt, stdout) > 0)
+    {
+        printf("WARNING: worst-case shot latency is not bounded with this configuration\n");
+    }
 
-    cpu_set_t nonisol_cpu;
-    CPU_ZERO(&nonisol_cpu);
-    for (uint8_t i = 0; i < get_nprocs_conf(); i++) // iterate over available cpu cores
+    cpu_set_t all_cpu; // every core; used between bursts, when nothing real-time is running
+    CPU_ZERO(&all_cpu);
+    for (uint8_t i = 0; i < get_nprocs_conf(); i++)
     {
-        // add core to non isolated set if not main or poller core
-        if (i != MAIN_CORE && i != POLL_CORE)
-        {
-            CPU_SET(i, &nonisol_cpu);
-        }
+        CPU_SET(i, &all_cpu);
     }
-    /********************************************/
+    /********************************/
 
     /********** Threaded Logger Configuration *********/
     logger_t *logger = NULL;
     pthread_t logger_tid = 0;
-    #ifdef USE_LOGGER
-    pthread_attr_t logger_attr;
-    logger = loggerCreate(100);
+    if (acq_cfg.use_logger)
+    {
+        pthread_attr_t logger_attr;
+        logger = loggerCreate(100);
 
-    // configure logger thread attribute to assign cpu cores
-    pthread_attr_init(&logger_attr);
-    pthread_attr_setaffinity_np(&logger_attr, sizeof(nonisol_cpu), &nonisol_cpu);
+        // configure logger thread attribute to assign cpu cores
+        pthread_attr_init(&logger_attr);
+        rtProfileSetAttr(&rt, RT_ROLE_LOGGER, &logger_attr);
 
-    pthread_create(&logger_tid, &logger_attr, &loggerMain, logger); // start loggerMain, passing the configured logger struct as argument
-    pthread_attr_destroy(&logger_attr);                             // destroy attr; no effect on already created threads
-    #endif
+        pthread_create(&logger_tid, &logger_attr, &loggerMain, logger); // start loggerMain, passing the configured logger struct as argument
+        pthread_attr_destroy(&logger_attr);                             // destroy attr; no effect on already created threads
+    }
     /************************************************/
 
     /********** TCP Handler Configuration **********/
     tcp_handler_t *tcp_handler = NULL;
     pthread_t tcp_tid = 0;
-    #ifdef USE_TCP
-    pthread_attr_t tcp_attr;
-    struct sockaddr_in server_addr = {
-        .sin_family = AF_INET,        //TCP
-        .sin_port = htons(TCP_PORT),  //define port
-        .sin_addr.s_addr = INADDR_ANY //accept connection at any address available
-    };
-    tcp_handler = tcpHandlerInit(server_addr, 100);
-
-    // config tcp thread attribute to assign non-isolated cores
-    pthread_attr_init(&tcp_attr);
-    pthread_attr_setaffinity_np(&tcp_attr, sizeof(nonisol_cpu), &nonisol_cpu);
-
-    pthread_create(&tcp_tid, &tcp_attr, &tcpHandlerMain, tcp_handler); // start tcp thread
-    pthread_attr_destroy(&tcp_attr);                                   // destroy attr; no effect on already created threads
-    #endif
+    if (acq_cfg.use_tcp)
+    {
+        pthread_attr_t tcp_attr;
+        struct sockaddr_in server_addr = {
+            .sin_family = AF_INET,        //TCP
+            .sin_port = htons(TCP_PORT),  //define port
+            .sin_addr.s_addr = INADDR_ANY //accept connection at any address available
+        };
+        tcp_handler = tcpHandlerInit(server_addr, 100);
+
+        // config tcp thread attribute to assign non-isolated cores
+        pthread_attr_init(&tcp_attr);
+        rtProfileSetAttr(&rt, RT_ROLE_TCP, &tcp_attr);
+
+        pthread_create(&tcp_tid, &tcp_attr, &tcpHandlerMain, tcp_handler); // start tcp thread
+        pthread_attr_destroy(&tcp_attr);                                   // destroy attr; no effect on already created threads
+    }
     /*************************************************/
 
-    /********* Data Processor Configuraiton *********/
-    pthread_t data_proc_tid = 0;
-    pthread_attr_t data_proc_attr;
-    dataproc_t *data_proc = dataprocCreate(100);
-
-    // configure data processor core affinities to non-isolated cores
-    pthread_attr_init(&data_proc_attr);
-    pthread_attr_setaffinity_np(&data_proc_attr, sizeof(nonisol_cpu), &nonisol_cpu);
-
-    pthread_create(&data_proc_tid, &data_proc_attr, &dataprocMain, data_proc); // start data processor thread
-    pthread_attr_destroy(&data_proc_attr);                                     // destroy attr; no effect on already created threads
-    /************************************************/
-
-    /********* Pin Poller Configuration *********/
-    pin_poller_t *poller = NULL;
-    pthread_t poller_tid = 0;
-    #ifdef USE_POLLER
-    pthread_spinlock_t lock;
-    pthread_attr_t poller_attr;
-    poller = pinPollerInit(&lock, SOS_PIN, SOS_LEVEL, SOS_DELAY_USEC);
+    /********* Shared-memory sample ring *********/
+    // local readers attach with sampleShmOpen(SAMPLE_SHM_NAME); see testing/shm_reader.c
+    sample_shm_t *shm = NULL;
+    if (acq_cfg.use_shm)
+    {
+        shm = sampleShmCreate(SAMPLE_SHM_NAME, SAMPLE_SHM_SLOTS);
+        if (shm == NULL)
+        {
+            printf("WARNING: failed to create shared-memory sample ring\n");
+        }
+    }
+    /**********************************************/
+
+    /********* Data file output *********/
+    // windowed runs append to OUT_FILE; continuous runs rotate through time-stamped segments
+    // with -H, OUT_FILE holds the returns found in the histograms and HIST_FILE the histograms
+    static const char hdr_strs[] =
+        "TIMESTAMP (s),DIST (m),TOF (usec),TIME1,CLOCK_COUNT1,TIME2,CAL1,CAL2,TDC,MODE,FACET,ANGLE (deg)\n";
+    static const char peak_hdr_strs[] =
+        "TIMESTAMP (s),GROUP,FACET,ANGLE (deg),SHOTS,RETURN,TOF (usec),DIST (m),AMPLITUDE,WIDTH (nsec),COUNTS,BACKGROUND,LOG10_P\n";
+    static const char hist_hdr_strs[] = HIST_ROW_HEADER;
+    out_seg_t *out_seg = outSegCreate(logger, OUT_FILE, acq_cfg.use_hist ? peak_hdr_strs : hdr_strs,
+                                      acq_cfg.continuous ? OUT_SEGMENT_SEC : 0,
+                                      acq_cfg.continuous ? OUT_RECORD_SEC : 0);
+    out_seg_t *hist_seg = NULL;
+    if (acq_cfg.use_hist)
+    {
+        hist_seg = outSegCreate(logger, HIST_FILE, hist_hdr_strs,
+                                acq_cfg.continuous ? OUT_SEGMENT_SEC : 0,
+                                acq_cfg.continuous ? OUT_RECORD_SEC : 0);
+    }
+    /*************************************/
+
+    /********* Point cloud *********/
+    // x, y, z points of angle-tagged returns, to PCLOUD_FILE and TCP clients of PCLOUD_TCP_PORT
+    pcloud_t *pcloud = NULL;
+    tcp_handler_t *pcloud_tcp = NULL;
+    pthread_t pcloud_tcp_tid = 0;
+    if (acq_cfg.use_pcloud)
+    {
+        static const float facet_elev[MIRROR_FACETS] = MIRROR_FACET_ELEV_DEG;
+        pcloud = pcloudCreate(acq_cfg.pcloud_format, MIRROR_FACETS, facet_elev, MIRROR_SOS_ANGLE_DEG,
+                              720.0 / MIRROR_FACETS);
+        if (pcloud == NULL)
+        {
+            perror("CRITICAL ERROR in pcloudCreate()");
+            return -1;
+        }
+        pcloudOpenFile(pcloud, acq_cfg.pcloud_format == PCLOUD_PCD ? PCLOUD_FILE ".pcd" : PCLOUD_FILE ".ply");
+    }
+    if (pcloud != NULL && acq_cfg.use_tcp)
+    {
+        pthread_attr_t tcp_attr;
+        struct sockaddr_in server_addr = {
+            .sin_family = AF_INET,
+            .sin_port = htons(PCLOUD_TCP_PORT),
+            .sin_addr.s_addr = INADDR_ANY};
+        pcloud_tcp = tcpHandlerInit(server_addr, 100);
+
+        pthread_attr_init(&tcp_attr);
+        rtProfileSetAttr(&rt, RT_ROLE_TCP, &tcp_attr);
+
+        pthread_create(&pcloud_tcp_tid, &tcp_attr, &tcpHandlerMain, pcloud_tcp); // start point-cloud tcp thread
+        pthread_attr_destroy(&tcp_attr);
+        pcloudSetStream(pcloud, &pcloudTcpWrite, pcloud_tcp);
+    }
+    /*******************************/
 
-    // configure spin lock; unshared between processes (only between threads)
-    pthread_spin_init(&lock, 0);
+    /********* ToF histograms *********/
+    // bins of HIST_BIN_NSEC out to HIST_MAX_RANGE_M, closed every HIST_WINDOW_SEC
+    struct HistOut hist_out = {.peak_seg = out_seg, .hist_seg = hist_seg, .tcp_handler = tcp_handler};
+    if (acq_cfg.use_hist)
+    {
+        uint32_t hist_bins = (uint32_t)ceil(2.0 * HIST_MAX_RANGE_M / LIGHT_SPEED / (HIST_BIN_NSEC * 1e-9));
+        hist_out.hist = tofHistCreate(hist_bins, HIST_BIN_NSEC * 1e-9, 0.0, HIST_WINDOW_SEC,
+                                      acq_cfg.hist_angle ? MIRROR_FACETS : 0, HIST_ANGLE_BINS,
+                                      MIRROR_SOS_ANGLE_DEG, 720.0 / MIRROR_FACETS, &histHandler, &hist_out);
+        hist_out.row = (char *)malloc(HIST_ROW_MAX(hist_bins));
+        if (hist_out.hist == NULL || hist_out.row == NULL)
+        {
+            perror("CRITICAL ERROR in tofHistCreate()");
+            return -1;
+        }
+        if (acq_cfg.hist_ref != NULL && strcmp(acq_cfg.hist_ref, "dark") != 0 &&
+            tofHistLoadReference(hist_out.hist, acq_cfg.hist_ref) < 0)
+        {
+            printf("CRITICAL ERROR: failed to load dark-count reference %s\n", acq_cfg.hist_ref);
+            return -1;
+        }
+    }
+    /***********************************/
 
-    // configure polling thread core affinities to non-isolated cores
-    pthread_attr_init(&poller_attr);
-    pthread_attr_setaffinity_np(&poller_attr, sizeof(nonisol_cpu), &nonisol_cpu);
+    /********* Output sinks *********/
+    // each enabled consumer reads samples from the broadcast ring on its own thread
+    struct SampleMetrics metrics = {0};
+    bcast_ring_t *ring = bcastCreate(SAMPLE_RING_ENTRIES, sizeof(struct SampleEntry));
+    if (ring == NULL)
+    {
+        perror("CRITICAL ERROR in bcastCreate()");
+        return -1;
+    }
+    if (logger != NULL && hist_out.hist == NULL)
+    {
+        bcastAddSink(ring, "file", &fileSink, out_seg, BCAST_WAIT_BLOCK, BCAST_GATE);
+    }
+    if (shm != NULL)
+    {
+        bcastAddSink(ring, "shm", &shmSink, shm, BCAST_WAIT_BLOCK, BCAST_GATE);
+    }
+    if (tcp_handler != NULL && hist_out.hist == NULL)
+    {
+        bcastAddSink(ring, "tcp", &tcpSink, tcp_handler, BCAST_WAIT_SLEEP, BCAST_DROP);
+    }
+    bcastAddSink(ring, "metrics", &metricsSink, &metrics, BCAST_WAIT_SLEEP, BCAST_DROP);
+    if (pcloud != NULL)
+    {
+        bcastAddSink(ring, "pcloud", &pcloudSink, pcloud, BCAST_WAIT_BLOCK, BCAST_GATE);
+    }
+    if (hist_out.hist != NULL)
+    {
+        bcastAddSink(ring, "hist", &histSink, &hist_out, BCAST_WAIT_BLOCK, BCAST_GATE);
+    }
+    bcastStart(ring, &rt.roles[RT_ROLE_SINK].cpus);
+    for (int i = 0; i < ring->sink_count; i++)
+    {
+        rtProfileApplyThread(&rt, RT_ROLE_SINK, ring->sinks[i].tid);
+    }
+    /********************************/
 
-    pthread_create(&poller_tid, &poller_attr, &pinPollerMain, poller); // start polling thread
-    pthread_attr_destroy(&poller_attr);                                // destroy attr; no effect on already created threads
-    #endif
-    /*******************************************/
+    /********* Start-of-scan capture *********/
+    // edges arrive through pigpio alerts; no thread or core of our own
+    sos_t *sos = NULL;
+    if (acq_cfg.use_mirror)
+    {
+        sos = sosCreate(SOS_PIN, SOS_LEVEL, MIRROR_FACETS, SOS_GLITCH_USEC);
+        if (sos == NULL || sosStart(sos) < 0)
+        {
+            printf("WARNING: start-of-scan capture disabled\n");
+            sosDestroy(sos);
+            sos = NULL;
+        }
+    }
+    /*****************************************/
 
-    pthread_setaffinity_np(pthread_self(), sizeof(main_cpu), &main_cpu); // place DAQ thread on isolated cpu 3
+    rtProfileApplyThread(&rt, RT_ROLE_ACQ, pthread_self()); // place DAQ thread on its isolated core
 
     /********* MLD-019 Serial Comms Initialization *********/
     mld_t *mld = NULL;
@@ -382,33 +1335,57 @@ int main()
 
     /******** TDC Initialization *********/
     // opens SPI connection and configures assigned pins
-    tdc_t tdc = {
-        .enable_pin = TDC_ENABLE_PIN,
-        .int_pin = TDC_INT_PIN,
-        .clk_pin = TDC_CLK_PIN,
-        .clk_freq = TDC_CLK_FREQ,
-        .timeout_us = TDC_TIMEOUT_USEC,
-        .cal_periods = TDC_CAL_2};
-    tdcInit(&tdc, TDC_BAUD);
+    static const uint8_t tdc_spi_channels[] = TDC_SPI_CHANNELS;
+    static const uint32_t tdc_spi_flags[] = TDC_SPI_FLAGS;
+    static const uint8_t tdc_enable_pins[] = TDC_ENABLE_PINS;
+    static const uint8_t tdc_int_pins[] = TDC_INT_PINS;
+    static const double tdc_tof_offsets[] = TDC_TOF_OFFSETS_SEC;
+
+    tdc_t tdcs[TDC_COUNT];
+    for (uint8_t i = 0; i < TDC_COUNT; i++)
+    {
+        tdcs[i] = (tdc_t){
+            .id = i,
+            .spi_channel = tdc_spi_channels[i],
+            .spi_flags = tdc_spi_flags[i],
+            .enable_pin = tdc_enable_pins[i],
+            .int_pin = tdc_int_pins[i],
+            .clk_pin = TDC_CLK_PIN,
+            .clk_freq = TDC_CLK_FREQ,
+            .timeout_us = TDC_TIMEOUT_USEC,
+            .cal_periods = TDC_CAL_2,
+            .meas_mode = meas_mode,
+            .tof_offset = tdc_tof_offsets[i],
+            .spi_backend = spi_backend};
+        tdcInit(&tdcs[i], TDC_BAUD);
+
+        // TDC must see rising edge of ENABLE while powered for proper internal initializaiton
+        tdcEnable(&tdcs[i]);
+
+        // parity and rising edge start, stop, trigger signals
+        tdcSetReg(&tdcs[i], TDC_CONFIG1, TDC_CONFIG1_BITS(0, 1, 0, 0, 0, meas_mode, 0));
+        // 2 calibration clock periods, no averaging, and single stop signal operation
+        tdcSetReg(&tdcs[i], TDC_CONFIG2, TDC_CONFIG2_BITS(tdcs[i].cal_periods, TDC_AVG_1CYC, 1));
+
+        // let the TDC end no-return measurements itself after the maximum range window
+        tdcSetMaxRange(&tdcs[i], TDC_MAX_RANGE_M);
+
+        // ignore early stops from internal reflections and detector ringing
+        if (tdcSetMinRange(&tdcs[i], min_range_m) < 0)
+        {
+            printf("WARNING: near-field gate requires measurement mode 2; gate disabled while in mode 1\n");
+        }
+
+        // all staged registers go out in a single auto-increment burst
+        tdcConfigure(&tdcs[i]);
+
+        // raise the SPI clock as far as register read-back stays reliable
+        tdcAutotuneBaud(&tdcs[i], TDC_SPI_MAX_BAUD, TDC_SPI_TUNE_TRIALS, TDC_SPI_TUNE_MARGIN);
+    }
 
     // enable additional pins for debugging
     gpioSetMode(TDC_START_PIN, PI_OUTPUT); // active HI
     gpioSetMode(TDC_STOP_PIN, PI_OUTPUT);  // active HI
-
-    // TDC must see rising edge of ENABLE while powered for proper internal initializaiton
-    gpioWrite(tdc.enable_pin, 0);
-    gpioDelay(3); // Short delay to make sure TDC sees LOW before rising edge
-    gpioWrite(tdc.enable_pin, 1);
-
-    //Non-incrementing write to CONFIG2 reg (address 0x01)
-    //Clear CONFIG2 to configure 2 calibration clock periods,
-    // no averaging, and single stop signal operation
-    char config2_cmds[] = {
-        TDC_CMD(0, 1, TDC_CONFIG2),
-        TDC_CONFIG2_BITS(tdc.cal_periods, TDC_AVG_1CYC, 1)};
-    char config2_rx[sizeof(config2_cmds)];
-
-    spiXfer(tdc.spi_handle, config2_cmds, config2_rx, sizeof(config2_cmds));
     /****************************************/
 
     /********* Initializing laser control pins *********/
@@ -422,64 +1399,171 @@ int main()
     gpioWrite(LASER_ENABLE_PIN, 0);  // initialise to low/disabled
     /**************************************************/
 
-    #ifdef USE_MIRROR
+    /********* Laser shot waveform *********/
+    // trigger pulse train and TDC START edge built as a single DMA-timed waveform
+    shot_wave_t shot_wave = {
+        .laser_pin = LASER_PULSE_PIN,
+        .start_pin = TDC_START_PIN,
+        .laser_pol = LASER_PULSE_POL,
+        .pulse_count = LASER_PULSE_COUNT,
+        .pulse_period_us = LASER_PULSE_PERIOD_USEC,
+        .start_pulse = LASER_START_PULSE,
+        .start_delay_us = TDC_START_DELAY_USEC,
+        .wave_id = -1};
+    if (acq_cfg.trigger == ACQ_TRIG_SYNC && shotWaveCreate(&shot_wave) < 0)
+    {
+        printf("WARNING: failed to create laser shot waveform\n");
+    }
+    /***************************************/
+
     /********* Mirror configuration *********/
     mirror_t mirror = {
         .FREQ_PIN = MIRROR_FREQ_PIN,
         .ENABLE_PIN = MIRROR_ENABLE_PIN,
         .ATSPEED_PIN = MIRROR_ATSPEED_PIN};
-    mirrorConfig(mirror);    // configure pins
-    mirrorSetRPM(mirror, 0); // start with mirror off
-    #endif
+    if (acq_cfg.use_mirror)
+    {
+        mirrorConfig(mirror);    // configure pins
+        mirrorSetRPM(mirror, 0); // start with mirror off
+    }
     /****************************************/
 
-    while (1) // begin main loop
+    /********* Shot scheduler *********/
+    // fires one shot per LASER_SHOT_RATE_HZ period on absolute deadlines
+    shot_sched_t *shot_sched = shotSchedCreate(LASER_SHOT_RATE_HZ, SHOT_SPIN_NSEC, SHOT_HIST_SIZE);
+    if (shot_sched == NULL)
     {
-        static bool shutter_state = 0;
-        static bool enable_state = 0;
-        static bool gate_state = 0;
-
-        char str_in[10];
-        char c;
-        printf("Enter S to toggle shutter.\n");
-        printf("Enter E to toggle enable.\n");
-        printf("Enter P to begin a TDC measurement.\n");
-        printf("Enter G to toggle detector gate.\n");
-        printf("Enter L to emit laser pulse signal.\n");
-        printf("Enter a number to set mirror RPM.\n");
-        printf("Enter 'q' or 'Q' to quit.\n");
-        scanf(" %s", &str_in);
+        perror("CRITICAL ERROR in shotSchedCreate()");
+        return -1;
+    }
+    /**********************************/
 
-        if (isdigit(*str_in)) //if first char is number assume whole string number
+    /********* Burst capture buffer *********/
+    // allocated and locked once; a burst window never allocates or takes a page fault
+    burst_t *burst = NULL;
+    if (acq_cfg.burst)
+    {
+        burst = burstCreate(BURST_FRAMES, sizeof(struct SampleEntry));
+        if (burst == NULL)
         {
-
-            int freq = atoi(str_in);    // set mirror rpm
-            #ifdef USE_MIRROR
-            mirrorSetRPM(mirror, freq); // jump to next loop iteration
-            #endif
-            
-            continue;
+            perror("CRITICAL ERROR in burstCreate()");
+            return -1;
         }
-        else if (strlen(str_in) == 1)
+    }
+    /****************************************/
+
+    /********* Measurement mode controller *********/
+    // with -m auto, picks mode 1 or 2 from recent ranges; otherwise holds the fixed mode
+    mode_ctrl_t *mode_ctrl = modeCtrlCreate(meas_mode, acq_cfg.auto_mode, TDC_MODE2_TOF_NSEC * 1e-9,
+                                            TDC_MODE1_TOF_NSEC * 1e-9, TDC_MODE_WINDOW);
+    if (mode_ctrl == NULL)
+    {
+        perror("CRITICAL ERROR in modeCtrlCreate()");
+        return -1;
+    }
+    /***********************************************/
+
+    struct AcqCtx acq = {
+        .tdcs = tdcs,
+        .shot_sched = shot_sched,
+        .shot_wave = &shot_wave,
+        .mode_ctrl = mode_ctrl,
+        .out_seg = out_seg,
+        .ring = ring,
+        .metrics = &metrics,
+        .pcloud = pcloud,
+        .hist = hist_out.hist,
+        .hist_seg = hist_seg,
+        .mirror = acq_cfg.use_mirror ? &mirror : NULL,
+        .sos = sos,
+        .acq_usec = acq_cfg.continuous ? 0 : LASER_ACQ_USEC,
+        .burst = burst,
+        .auto_mode = acq_cfg.auto_mode};
+
+    // settings reported at the top of every output segment
+    static const char *const trigger_names[] = {[ACQ_TRIG_ASYNC] = "async", [ACQ_TRIG_SYNC] = "sync", [ACQ_TRIG_DEBUG] = "debug"};
+    char config_desc[192];
+    int desc_len = snprintf(config_desc, sizeof(config_desc), "trigger=%s readout=%s mode=%s gate_m=%.2lf max_range_m=%.1lf tdcs=%d",
+                            trigger_names[acq_cfg.trigger], acq_cfg.autoinc ? "autoinc" : "single",
+                            acq_cfg.auto_mode ? "auto" : (meas_mode ? "2" : "1"), min_range_m, TDC_MAX_RANGE_M, TDC_COUNT);
+    if (hist_out.hist != NULL) // binning, so a laser-off histogram file can be checked before use as a reference
+    {
+        snprintf(config_desc + desc_len, sizeof(config_desc) - desc_len, " hist_bin_ns=%.4lf hist_bins=%u",
+                 hist_out.hist->bin_sec * 1e9, hist_out.hist->bins);
+    }
+    acq.config_desc = config_desc;
+    updateOutConfig(&acq);
+
+    /********* Processor Pool Configuration *********/
+    // decodes shots on the proc cores; started once acq is complete, since jobs read it
+    acq.pool = procPoolCreate(PROC_POOL_SLOTS, sizeof(struct ProcIn), sizeof(struct ProcOut), proc_workers,
+                              &decodeJob, &emitSample, &acq);
+    if (acq.pool == NULL || procPoolStart(acq.pool, &rt.roles[RT_ROLE_PROC].cpus) < 0)
+    {
+        perror("CRITICAL ERROR in procPoolCreate()");
+        return -1;
+    }
+    // pool threads start time-shared; raise them if the profile makes proc real-time
+    if (acq.pool->workers > 0) rtProfileApplyThread(&rt, RT_ROLE_PROC, acq.pool->emit_tid);
+    for (int i = 0; i < acq.pool->workers; i++)
+    {
+        rtProfileApplyThread(&rt, RT_ROLE_PROC, acq.pool->worker_tids[i]);
+    }
+    /************************************************/
+
+    /********* Control plane *********/
+    // commands from stdin and CTRL_SOCK_PATH, handled on a non-isolated core
+    pthread_t ctrl_tid = 0;
+    pthread_attr_t ctrl_attr;
+    acq.ctrl = ctrlCreate(CTRL_SOCK_PATH, 1e6 / LASER_ACQ_PERIOD_USEC, &printAcqStats, &acq);
+    if (acq.ctrl == NULL)
+    {
+        perror("CRITICAL ERROR in ctrlCreate()");
+        return -1;
+    }
+
+    pthread_attr_init(&ctrl_attr);
+    rtProfileSetAttr(&rt, RT_ROLE_CTRL, &ctrl_attr);
+
+    pthread_create(&ctrl_tid, &ctrl_attr, &ctrlMain, acq.ctrl); // start control thread
+    pthread_attr_destroy(&ctrl_attr);                           // destroy attr; no effect on already created threads
+    /*********************************/
+
+    printf("Commands: start (P), stop, rate <shots/s>, <rpm>, gate (G), shutter (S), enable (E),\n"
+           "          laser (L), stats, quit (q). Also accepted on %s\n", CTRL_SOCK_PATH);
+
+    /********* Dark-count reference *********/
+    // one laser-off window before anything else; the laser is still shuttered and disabled from initialisation
+    if (hist_out.hist != NULL && acq_cfg.hist_ref != NULL && strcmp(acq_cfg.hist_ref, "dark") == 0)
+    {
+        printf("Recording dark-count reference for %.1lf s...\n", HIST_DARK_SEC);
+        uint32_t acq_usec = acq.acq_usec;
+        acq.acq_usec = (uint32_t)(HIST_DARK_SEC * 1e6);
+        acq.dark = true;
+        acq_loops[acq_cfg.trigger][acq_cfg.autoinc][acq_cfg.auto_mode](&acq);
+        procPoolDrain(acq.pool); // every dark sample is in the ring before the flag is cleared
+        publishEnd(&acq);        // the reference is in use from here on
+        acq.dark = false;
+        acq.acq_usec = acq_usec;
+    }
+    /*****************************************/
+
+    bool start_now = acq_cfg.continuous; // continuous mode starts without waiting for a command
+    while (!acq.quit) // begin main loop; idle until a control command arrives
+    {
+        ctrl_cmd_t cmd;
+        if (start_now)
         {
-            c = *str_in; // if single char entered, save to variable and do NOT jump to next iteration
+            cmd.type = CTRL_CMD_START;
+            start_now = false;
         }
-        else
+        else if (!ctrlPoll(acq.ctrl, &cmd))
         {
-            continue; // if a word string is entered, ignore by jumping to next iteration
+            gpioDelay(CTRL_IDLE_USEC);
+            continue;
         }
 
-        /******** This point only reached if user enteres single character *********/
-
-        if (c == 'q' || c == 'Q')
-        {
-            #ifdef USE_MIRROR
-            mirrorSetRPM(mirror, 0);
-            #endif
-            
-            break;
-        }
-        else if (c == 'L') // emit a 50% duty signal for 30 s
+        if (cmd.type == CTRL_CMD_LASER) // emit a 50% duty signal for 30 s
         {
             gpioSetPWMfrequency(LASER_PULSE_PIN, (unsigned int)LASER_PULSE_FREQ_HZ);
             gpioPWM(LASER_PULSE_PIN, 255 / 2);
@@ -488,228 +1572,95 @@ int main()
 
             gpioPWM(LASER_PULSE_PIN, 0);
         }
-        else if (c == 'G') // toggle photon detector gate
-        {
-            gate_state = !gate_state;
-            gpioWrite(DETECTOR_GATE_PIN, gate_state);
-            continue;
-        }
-        else if (c == 'S') // toggle laser shutter
-        {
-            shutter_state = !shutter_state;
-            gpioWrite(LASER_SHUTTER_PIN, shutter_state);
-            continue;
-        }
-        else if (c == 'E') // toggle laser enable
-        {
-            enable_state = !enable_state;
-            gpioWrite(LASER_ENABLE_PIN, enable_state);
-            continue;
-        }
-        else if (c == 'P') // start measurement
+        else if (cmd.type == CTRL_CMD_START) // start measurement
         {
-            printf("Acquiring data...\n");
-            // mirrorSetRPM(mirror, 0); // disable mirror to repurpose pin
-            // gpioDelay(3); // short delay to allow mirror signal to stop
-            #ifndef USE_SYNC_ACQ
-            gpioSetPWMfrequency(LASER_PULSE_PIN, LASER_PULSE_FREQ_HZ); // config PWM frequency
-            gpioPWM(LASER_PULSE_PIN, 255 / 2);                         // start PWM @ 50% (255/2) duty
-            #endif
-
-            char hdr_strs[] =
-                "TIMESTAMP (s),DIST (m),TOF (usec),TIME1,CLOCK_COUNT1,TIME2,CAL1,CAL2\n";
-
-            loggerSendLogMsg(logger, hdr_strs, sizeof(hdr_strs), OUT_FILE, 0, true);
-
-            //start new measurement on TDC
-            static char meas_cmds[2] = {
-                0x40,                                             //Write to CONFIG1
-                TDC_CONFIG1_BITS(0, 1, 0, 0, 0, TDC_MEAS_MODE, 1) //Start measurement in mode 1 with parity and rising edge start, stop, trigger signals
-            };
-            char meas_cmds_rx[sizeof(meas_cmds)];
-
-            uint32_t acq_start_tick = gpioTick();                  // acquisition start tick
-            while ((gpioTick() - acq_start_tick) < LASER_ACQ_USEC) // main data acquisition loop
+            printf(acq.acq_usec ? "Acquiring data...\n" : "Acquiring data until stopped...\n");
+
+            outSegRestart(out_seg); // config record and header ahead of this window's rows
+            outSegRestart(hist_seg);
+
+            if (burst != NULL)
             {
-                // gpioDelay(10);
-                spiXfer(tdc.spi_handle, meas_cmds, meas_cmds_rx, sizeof(meas_cmds)); // prime TDC measurement
-                gpioDelay(1);                                                        // small delay to allow TDC to process data
+                burst_loops[acq_cfg.trigger][acq_cfg.autoinc](&acq);
 
-                uint32_t samp_start_tick = gpioTick();                                                  // TDC measurement start tick
-                uint32_t samp_end_tick = samp_start_tick + LASER_PULSE_COUNT * LASER_PULSE_PERIOD_USEC; // earliest time to start new TDC measurement
+                // decode on every core, then hand the samples to the sinks in shot order
+                printf("Decoding %u burst frames...\n", burst->count);
+                burstDecode(burst, &decodeBurstFrame, &acq, get_nprocs(), &all_cpu);
 
-                #ifdef USE_DEBUG
-                //DEBUGGING: wait a know period of time and send a stop pulse
-                gpioWrite(TDC_START_PIN, 1); // start TDC measurement
-                gpioDelay(TDC_DELAY_USEC);   // known delay
-                gpioWrite(TDC_STOP_PIN, 1);  // stop TDC measurement
+                procPoolDrain(acq.pool); // the pool's reassembly thread is done with the ring
+                publishBurst(&acq);
+            }
+            else
+            {
+                acq_loops[acq_cfg.trigger][acq_cfg.autoinc][acq_cfg.auto_mode](&acq);
+                procPoolDrain(acq.pool); // the pool's reassembly thread is done with the ring
+            }
+            publishEnd(&acq);
 
-                gpioWrite(TDC_STOP_PIN, 0);  // reset pins to known state
-                gpioWrite(TDC_START_PIN, 0); // reset pins to known state
-                #else // #else connected with #ifdef USE_DEBUG
-                #ifdef USE_SYNC_ACQ
-                // send train of pulses to trigger single pulse from laser driver
-                for (int i = 0; i < LASER_PULSE_COUNT; i++)
-                {
-                    if (i == 1) // Start TDC on second loop iteration
-                    {
-                        //gpioWrite_Bits_0_31_Set((LASER_PULSE_POL << LASER_PULSE_PIN) | (1 << TDC_START_PIN));
-                        gpioWrite(LASER_PULSE_PIN, LASER_PULSE_POL);
-                        gpioDelay(25);
-                        gpioWrite(TDC_START_PIN, 1);
-                    }
-                    else
-                    {
-                        gpioWrite(LASER_PULSE_PIN, LASER_PULSE_POL);
-                    }
-                    gpioDelay(LASER_PULSE_PERIOD_USEC / 2);
-                    gpioWrite(LASER_PULSE_PIN, !LASER_PULSE_POL);
-                    gpioDelay(LASER_PULSE_PERIOD_USEC / 2);
-                }
-
-                gpioWrite(TDC_START_PIN, 0); // reset TDC start pin state
-                #else // #else connected with #ifdef USE_SYNC_ACQ
-                gpioWrite(TDC_START_PIN, 1);
-                #endif // #endif connected with #ifdef USE_SYNC_ACQ
-                #endif // #endif connected with #ifdef USE_DEBUG
-
-                //Poll TDC INT pin to signal available data
-                uint32_t curr_tick = gpioTick();
-                while (gpioRead(tdc.int_pin) && (gpioTick() - curr_tick) < tdc.timeout_us);
-
-                if (!gpioRead(tdc.int_pin)) //if TDC returned in time
-                {
-                    #ifdef USE_AUTOINC_METHOD
-                    /******** Transaction 1 *********/
-                    /**Transaction 1 starts an auto-incrementing read at register TIME1,
-                    * reading 9 bytes to obtain the 3-byte long TIME1, CLOCK_COUNT1, 
-                    * and TIME2 registers.
-                    */
-
-                    /**array to holds return bytes from both SPI transactions retrieving Measurement registers
-                    * TIME1, CLOCK_COUNT1, TIME2, CALIBRATION1, CALIBRATION2 in that order.
-                    * These registers are 24-bits long where the MSb is a parity bit.
-                    * Hence rx_buff holds 5 3-byte data chars and 2 1-byte command chars (17 bytes total)
-                    * rx_buff[0] = 0 (junk data from Transaction 1 command byte)
-                    * rx_buff[1-3] = TIME1 bytes in big-endian order
-                    * rx_buff[4-6] = CLOCK_COUNT1 bytes in big-endian order
-                    * rx_buff[7-9] = TIME2 bytes in big-endian order
-                    * rx_buff[10] = 0 (junk data from Transaction 2 command byte)
-                    * rx_buff[11-13] = CALIBRATION1 in big-endian order
-                    * rx_buff[14-16] = CALIBRATION2 in big-endian order
-                    */
-                    char *rx_buff = (char *)calloc(17, sizeof(char));
-
-                    char tx_buff1[10] = {0x90}; // start an auto incrementing read to read TIME1, CLOCK_COUNT1, TIME2 in a single command
-                    spiXfer(tdc.spi_handle, tx_buff1, rx_buff, sizeof(tx_buff1));
-
-                    //print returned data
-                    // printf("rx_buff after transaction 1=");
-                    // printArray(rx_buff, 17);
-                    // printf("\n");
-                    /*********************************/
-
-                    /********* Transaction 2 *********/
-                    /**Transaciton 2 starts an auto-incrementing read at register CALIBRATION1
-                    * and reads the 24-bit CALIBRATION1 and CALIBRATION2 registers. Hence, 
-                    * the transaction sends 7 bytes (1 command, 6 reading bytes). The first
-                    * byte of the return buffer will always be 0
-                    */
-                    char tx_buff2[7] = {TDC_CMD(1, 0, TDC_CALIBRATION1)}; //auto incrementing read of CALIBRATION1 and CALIBRATION2
-                    spiXfer(tdc.spi_handle, tx_buff2, rx_buff + sizeof(tx_buff1), sizeof(tx_buff2));
-
-                    // printf("rx_buff after txaction 2=");
-                    // printArray(rx_buff, 17);
-                    // printf("\n");
-                    /*********************************/
-                    #else
-                    static char tof_cmds[5] = {
-                        // TDC commands for retrieving TOF
-                        0x10, //Read TIME1
-                        0x11, //Read CLOCK_COUNT1
-                        0x12, //Read TIME2
-                        0x1B, //Read CALIBRATION
-                        0x1C  //Read CALIBRATION2
-                    };
-
-                    // Data registers of TDC are 23-bits wide.
-                    // Allocate 32-bits for each register to read
-                    char *rx_buff = (char *)calloc(sizeof(tof_cmds) * 4, sizeof(char));
-
-                    for (int i = 0; i < sizeof(tof_cmds); i++)
-                    {
-                        char tx_temp[4] = {tof_cmds[i]};
-
-                        spiXfer(tdc.spi_handle, tx_temp, rx_buff + i * 4, sizeof(tx_temp));
-                        // printf("Command %02X return=", tof_cmds[i]);
-                        // printArray(rx_buff1 + i * 4, 4);
-                        // printf("\n");
-                    }
-                    #endif
-
-                    // allocate argument struct for data processor. Free inside data processor function
-                    struct DataProcArg *data = (struct DataProcArg *)malloc(sizeof(struct DataProcArg));
-                    data->data_break = false;
-                    data->logger = logger;
-                    data->raw_tdc_data = rx_buff;
-                    data->raw_tdc_size = sizeof(rx_buff);
-                    data->tcp_handler = tcp_handler;
-                    data->tdc = &tdc;
-
-                    // printf("queuing dataproc\n");
-                    dataprocSendData(data_proc, &dataprocFunc, (void *)data, 0, true);
-                    // printf("queued dataproc\n");
-                }    // end if (!gpioRead(tdc.int_pin)), i.e. no timeout waiting for TDC
-                else //else timeout occured
-                {
-                    // If timeout, construct dummy data structure with raw_tdc_data == NULL
-                    // If raw_tdc_data == NULL, the function dataprocFunc() will write dummy data to data file
-                    struct DataProcArg *dummy_data = (struct DataProcArg *)malloc(sizeof(struct DataProcArg));
-                    dummy_data->data_break = false;
-                    dummy_data->logger = logger;
-                    dummy_data->raw_tdc_data = NULL;
-                    dummy_data->raw_tdc_size = 0;
-                    dummy_data->tcp_handler = tcp_handler;
-                    dummy_data->tdc = &tdc;
-
-                    dataprocSendData(data_proc, &dataprocFunc, (void *)dummy_data, 0, true);
-                } // end else linked to if (!gpioRead(tdc.int_pin))
-
-                // wait until appropriate sample delay has elapsed
-                curr_tick = gpioTick();
-                if (curr_tick < samp_end_tick)
-                {
-                    gpioDelay(samp_end_tick - curr_tick);
-                }
-            } // end main data acquisitio loop; while((gpioTick() - acq_start_tick) < ...)
-
-            #ifndef USE_SYNC_ACQ
-            gpioPWM(LASER_PULSE_PIN, 0); // stop laser pulse train
-            #endif
             printf("done Acq\n");
-        } // end else if (c == 'P')
+            printAcqStats(stdout, &acq);
+        }
         else
-            continue; // do nothing if unsupported input
-    }                 // end while(1); main loop
+        {
+            handleCtrlCmd(&acq, &cmd);
+        }
+    } // end while(!acq.quit); main loop
+
+    if (acq.mirror != NULL)
+    {
+        mirrorSetRPM(mirror, 0);
+    }
+
+    ctrlStop(acq.ctrl);
+    pthread_join(ctrl_tid, NULL);
+    ctrlDestroy(acq.ctrl);
+
+    // drain in order: processor pool, then the sinks it feeds, then the sinks' consumers
+    procPoolStop(acq.pool);
+    bcastStop(ring);
+    pcloudDestroy(pcloud); // writes the last points while the point-cloud TCP handler is still up
+    if (hist_out.hist != NULL)
+    {
+        tofHistFlush(hist_out.hist); // normally empty; each acquisition closes its last window with its marker
+    }
+    if (hist_out.tcp_dropped > 0)
+    {
+        printf("%llu return rows not sent to slow TCP clients\n", (unsigned long long)hist_out.tcp_dropped);
+    }
 
     tcpHandlerClose(tcp_handler, 0, true);
+    tcpHandlerClose(pcloud_tcp, 0, true);
     loggerSendCloseMsg(logger, 0, true);
-    dataprocSendStop(data_proc, 0, true);
-    pinPollerExit(poller);
+    sosStop(sos);
     mldClose(mld);
 
-    tdcClose(&tdc);
+    shotWaveDelete(&shot_wave);
+    for (uint8_t i = 0; i < TDC_COUNT; i++)
+    {
+        tdcClose(&tdcs[i]);
+    }
     gpioWrite(LASER_SHUTTER_PIN, 0);
     gpioWrite(LASER_ENABLE_PIN, 0);
+    fastGpioClose();
 
     pthread_join(tcp_tid, NULL);
+    pthread_join(pcloud_tcp_tid, NULL);
     pthread_join(logger_tid, NULL);
-    pthread_join(data_proc_tid, NULL);
-    pthread_join(poller_tid, NULL);
 
     loggerDestroy(logger);
     tcpHandlerDestroy(tcp_handler);
-    dataprocDestroy(data_proc);
+    tcpHandlerDestroy(pcloud_tcp);
+    procPoolDestroy(acq.pool);
+    shotSchedDestroy(shot_sched);
+    modeCtrlDestroy(mode_ctrl);
+    sosDestroy(sos);
+    outSegDestroy(out_seg);
+    outSegDestroy(hist_seg);
+    tofHistDestroy(hist_out.hist);
+    free(hist_out.row);
+    burstDestroy(burst);
+    sampleShmDestroy(shm); // after the shm sink has stopped publishing
+    bcastDestroy(ring);
 
     gpioTerminate();
 } // end main()
\ No newline at end of file
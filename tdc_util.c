@@ -1,6 +1,18 @@
 
 #include "tdc_util.h"
 
+// power-on contents of CONFIG1 through CLOCK_CNTR_STOP_MASK_L (TDC7200 datasheet)
+static const uint8_t tdc_reset_regs[TDC_NUM_CONFIG_REGS] = {
+    0x00, 0x40, 0x00, 0x07, 0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0x00};
+
+const uint8_t tdc_readout_idx[TDC_MEAS_NUM_REGS] = {
+    1,  // TIME1 data start index
+    4,  // CLOCK_COUNT1 data start index
+    7,  // TIME2 data start index
+    11, // CALIBRATION1 data start index
+    14  // CALIBRATION2 data start index
+};
+
 void printArray(char* arr, int arr_size)
 {
     for (int i = 0; i < arr_size; i++)
@@ -52,6 +64,20 @@ double calcToF(uint32_t* tdc_data, uint8_t cal_periods, uint32_t clk_freq)
     }
 }
 
+/**Mode 1: ToF = TIME1 * normLSB, where normLSB = clock period / calCount
+ */
+double calcToFMode1(uint32_t* tdc_data, uint8_t cal_periods, uint32_t clk_freq)
+{
+    double time1 = tdc_data[0];
+    double calibration1 = tdc_data[3];
+    double calibration2 = tdc_data[4];
+
+    double calCount = fabs(calibration2 - calibration1) / (double)(cal_periods - 1);
+    if (calCount == 0)
+        return 0; // catch divide-by-zero error
+    return time1 / calCount / clk_freq;
+} // end calcToFMode1()
+
 inline double calcDist(double ToF)
 {
     return ToF*LIGHT_SPEED/2;
@@ -94,21 +120,57 @@ int tdcInit(tdc_t* tdc, int baud)
         tdc->spi_handle = -1;
         return status;
     }
+
+    tdc->spi_baud = baud;
+    if (tdc->spi_baud_floor == 0) tdc->spi_baud_floor = baud;
+
+    // start from the power-on defaults; shadows are unknown until tdcEnable()
+    memcpy(tdc->config, tdc_reset_regs, sizeof(tdc->config));
+    tdc->shadow_valid = 0;
         
-    /******** Pigpio SPI init ********/
-    tdc->spi_handle = spiOpen(0, baud, 0
-            /* 0b00 |          // Positive (MSb 0) clock edge centered (LSb 0) on data bit
-            (0b000 << 2) |  // all 3 CE pins are active low
-            (0b000 << 5) |  // all 3 CE pins reserved for SPI
-            (0 << 8) |      // 0 = Main SPI; 1 = Aux SPI 
-            (0 << 9) |      // If 1, 3-wire mode
-            ((0 & 0xF) << 10) | // bytes to write before switching to read (N/A if not in 3-wire mode)
-            (0 << 14) |         // If 1, tx LSb first (Aux SPI only)
-            (0 << 15) |         // If 1, recv LSb first (Aux SPI only)
-            ((8 & 0x3F) << 16)  // bits per word; 0 defaults to 8 */
-
-    );
-    /******************************/
+    if (tdc->spi_backend == TDC_SPI_SPIDEV)
+    {
+        /******** spidev SPI init ********/
+        // main SPI is bus 0, aux SPI (spi_flags bit 8) is bus 1
+        char dev_path[24];
+        sprintf(dev_path, "/dev/spidev%d.%d", (tdc->spi_flags >> 8) & 1, tdc->spi_channel);
+        tdc->spi_handle = open(dev_path, O_RDWR);
+        if (tdc->spi_handle < 0) return tdc->spi_handle;
+
+        uint8_t mode = tdc->spi_flags & 0x3; // same mode bits as pigpio flags
+        uint8_t bits = 8;
+        uint32_t speed = baud;
+        ioctl(tdc->spi_handle, SPI_IOC_WR_MODE, &mode);
+        ioctl(tdc->spi_handle, SPI_IOC_WR_BITS_PER_WORD, &bits);
+        ioctl(tdc->spi_handle, SPI_IOC_WR_MAX_SPEED_HZ, &speed);
+
+        // preset transfer descriptors so each transaction only needs lengths and buffer offsets
+        memset(tdc->spi_xfers, 0, sizeof(tdc->spi_xfers));
+        for (int i = 0; i < TDC_SPI_MAX_XFERS; i++)
+        {
+            tdc->spi_xfers[i].speed_hz = baud;
+            tdc->spi_xfers[i].bits_per_word = 8;
+            tdc->spi_xfers[i].delay_usecs = 0;
+        }
+        /*********************************/
+    }
+    else
+    {
+        /******** Pigpio SPI init ********/
+        tdc->spi_handle = spiOpen(tdc->spi_channel, baud, tdc->spi_flags
+                /* 0b00 |          // Positive (MSb 0) clock edge centered (LSb 0) on data bit
+                (0b000 << 2) |  // all 3 CE pins are active low
+                (0b000 << 5) |  // all 3 CE pins reserved for SPI
+                (0 << 8) |      // 0 = Main SPI; 1 = Aux SPI 
+                (0 << 9) |      // If 1, 3-wire mode
+                ((0 & 0xF) << 10) | // bytes to write before switching to read (N/A if not in 3-wire mode)
+                (0 << 14) |         // If 1, tx LSb first (Aux SPI only)
+                (0 << 15) |         // If 1, recv LSb first (Aux SPI only)
+                ((8 & 0x3F) << 16)  // bits per word; 0 defaults to 8 */
+
+        );
+        /******************************/
+    }
     
     // checking for non-zero, in-range reference clock frequency
     if (tdc->clk_freq == 0 || tdc->clk_freq < 1000000 || 16000000 < tdc->clk_freq)
@@ -125,8 +187,514 @@ int tdcInit(tdc_t* tdc, int baud)
  */
 void tdcClose(tdc_t* tdc)
 {
-    spiClose(tdc->spi_handle);
+    if (tdc->spi_backend == TDC_SPI_SPIDEV)
+    {
+        close(tdc->spi_handle);
+    }
+    else
+    {
+        spiClose(tdc->spi_handle);
+    }
     gpioHardwareClock(tdc->clk_pin,0);
     gpioWrite(tdc->enable_pin,0); // place TDC in low power state
 } // end tdcClose()
 
+
+int tdcSpiXfer(tdc_t* tdc, char* tx, char* rx, unsigned count)
+{
+    return tdcSpiXferBatch(tdc, tx, rx, &count, 1);
+} // end tdcSpiXfer()
+
+/**Function: tdcSpiXferBatch
+ * Description: For pigpio, issues one spiXfer per transaction. For spidev, copies tx into
+ *              the TDC's persistent buffer, points the preset descriptors at consecutive
+ *              slices of it and sends them all in one SPI_IOC_MESSAGE ioctl. No memory is
+ *              allocated per call.
+ */
+int tdcSpiXferBatch(tdc_t* tdc, char* tx, char* rx, const unsigned* lens, unsigned n)
+{
+    unsigned total = 0;
+    for (unsigned i = 0; i < n; i++) total += lens[i];
+
+    if (tdc->spi_backend != TDC_SPI_SPIDEV)
+    {
+        unsigned offset = 0;
+        for (unsigned i = 0; i < n; i++)
+        {
+            int status = spiXfer(tdc->spi_handle, tx + offset, rx + offset, lens[i]);
+            if (status < 0) return status;
+            offset += lens[i];
+        }
+        return total;
+    }
+
+    if (n > TDC_SPI_MAX_XFERS || total > TDC_SPI_BUFF_SIZE) return -1;
+
+    memcpy(tdc->spi_tx, tx, total);
+    unsigned offset = 0;
+    for (unsigned i = 0; i < n; i++)
+    {
+        tdc->spi_xfers[i].tx_buf = (unsigned long)(tdc->spi_tx + offset);
+        tdc->spi_xfers[i].rx_buf = (unsigned long)(tdc->spi_rx + offset);
+        tdc->spi_xfers[i].len = lens[i];
+        tdc->spi_xfers[i].cs_change = (i + 1 < n); // deselect between transactions, not after the last
+        offset += lens[i];
+    }
+
+    int status = ioctl(tdc->spi_handle, SPI_IOC_MESSAGE(n), tdc->spi_xfers);
+    if (status < 0) return status;
+
+    memcpy(rx, tdc->spi_rx, total);
+    return total;
+} // end tdcSpiXferBatch()
+
+int tdcSetBaud(tdc_t* tdc, uint32_t baud)
+{
+    if (tdc->spi_backend == TDC_SPI_SPIDEV)
+    {
+        for (int i = 0; i < TDC_SPI_MAX_XFERS; i++)
+        {
+            tdc->spi_xfers[i].speed_hz = baud;
+        }
+        int status = ioctl(tdc->spi_handle, SPI_IOC_WR_MAX_SPEED_HZ, &baud);
+        if (status < 0) return status;
+    }
+    else
+    {
+        // pigpio fixes the clock when the channel is opened
+        spiClose(tdc->spi_handle);
+        tdc->spi_handle = spiOpen(tdc->spi_channel, baud, tdc->spi_flags);
+        if (tdc->spi_handle < 0) return tdc->spi_handle;
+    }
+
+    tdc->spi_baud = baud;
+    return 0;
+} // end tdcSetBaud()
+
+/**Function: tdcVerifySpi
+ * Description: CONFIG2 through CLOCK_CNTR_OVF_L (0x01-0x07) are consecutive, so each trial
+ *              is one auto-increment write and one auto-increment read. INT_STATUS (0x02)
+ *              lies in the range; it is written with 0, which leaves its flags untouched,
+ *              and is excluded from the comparison. INT_MASK only implements bits 0-2.
+ */
+bool tdcVerifySpi(tdc_t* tdc, int trials)
+{
+    static const uint8_t reg_masks[7] = {0xFF, 0x00, 0x07, 0xFF, 0xFF, 0xFF, 0xFF};
+    char tx[8];
+    char rx[8];
+    char saved[8];
+    bool pass = true;
+
+    // save current contents
+    memset(tx, 0, sizeof(tx));
+    tx[0] = TDC_CMD(1, 0, TDC_CONFIG2);
+    if (tdcSpiXfer(tdc, tx, saved, sizeof(tx)) < 0) return false;
+
+    for (int t = 0; t < trials && pass; t++)
+    {
+        // alternate bit patterns, shifted each trial so every bit toggles
+        tx[0] = TDC_CMD(1, 1, TDC_CONFIG2);
+        for (int i = 1; i < 8; i++)
+        {
+            tx[i] = ((t & 1) ? 0xA5 : 0x5A) ^ (uint8_t)(t * 7 + i);
+        }
+        tx[TDC_INT_STATUS] = 0;
+        if (tdcSpiXfer(tdc, tx, rx, sizeof(tx)) < 0) return false;
+
+        char rd_tx[8] = {TDC_CMD(1, 0, TDC_CONFIG2)};
+        if (tdcSpiXfer(tdc, rd_tx, rx, sizeof(rd_tx)) < 0) return false;
+
+        for (int i = 1; i < 8; i++)
+        {
+            if ((rx[i] ^ tx[i]) & reg_masks[i - 1]) pass = false;
+        }
+
+        // measurement registers must always carry correct parity
+        char meas_tx[17] = {[0] = TDC_CMD(1, 0, TDC_TIME1), [10] = TDC_CMD(1, 0, TDC_CALIBRATION1)};
+        char meas_rx[17];
+        const unsigned lens[2] = {10, 7};
+        if (tdcSpiXferBatch(tdc, meas_tx, meas_rx, lens, 2) < 0) return false;
+        for (int i = 0; i < TDC_MEAS_NUM_REGS; i++)
+        {
+            if (checkOddParity(convertSubsetToLong(meas_rx + tdc_readout_idx[i], 3, true))) pass = false;
+        }
+    }
+
+    // restore original contents
+    saved[0] = TDC_CMD(1, 1, TDC_CONFIG2);
+    saved[TDC_INT_STATUS] = 0;
+    tdcSpiXfer(tdc, saved, rx, sizeof(saved));
+
+    return pass;
+} // end tdcVerifySpi()
+
+uint32_t tdcAutotuneBaud(tdc_t* tdc, uint32_t max_baud, int trials, double margin)
+{
+    uint32_t start_baud = tdc->spi_baud;
+    uint32_t best_div = TDC_SPI_CORE_CLK / start_baud;
+    if (max_baud > TDC_SPI_MAX_BAUD) max_baud = TDC_SPI_MAX_BAUD;
+
+    tdc->spi_baud_floor = start_baud;
+
+    // step the divider down (clock up) until a step fails verification
+    for (uint32_t div = best_div - TDC_SPI_DIV_STEP; div >= 2 && TDC_SPI_CORE_CLK / div <= max_baud; div -= TDC_SPI_DIV_STEP)
+    {
+        if (tdcSetBaud(tdc, TDC_SPI_CORE_CLK / div) < 0 || !tdcVerifySpi(tdc, trials)) break;
+        best_div = div;
+        if (div <= TDC_SPI_DIV_STEP) break;
+    }
+
+    // apply safety margin, snapping to the next slower divider step
+    uint32_t margin_div = (uint32_t)ceil(best_div / (1.0 - margin));
+    margin_div = ((margin_div + TDC_SPI_DIV_STEP - 1) / TDC_SPI_DIV_STEP) * TDC_SPI_DIV_STEP;
+    uint32_t baud = TDC_SPI_CORE_CLK / margin_div;
+    if (baud < start_baud) baud = start_baud;
+
+    tdcSetBaud(tdc, baud);
+    printf("TDC %u: SPI clock autotuned to %u Hz (fastest verified %u Hz, margin %.0f%%)\n",
+           tdc->id, baud, TDC_SPI_CORE_CLK / best_div, margin * 100);
+    return baud;
+} // end tdcAutotuneBaud()
+
+bool tdcParityFallback(tdc_t* tdc, uint32_t max_errors)
+{
+    uint32_t errors = tdc->parity_errors;
+    uint32_t new_errors = errors - tdc->parity_errors_seen;
+    tdc->parity_errors_seen = errors;
+
+    if (new_errors <= max_errors || tdc->spi_baud <= tdc->spi_baud_floor) return false;
+
+    uint32_t div = TDC_SPI_CORE_CLK / tdc->spi_baud + TDC_SPI_DIV_STEP;
+    uint32_t baud = TDC_SPI_CORE_CLK / div;
+    if (baud < tdc->spi_baud_floor) baud = tdc->spi_baud_floor;
+
+    printf("TDC %u: %u parity errors; SPI clock lowered from %u to %u Hz\n",
+           tdc->id, new_errors, tdc->spi_baud, baud);
+    tdcSetBaud(tdc, baud);
+    return true;
+} // end tdcParityFallback()
+
+/**Function: tdcValidateReadout
+ * Description: A failing register is read on its own with a non-incrementing 4-byte
+ *              transaction (command byte + 3 data bytes). The TDC holds its results until
+ *              the next measurement is started, so re-reads return the same measurement.
+ */
+bool tdcValidateReadout(tdc_t* tdc, char* rx, const uint8_t* data_idx, int retries)
+{
+    static const uint8_t reg_addrs[TDC_MEAS_NUM_REGS] = {
+        TDC_TIME1, TDC_CLOCK_COUNT1, TDC_TIME2, TDC_CALIBRATION1, TDC_CALIBRATION2};
+    bool valid = true;
+
+    for (int i = 0; i < TDC_MEAS_NUM_REGS; i++)
+    {
+        if (!checkOddParity(convertSubsetToLong(rx + data_idx[i], 3, true))) continue;
+
+        tdc->parity_errors++;
+        tdc->reg_parity_errors[i]++;
+
+        bool reg_valid = false;
+        for (int r = 0; r < retries && !reg_valid; r++)
+        {
+            char tx[4] = {TDC_CMD(0, 0, reg_addrs[i])};
+            char reread[4];
+            if (tdcSpiXfer(tdc, tx, reread, sizeof(tx)) < 0) continue;
+
+            if (!checkOddParity(convertSubsetToLong(reread + 1, 3, true)))
+            {
+                memcpy(rx + data_idx[i], reread + 1, 3);
+                reg_valid = true;
+            }
+        }
+        valid &= reg_valid;
+    }
+
+    if (!valid) tdc->bad_frames++;
+    return valid;
+} // end tdcValidateReadout()
+
+void tdcPrintParityStats(tdc_t* tdc, FILE* stream)
+{
+    fprintf(stream, "TDC %u parity errors: TIME1=%u CLOCK_COUNT1=%u TIME2=%u CAL1=%u CAL2=%u bad_frames=%u\n",
+            tdc->id,
+            tdc->reg_parity_errors[TDC_MEAS_TIME1],
+            tdc->reg_parity_errors[TDC_MEAS_CLOCK_COUNT1],
+            tdc->reg_parity_errors[TDC_MEAS_TIME2],
+            tdc->reg_parity_errors[TDC_MEAS_CAL1],
+            tdc->reg_parity_errors[TDC_MEAS_CAL2],
+            tdc->bad_frames);
+} // end tdcPrintParityStats()
+
+/**Function: tdcSetMaxRange
+ * Description: Mode 2 ends on CLOCK_CNTR_OVF reference clock periods; the coarse counter is
+ *              left at its maximum. Mode 1 ends on COARSE_CNTR_OVF coarse counts, each
+ *              63 ring oscillator periods (nominal TDC_NOMINAL_LSB_SEC); the clock counter is
+ *              left at its maximum. One count of margin is added and values are clamped to
+ *              16 bits.
+ */
+int tdcSetMaxRange(tdc_t* tdc, double max_range_m)
+{
+    double max_tof = 2 * max_range_m / LIGHT_SPEED;
+    uint32_t coarse_ovf = TDC_OVF_MAX;
+    uint32_t clock_ovf = TDC_OVF_MAX;
+
+    if (tdc->meas_mode)
+    {
+        clock_ovf = (uint32_t)ceil(max_tof * tdc->clk_freq) + 1;
+    }
+    else
+    {
+        coarse_ovf = (uint32_t)ceil(max_tof / (63 * TDC_NOMINAL_LSB_SEC)) + 1;
+    }
+    if (coarse_ovf > TDC_OVF_MAX) coarse_ovf = TDC_OVF_MAX;
+    if (clock_ovf > TDC_OVF_MAX) clock_ovf = TDC_OVF_MAX;
+    tdc->max_range_m = max_range_m;
+
+    tdcSetReg(tdc, TDC_COARSE_CNTR_OVF_H, coarse_ovf >> 8);
+    tdcSetReg(tdc, TDC_COARSE_CNTR_OVF_L, coarse_ovf & 0xFF);
+    tdcSetReg(tdc, TDC_CLOCK_CNTR_OVF_H, clock_ovf >> 8);
+    tdcSetReg(tdc, TDC_CLOCK_CNTR_OVF_L, clock_ovf & 0xFF);
+    return 0;
+} // end tdcSetMaxRange()
+
+int tdcSetMinRange(tdc_t* tdc, double min_range_m)
+{
+    uint32_t mask = 0;
+    if (tdc->meas_mode)
+    {
+        mask = (uint32_t)floor(2 * min_range_m / LIGHT_SPEED * tdc->clk_freq);
+        if (mask > TDC_OVF_MAX) mask = TDC_OVF_MAX;
+    }
+
+    tdcSetReg(tdc, TDC_CLOCK_CNTR_STOP_MASK_H, mask >> 8);
+    tdcSetReg(tdc, TDC_CLOCK_CNTR_STOP_MASK_L, mask & 0xFF);
+
+    tdc->min_range_m = min_range_m;
+    return (tdc->meas_mode || min_range_m <= 0) ? 0 : -1;
+} // end tdcSetMinRange()
+
+int tdcSetMeasMode(tdc_t* tdc, uint8_t mode)
+{
+    uint8_t config1 = tdc->config[TDC_CONFIG1] & ~TDC_CONFIG1_MODE_MASK;
+    tdcSetReg(tdc, TDC_CONFIG1, config1 | ((mode << 1) & TDC_CONFIG1_MODE_MASK));
+
+    // overflow units and the stop mask depend on the mode
+    tdcSetMaxRange(tdc, tdc->max_range_m);
+    return tdcSetMinRange(tdc, tdc->min_range_m) < 0 ? 1 : 0;
+} // end tdcSetMeasMode()
+
+/******** Driver: configuration, arming and readout ********/
+void tdcEnable(tdc_t* tdc)
+{
+    gpioWrite(tdc->enable_pin, 0);
+    gpioDelay(3); // Short delay to make sure TDC sees LOW before rising edge
+    gpioWrite(tdc->enable_pin, 1);
+
+    memcpy(tdc->shadow, tdc_reset_regs, sizeof(tdc->shadow));
+    tdc->shadow_valid = (1u << TDC_NUM_CONFIG_REGS) - 1;
+} // end tdcEnable()
+
+int tdcSetReg(tdc_t* tdc, enum TDC_REG_ADDR addr, uint8_t value)
+{
+    if (addr >= TDC_NUM_CONFIG_REGS) return -1;
+    if (addr == TDC_CONFIG1)
+    {
+        value &= ~TDC_CONFIG1_START_MEAS;
+        tdc->meas_mode = (value & TDC_CONFIG1_MODE_MASK) >> 1;
+    }
+    tdc->config[addr] = value;
+    return 0;
+} // end tdcSetReg()
+
+// Builds the burst writing all pending config registers into tx; returns its length or 0 if none
+static unsigned tdcBuildConfigBurst(tdc_t* tdc, char* tx)
+{
+    int first = -1;
+    int last = -1;
+    for (int addr = 0; addr < TDC_NUM_CONFIG_REGS; addr++)
+    {
+        if (addr == TDC_INT_STATUS) continue; // status flags, not configuration
+        bool valid = tdc->shadow_valid & (1u << addr);
+        if (valid && tdc->config[addr] == tdc->shadow[addr]) continue;
+        if (first < 0) first = addr;
+        last = addr;
+    }
+    if (first < 0) return 0;
+
+    // registers between first and last that are not pending hold config == shadow
+    tx[0] = TDC_CMD(1, 1, first);
+    for (int addr = first; addr <= last; addr++)
+    {
+        tx[1 + addr - first] = (addr == TDC_INT_STATUS) ? 0 : tdc->config[addr];
+    }
+    return 2 + last - first;
+} // end tdcBuildConfigBurst()
+
+// Marks the registers written by a burst built by tdcBuildConfigBurst() as matching the TDC
+static void tdcCommitConfigBurst(tdc_t* tdc, const char* tx, unsigned len)
+{
+    int first = tx[0] & 0x3F;
+    for (int addr = first; addr < first + (int)len - 1; addr++)
+    {
+        if (addr == TDC_INT_STATUS) continue;
+        tdc->shadow[addr] = tdc->config[addr];
+        tdc->shadow_valid |= 1u << addr;
+    }
+} // end tdcCommitConfigBurst()
+
+int tdcConfigure(tdc_t* tdc)
+{
+    char tx[TDC_NUM_CONFIG_REGS + 1];
+    char rx[sizeof(tx)];
+    unsigned len = tdcBuildConfigBurst(tdc, tx);
+    if (len == 0) return 0;
+
+    int status = tdcSpiXfer(tdc, tx, rx, len);
+    if (status < 0) return status;
+
+    tdcCommitConfigBurst(tdc, tx, len);
+    return 1;
+} // end tdcConfigure()
+
+/**Function: tdcArm
+ * Description: The START_MEAS write is a separate transaction after the config burst so the
+ *              measurement never starts before the remaining registers are updated.
+ *              In the common case nothing is pending and only the 2 byte write is sent.
+ */
+int tdcArm(tdc_t* tdc)
+{
+    char tx[TDC_NUM_CONFIG_REGS + 3];
+    char rx[sizeof(tx)];
+    unsigned lens[2];
+    unsigned n = 0;
+
+    unsigned burst_len = tdcBuildConfigBurst(tdc, tx);
+    if (burst_len) lens[n++] = burst_len;
+
+    tx[burst_len] = TDC_CMD(0, 1, TDC_CONFIG1);
+    tx[burst_len + 1] = tdc->config[TDC_CONFIG1] | TDC_CONFIG1_START_MEAS;
+    lens[n++] = 2;
+
+    int status = tdcSpiXferBatch(tdc, tx, rx, lens, n);
+    if (status < 0) return status;
+
+    if (burst_len) tdcCommitConfigBurst(tdc, tx, burst_len);
+    return 0;
+} // end tdcArm()
+
+enum TDC_MEAS_STATUS tdcWaitResult(tdc_t* tdc)
+{
+    //Poll TDC INT pin to signal available data
+    uint32_t curr_tick = gpioTick();
+    if (fast_gpio_regs)
+    {
+        while (fastGpioRead(tdc->int_pin) && (gpioTick() - curr_tick) < tdc->timeout_us);
+    }
+    else
+    {
+        while (gpioRead(tdc->int_pin) && (gpioTick() - curr_tick) < tdc->timeout_us);
+    }
+
+    // INT goes LO on a valid stop and also when the overflow registers end a no-return shot
+    if (fast_gpio_regs ? fastGpioRead(tdc->int_pin) : gpioRead(tdc->int_pin))
+    {
+        tdc->timeouts++;
+        return TDC_MEAS_TIMEOUT;
+    }
+    return tdcReadStatus(tdc);
+} // end tdcWaitResult()
+
+enum TDC_MEAS_STATUS tdcReadStatus(tdc_t* tdc)
+{
+    char tx[2] = {TDC_CMD(0, 0, TDC_INT_STATUS)};
+    char rx[2];
+    if (tdcSpiXfer(tdc, tx, rx, sizeof(tx)) < 0) return TDC_MEAS_ERROR;
+
+    if (rx[1] & (TDC_INT_COARSE_OVF | TDC_INT_CLOCK_OVF))
+    {
+        tdc->overflows++;
+        return TDC_MEAS_OVERFLOW;
+    }
+    if (!(rx[1] & TDC_INT_NEW_MEAS)) // e.g. a glitch on INT; the result registers are stale or 0
+    {
+        tdc->incomplete++;
+        return TDC_MEAS_INCOMPLETE;
+    }
+    tdc->valid_meas++;
+    return TDC_MEAS_VALID;
+} // end tdcReadStatus()
+
+/**Function: tdcReadResult
+ * Description: Buffer layout (17 bytes):
+ *              rx[0] = junk byte clocked in with the TIME1 read command
+ *              rx[1-9] = TIME1, CLOCK_COUNT1, TIME2, 3 big-endian bytes each
+ *              rx[10] = junk byte clocked in with the CALIBRATION1 read command
+ *              rx[11-16] = CALIBRATION1, CALIBRATION2, 3 big-endian bytes each
+ *              The single register reads are copied into the same layout.
+ */
+bool tdcReadResult(tdc_t* tdc, char* rx, bool autoinc, int retries)
+{
+    if (autoinc && !tdc->meas_mode)
+    {
+        // mode 1: TIME1 alone, then CALIBRATION1 and CALIBRATION2
+        static char tx[11] = {
+            [0] = TDC_CMD(0, 0, TDC_TIME1),
+            [4] = TDC_CMD(1, 0, TDC_CALIBRATION1)};
+        static const unsigned lens[2] = {4, 7};
+        char buff[sizeof(tx)];
+
+        if (tdcSpiXferBatch(tdc, tx, buff, lens, 2) < 0) return false;
+        memset(rx, 0, TDC_READOUT_LEN);
+        memcpy(rx + tdc_readout_idx[TDC_MEAS_TIME1], buff + 1, 3);
+        memcpy(rx + tdc_readout_idx[TDC_MEAS_CAL1], buff + 5, 6);
+    }
+    else if (autoinc)
+    {
+        static char tx[TDC_READOUT_LEN] = {
+            [0] = TDC_CMD(1, 0, TDC_TIME1),
+            [10] = TDC_CMD(1, 0, TDC_CALIBRATION1)};
+        static const unsigned lens[2] = {10, 7};
+
+        // both transactions issued back to back (a single ioctl with the spidev backend)
+        if (tdcSpiXferBatch(tdc, tx, rx, lens, 2) < 0) return false;
+    }
+    else
+    {
+        static const uint8_t reg_addrs[TDC_MEAS_NUM_REGS] = {
+            TDC_TIME1, TDC_CLOCK_COUNT1, TDC_TIME2, TDC_CALIBRATION1, TDC_CALIBRATION2};
+        memset(rx, 0, TDC_READOUT_LEN);
+        for (int i = 0; i < TDC_MEAS_NUM_REGS; i++)
+        {
+            // CLOCK_COUNT1 and TIME2 are unused in mode 1
+            if (!tdc->meas_mode && (i == TDC_MEAS_CLOCK_COUNT1 || i == TDC_MEAS_TIME2)) continue;
+
+            char tx[4] = {TDC_CMD(0, 0, reg_addrs[i])};
+            char reg_rx[4];
+            if (tdcSpiXfer(tdc, tx, reg_rx, sizeof(tx)) < 0) return false;
+            memcpy(rx + tdc_readout_idx[i], reg_rx + 1, 3);
+        }
+    }
+
+    // check parity now, while the result is still latched, re-reading only failing registers
+    return tdcValidateReadout(tdc, rx, tdc_readout_idx, retries);
+} // end tdcReadResult()
+/***********************************************************/
+
+void tdcPrintMeasStats(tdc_t* tdc, FILE* stream)
+{
+    uint32_t total = tdc->valid_meas + tdc->overflows + tdc->timeouts + tdc->incomplete;
+    fprintf(stream, "TDC %u measurements: valid=%u overflow=%u timeout=%u incomplete=%u valid_fraction=%.4f (gate %.1f m)\n",
+            tdc->id, tdc->valid_meas, tdc->overflows, tdc->timeouts, tdc->incomplete,
+            total ? (double)tdc->valid_meas / total : 0.0, tdc->meas_mode ? tdc->min_range_m : 0.0);
+} // end tdcPrintMeasStats()
+
+void tdcResetStats(tdc_t* tdc)
+{
+    tdc->valid_meas = 0;
+    tdc->overflows = 0;
+    tdc->timeouts = 0;
+    tdc->incomplete = 0;
+    tdc->bad_frames = 0;
+    tdc->parity_errors = 0;
+    tdc->parity_errors_seen = 0;
+    memset(tdc->reg_parity_errors, 0, sizeof(tdc->reg_parity_errors));
+} // end tdcResetStats()
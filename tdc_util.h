@@ -7,6 +7,11 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <unistd.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <linux/spi/spidev.h>
+#include "fast_gpio.h"
 
 #define LIGHT_SPEED 299792458.0
 
@@ -30,6 +35,19 @@
     (avg_cycles << 3)  |    \
     ((num_stop - 1))  
 
+// INT_STATUS register bits
+#define TDC_INT_NEW_MEAS 0x01       // measurement completed with a valid stop
+#define TDC_INT_COARSE_OVF 0x02     // coarse counter overflowed (mode 1 range exceeded)
+#define TDC_INT_CLOCK_OVF 0x04      // clock counter overflowed (mode 2 range exceeded)
+#define TDC_INT_MEAS_STARTED 0x08   // START received
+#define TDC_INT_MEAS_COMPLETE 0x10  // measurement finished (valid or overflow)
+
+#define TDC_CONFIG1_START_MEAS 0x01 // CONFIG1 bit starting a measurement; cleared by the TDC when it completes
+#define TDC_CONFIG1_MODE_MASK 0x06  // CONFIG1 measurement mode bits
+
+#define TDC_NOMINAL_LSB_SEC 55e-12  // typical ring oscillator period; sets the mode 1 coarse counter unit
+#define TDC_OVF_MAX 0xFFFF          // largest value of the 16-bit overflow registers
+
 //TDC register addresses; easier to define using enum
 enum TDC_REG_ADDR {
     TDC_CONFIG1 = 0x0, 
@@ -79,14 +97,79 @@ enum TDC_AVG_CYCLES
     TDC_AVG_128CYC
 };
 
+// order of the measurement registers needed for ToF calculation within a readout
+enum TDC_MEAS_REG
+{
+    TDC_MEAS_TIME1,
+    TDC_MEAS_CLOCK_COUNT1,
+    TDC_MEAS_TIME2,
+    TDC_MEAS_CAL1,
+    TDC_MEAS_CAL2,
+    TDC_MEAS_NUM_REGS
+};
+
+// outcome of a measurement as decoded from INT_STATUS
+enum TDC_MEAS_STATUS
+{
+    TDC_MEAS_VALID,     // a stop arrived within the range window
+    TDC_MEAS_OVERFLOW,  // no stop before the overflow registers ended the measurement
+    TDC_MEAS_TIMEOUT,   // INT never asserted (e.g. START never arrived)
+    TDC_MEAS_INCOMPLETE, // INT asserted, but INT_STATUS shows neither a new measurement nor an overflow
+    TDC_MEAS_ERROR      // SPI error reading INT_STATUS
+};
+
+// SPI driver used to talk to the TDC; selectable at runtime
+enum TDC_SPI_BACKEND
+{
+    TDC_SPI_PIGPIO, // pigpio spiOpen/spiXfer
+    TDC_SPI_SPIDEV  // kernel spidev driver via ioctl(SPI_IOC_MESSAGE)
+};
+
+#define TDC_NUM_CONFIG_REGS 10 // CONFIG1 (0x00) through CLOCK_CNTR_STOP_MASK_L (0x09)
+#define TDC_READOUT_LEN 17     // bytes of a measurement readout buffer; see tdcReadResult()
+
+#define TDC_SPI_MAX_XFERS 4   // max transactions per tdcSpiXferBatch() call
+#define TDC_SPI_MAX_BAUD 20000000    // TDC7200 SPI clock limit
+#define TDC_SPI_CORE_CLK 250000000   // Pi SPI core clock; SPI baud = TDC_SPI_CORE_CLK / divider
+#define TDC_SPI_DIV_STEP 4           // divider step between autotuner baud rates
+#define TDC_SPI_BUFF_SIZE 32  // bytes of preallocated tx/rx buffer per TDC
+
 typedef struct TDC {
     int spi_handle;
+    uint8_t id;                         // tags output of this TDC when several are in use
+    uint8_t spi_channel;                // SPI chip select (CEx) the TDC is attached to
+    uint32_t spi_flags;                 // pigpio spiOpen flags; bit 8 selects the aux SPI bus
+    double tof_offset;                  // per-TDC zero-range offset in seconds, subtracted from ToF
     uint32_t clk_freq;                  // frequency of reference clock provided to TDC
     uint32_t timeout_us;                // microseconds to wait for INT pin to go LO
     enum TDC_CAL_PERIODS cal_periods;   // calibration period config bits
+    uint8_t meas_mode;                  // CONFIG1 measurement mode bits; 0 = mode 1, 1 = mode 2
+    double max_range_m;                 // range after which the overflow registers end a measurement
+    double min_range_m;                 // near-field gate; stops before this range are ignored (effective in mode 2 only)
+    uint32_t valid_meas;                // measurements that returned a stop within range
+    uint32_t overflows;                 // measurements ended by the overflow registers (no return)
+    uint32_t timeouts;                  // measurements where INT never asserted
+    uint32_t incomplete;                // measurements where INT asserted without a result
     uint8_t clk_pin;    // Proivdes TDC reference clock
     uint8_t enable_pin; // active HIGH
     uint8_t int_pin;    // Pin at which to read the TDC interrupt pin; active LO until next measurement
+
+    /**** Config registers; staged with tdcSetReg(), written by tdcConfigure() ****/
+    uint8_t config[TDC_NUM_CONFIG_REGS];  // desired register contents
+    uint8_t shadow[TDC_NUM_CONFIG_REGS];  // register contents last written to (or reset in) the TDC
+    uint16_t shadow_valid;                // bit n set if shadow[n] is known to match the TDC
+
+    /**** SPI backend; spi_backend is assigned by the user, the rest by tdcInit ****/
+    enum TDC_SPI_BACKEND spi_backend;
+    uint32_t spi_baud;                  // current SPI clock
+    uint32_t spi_baud_floor;            // slowest (known good) clock; parity fallback never goes below it
+    volatile uint32_t parity_errors;    // measurement reads that failed parity; may be incremented by another thread
+    uint32_t parity_errors_seen;        // parity_errors at the last tdcParityFallback() call
+    uint32_t reg_parity_errors[TDC_MEAS_NUM_REGS]; // first-read parity failures per measurement register
+    uint32_t bad_frames;                // readouts still failing parity after re-reads
+    struct spi_ioc_transfer spi_xfers[TDC_SPI_MAX_XFERS]; // spidev transfer descriptors, preset at init
+    char spi_tx[TDC_SPI_BUFF_SIZE]; // persistent spidev tx buffer referenced by spi_xfers
+    char spi_rx[TDC_SPI_BUFF_SIZE]; // persistent spidev rx buffer referenced by spi_xfers
 } tdc_t;
 
 void printArray(char* arr, int arr_size);
@@ -94,9 +177,12 @@ void printArray(char* arr, int arr_size);
 // Returns true if n has odd parity
 bool checkOddParity(uint32_t n);
 
-// Calculate time of flight in microseconds
+// Calculate time of flight in seconds from a measurement mode 2 result
 double calcToF(uint32_t* tdc_data, uint8_t cal_periods, uint32_t clk_freq);
 
+// Calculate time of flight in seconds from a measurement mode 1 result; only TIME1 and the calibration registers are used
+double calcToFMode1(uint32_t* tdc_data, uint8_t cal_periods, uint32_t clk_freq);
+
 // Calculate distance in meters
 double calcDist(double ToF);
 
@@ -108,7 +194,8 @@ uint32_t convertSubsetToLong(char* start, int len, bool big_endian);
 
 /**Opens an SPI connection using pigpio SPI.Also initializes 
  * pins specified in the passed tdc struct. Assign desired 
- * pins and reference clock frequency prior to passing to this function
+ * pins, SPI channel/flags and reference clock frequency prior to passing to this function.
+ * May be called once per TDC when several TDCs share the reference clock.
  */
 int tdcInit(tdc_t* tdc, int baud);
 
@@ -116,4 +203,128 @@ int tdcInit(tdc_t* tdc, int baud);
  */
 void tdcClose(tdc_t* tdc);
 
+/**Performs a single full-duplex SPI transaction of count bytes with the
+ * backend selected in tdc->spi_backend. Returns bytes transferred or < 0 on error.
+ */
+int tdcSpiXfer(tdc_t* tdc, char* tx, char* rx, unsigned count);
+
+/**Performs n SPI transactions back to back, deselecting the TDC between them.
+ * tx and rx hold the transactions concatenated; lens[i] is the length of transaction i.
+ * With spidev all transactions are issued in a single ioctl.
+ * Returns total bytes transferred or < 0 on error.
+ */
+int tdcSpiXferBatch(tdc_t* tdc, char* tx, char* rx, const unsigned* lens, unsigned n);
+
+/**Byte offsets of the 3 big-endian data bytes of each measurement register (enum TDC_MEAS_REG)
+ * within a buffer filled by tdcReadResult().
+ */
+extern const uint8_t tdc_readout_idx[TDC_MEAS_NUM_REGS];
+
+/**Pulses ENABLE (the TDC must see a rising edge while powered to initialise) and
+ * resets the shadow registers to the TDC's power-on defaults.
+ */
+void tdcEnable(tdc_t* tdc);
+
+/**Stages value for config register addr (CONFIG1 to CLOCK_CNTR_STOP_MASK_L). Nothing is
+ * sent until tdcConfigure() or tdcArm(). The START_MEAS bit of CONFIG1 is ignored; staging
+ * CONFIG1 also updates tdc->meas_mode. Returns 0 or -1 if addr is not a config register.
+ */
+int tdcSetReg(tdc_t* tdc, enum TDC_REG_ADDR addr, uint8_t value);
+
+/**Writes every staged register that differs from its shadow copy. All changed registers
+ * are sent in one auto-increment burst from the first to the last of them; unchanged
+ * registers in between are rewritten with their shadow value (INT_STATUS with 0, which
+ * clears nothing). Returns the number of SPI transactions (0 or 1) or < 0 on SPI error.
+ */
+int tdcConfigure(tdc_t* tdc);
+
+/**Programs the coarse (mode 1) and clock (mode 2) counter overflow registers so the TDC
+ * itself ends a measurement once the round trip time for max_range_m has elapsed.
+ * Uses tdc->meas_mode and tdc->clk_freq. The registers are staged only; they are
+ * written by the next tdcConfigure() or tdcArm(). Returns 0.
+ */
+int tdcSetMaxRange(tdc_t* tdc, double max_range_m);
+
+/**Stages CLOCK_CNTR_STOP_MASK so the TDC ignores stops arriving before the round trip
+ * time of min_range_m (rounded down to whole reference clock periods), and stores the gate
+ * in tdc->min_range_m. The stop mask only exists in measurement mode 2; in mode 1 the
+ * mask is cleared (the gate is kept for a later switch to mode 2) and -1 returned.
+ * Returns 0 otherwise.
+ */
+int tdcSetMinRange(tdc_t* tdc, double min_range_m);
+
+/**Stages the CONFIG1 measurement mode bits (0 = mode 1, 1 = mode 2) and re-stages the
+ * overflow and stop mask registers for tdc->max_range_m and tdc->min_range_m in the new
+ * mode. Nothing is sent; the next tdcArm() writes the change in the same burst.
+ * Returns 0, or 1 if the near-field gate is suspended because the new mode is mode 1.
+ */
+int tdcSetMeasMode(tdc_t* tdc, uint8_t mode);
+
+/**Starts a measurement. Pending config changes are sent first; with the spidev
+ * backend both transactions go out in a single ioctl. Returns < 0 on SPI error.
+ */
+int tdcArm(tdc_t* tdc);
+
+/**Waits up to tdc->timeout_us for the INT pin to go LO, then reads INT_STATUS with
+ * tdcReadStatus(). The pin is polled through the mapped GPIO registers if fastGpioInit()
+ * succeeded, otherwise with gpioRead(). Timeouts are counted in tdc->timeouts.
+ */
+enum TDC_MEAS_STATUS tdcWaitResult(tdc_t* tdc);
+
+/**Reads INT_STATUS and decodes it. Call once the INT pin has gone LO. A measurement is
+ * valid only if NEW_MEAS is set; its registers hold nothing otherwise. Valid measurements,
+ * overflows and the rest are counted in tdc->valid_meas, tdc->overflows and tdc->incomplete.
+ */
+enum TDC_MEAS_STATUS tdcReadStatus(tdc_t* tdc);
+
+/**Reads TIME1, CLOCK_COUNT1, TIME2, CALIBRATION1 and CALIBRATION2 into rx (at least
+ * TDC_READOUT_LEN bytes, layout given by tdc_readout_idx). With autoinc the registers
+ * are read in 2 auto-increment transactions, otherwise in 5 single register reads.
+ * In measurement mode 1 CLOCK_COUNT1 and TIME2 are not needed and are not read;
+ * their bytes are left 0.
+ * Registers failing parity are re-read with tdcValidateReadout(). Returns true if
+ * every register is valid.
+ */
+bool tdcReadResult(tdc_t* tdc, char* rx, bool autoinc, int retries);
+
+/**Checks parity of the TDC_MEAS_NUM_REGS measurement registers in a readout buffer.
+ * data_idx[i] is the offset in rx of the 3 big-endian bytes of register i (enum TDC_MEAS_REG).
+ * Only registers failing parity are re-read, up to retries times each, while the result is
+ * still latched (i.e. before the TDC is armed again); good re-reads are patched into rx.
+ * Updates the per-register and bad frame counters. Returns true if every register is valid.
+ */
+bool tdcValidateReadout(tdc_t* tdc, char* rx, const uint8_t* data_idx, int retries);
+
+// Prints the parity error counters of tdc to stream
+void tdcPrintParityStats(tdc_t* tdc, FILE* stream);
+
+// Prints measurement outcome counters and the valid-sample fraction of tdc to stream
+void tdcPrintMeasStats(tdc_t* tdc, FILE* stream);
+
+// Zeroes the measurement outcome and parity error counters
+void tdcResetStats(tdc_t* tdc);
+
+/**Changes the SPI clock of an initialised TDC. Returns 0 or < 0 on error.
+ */
+int tdcSetBaud(tdc_t* tdc, uint32_t baud);
+
+/**Writes test patterns to CONFIG2, INT_MASK and the overflow registers with an
+ * auto-increment burst and reads them back, then checks parity of the measurement
+ * registers. Original register contents are restored. Returns true if all trials pass.
+ */
+bool tdcVerifySpi(tdc_t* tdc, int trials);
+
+/**Steps the SPI clock up from the current rate towards max_baud, verifying each
+ * step with tdcVerifySpi(). Settles on the fastest passing rate reduced by the
+ * fraction margin (snapped down to an available rate), logs it and returns it.
+ * The starting rate becomes the floor used by tdcParityFallback().
+ */
+uint32_t tdcAutotuneBaud(tdc_t* tdc, uint32_t max_baud, int trials, double margin);
+
+/**Checks the parity errors counted since the previous call. If more than max_errors
+ * occurred, the SPI clock is stepped down one rate (not below spi_baud_floor).
+ * Returns true if the clock was changed.
+ */
+bool tdcParityFallback(tdc_t* tdc, uint32_t max_errors);
+
 #endif
\ No newline at end of file
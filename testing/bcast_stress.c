@@ -0,0 +1,137 @@
+#define _GNU_SOURCE
+#include "bcast_ring.h"
+#include <string.h>
+#include <time.h>
+
+/** Stress test of the broadcast ring feeding tdc_test's output sinks.
+ *  One producer publishes ENTRIES numbered entries into a small ring read by sinks of every
+ *  wait strategy, gating and dropping. Sinks stall now and then so the producer runs into
+ *  gating sinks and laps dropping ones. Every handler checks that:
+ *    - entry n arrives as seq n, in increasing order; gating sinks see every n
+ *    - the payload, written from n, is intact (no torn or overwritten entry)
+ *  and at the end handled + dropped must equal ENTRIES for every sink. bcastSync() must not
+ *  return before every gating sink has handled the last entry.
+ *  Usage: bcast_stress.out [entries]
+ *  Build: gcc -O2 -I.. bcast_stress.c ../bcast_ring.c -o bcast_stress.out -pthread
+ */
+
+#define ENTRIES 5000000
+#define RING_ENTRIES 256
+#define PAYLOAD_WORDS 14     // entry of 128 bytes, like a struct SampleEntry
+#define STALL_EVERY 100000   // entries between sink stalls
+#define STALL_NSEC 2000000   // stall long enough to lap the ring
+
+struct StressEntry
+{
+    uint64_t n;
+    uint64_t payload[PAYLOAD_WORDS];
+    uint64_t check; // ~n, written last
+};
+
+struct SinkCheck
+{
+    bool gating;
+    uint64_t next;     // lowest seq expected next
+    uint64_t errors;
+    uint64_t seen;
+};
+
+static void stressSink(void* entry, uint64_t seq, bool end_of_batch, void* arg)
+{
+    (void)end_of_batch;
+    struct StressEntry* e = (struct StressEntry*)entry;
+    struct SinkCheck* c = (struct SinkCheck*)arg;
+
+    bool in_order = c->gating ? (seq == c->next) : (seq >= c->next);
+    bool intact = (e->n == seq && e->check == ~seq);
+    for (int i = 0; i < PAYLOAD_WORDS; i++)
+    {
+        intact &= (e->payload[i] == seq * (i + 1));
+    }
+    if (!in_order || !intact)
+    {
+        if (c->errors++ < 10)
+        {
+            printf("  seq %llu: %s\n", (unsigned long long)seq, !in_order ? "out of order" : "torn entry");
+        }
+    }
+    c->next = seq + 1;
+    c->seen++;
+
+    if (seq % STALL_EVERY == STALL_EVERY / 2) // every sink stalls at the same place; gating ones hold the producer
+    {
+        struct timespec stall = {0, STALL_NSEC};
+        nanosleep(&stall, NULL);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    uint64_t entries = (argc > 1) ? strtoull(argv[1], NULL, 10) : ENTRIES;
+    static const struct
+    {
+        const char* name;
+        enum BCAST_WAIT wait;
+        enum BCAST_POLICY policy;
+    } sinks[] = {
+        {"gate-blk", BCAST_WAIT_BLOCK, BCAST_GATE},
+        {"gate-yld", BCAST_WAIT_YIELD, BCAST_GATE},
+        {"gate-slp", BCAST_WAIT_SLEEP, BCAST_GATE},
+        {"drop-blk", BCAST_WAIT_BLOCK, BCAST_DROP},
+        {"drop-slp", BCAST_WAIT_SLEEP, BCAST_DROP},
+    };
+    const int nsinks = sizeof(sinks) / sizeof(sinks[0]);
+    struct SinkCheck checks[sizeof(sinks) / sizeof(sinks[0])];
+
+    bcast_ring_t* ring = bcastCreate(RING_ENTRIES, sizeof(struct StressEntry));
+    if (ring == NULL)
+    {
+        perror("bcastCreate");
+        return -1;
+    }
+    for (int i = 0; i < nsinks; i++)
+    {
+        checks[i] = (struct SinkCheck){.gating = (sinks[i].policy == BCAST_GATE)};
+        bcastAddSink(ring, sinks[i].name, &stressSink, &checks[i], sinks[i].wait, sinks[i].policy);
+    }
+    if (bcastStart(ring, NULL) < 0)
+    {
+        perror("bcastStart");
+        return -1;
+    }
+
+    for (uint64_t n = 0; n < entries; n++)
+    {
+        struct StressEntry* e = (struct StressEntry*)bcastClaim(ring);
+        e->n = n;
+        for (int i = 0; i < PAYLOAD_WORDS; i++)
+        {
+            e->payload[i] = n * (i + 1);
+        }
+        e->check = ~n;
+        bcastPublish(ring);
+    }
+    bcastSync(ring);
+    uint64_t unsynced = 0;
+    for (int i = 0; i < nsinks; i++)
+    {
+        if (checks[i].gating && checks[i].seen != entries) unsynced++;
+    }
+    printf("bcastSync: %s\n", unsynced ? "returned before the gating sinks were done" : "ok");
+    bcastStop(ring);
+    bcastPrintStats(ring, stdout);
+
+    uint64_t failures = unsynced;
+    for (int i = 0; i < nsinks; i++)
+    {
+        bcast_sink_t* sink = &ring->sinks[i];
+        bool complete = (sink->handled + sink->dropped == entries) && (!checks[i].gating || sink->dropped == 0);
+        printf("%-8s: %llu handled, %llu dropped, %llu errors%s\n", sinks[i].name,
+               (unsigned long long)sink->handled, (unsigned long long)sink->dropped,
+               (unsigned long long)checks[i].errors, complete ? "" : ", ENTRIES MISSING");
+        failures += checks[i].errors + !complete;
+    }
+    bcastDestroy(ring);
+    printf("%s\n", failures ? "FAIL" : "OK");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,98 @@
+#include <pigpio.h>
+#include <string.h>
+#include <time.h>
+#include "fast_gpio.h"
+
+/** Compares pigpio gpioRead()/gpioWrite() against direct register access.
+ *  Usage: gpio_bench.out [mock]
+ *  With "mock", the fast backend is pointed at an array and its register
+ *  writes are checked; no hardware or pigpio initialisation is needed.
+ */
+
+#define READ_PIN 22  // TDC INT pin
+#define WRITE_PIN_A 23
+#define WRITE_PIN_B 24
+#define ITERATIONS 1000000
+
+double nowSec()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int mockTest()
+{
+    uint32_t regs[FAST_GPIO_NUM_REGS];
+    memset(regs, 0, sizeof(regs));
+    fastGpioInitMock(regs);
+
+    bool pass = true;
+
+    regs[FAST_GPIO_GPLEV0] = 1u << READ_PIN;
+    pass &= fastGpioRead(READ_PIN) == 1;
+    pass &= fastGpioRead(WRITE_PIN_A) == 0;
+
+    fastGpioSetBits((1u << WRITE_PIN_A) | (1u << WRITE_PIN_B));
+    pass &= regs[FAST_GPIO_GPSET0] == ((1u << WRITE_PIN_A) | (1u << WRITE_PIN_B));
+
+    fastGpioWrite(WRITE_PIN_B, 0);
+    pass &= regs[FAST_GPIO_GPCLR0] == (1u << WRITE_PIN_B);
+
+    fastGpioClose();
+    printf("mock: %s\n", pass ? "PASS" : "FAIL");
+    return !pass;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc > 1 && strcmp(argv[1], "mock") == 0) return mockTest();
+
+    if (gpioInitialise() < 0) return 1;
+    if (fastGpioInit() < 0)
+    {
+        gpioTerminate();
+        return 1;
+    }
+    gpioSetMode(READ_PIN, PI_INPUT);
+    gpioSetMode(WRITE_PIN_A, PI_OUTPUT);
+    gpioSetMode(WRITE_PIN_B, PI_OUTPUT);
+
+    volatile int sink = 0;
+    double t0, t1;
+
+    t0 = nowSec();
+    for (int i = 0; i < ITERATIONS; i++) sink += gpioRead(READ_PIN);
+    t1 = nowSec();
+    printf("gpioRead:          %7.1f ns/op\n", (t1 - t0) * 1e9 / ITERATIONS);
+
+    t0 = nowSec();
+    for (int i = 0; i < ITERATIONS; i++) sink += fastGpioRead(READ_PIN);
+    t1 = nowSec();
+    printf("fastGpioRead:      %7.1f ns/op\n", (t1 - t0) * 1e9 / ITERATIONS);
+
+    // two-pin edge: two library calls vs one register write
+    t0 = nowSec();
+    for (int i = 0; i < ITERATIONS; i++)
+    {
+        gpioWrite(WRITE_PIN_A, i & 1);
+        gpioWrite(WRITE_PIN_B, i & 1);
+    }
+    t1 = nowSec();
+    printf("gpioWrite x2:      %7.1f ns/edge\n", (t1 - t0) * 1e9 / ITERATIONS);
+
+    uint32_t mask = (1u << WRITE_PIN_A) | (1u << WRITE_PIN_B);
+    t0 = nowSec();
+    for (int i = 0; i < ITERATIONS; i++)
+    {
+        if (i & 1) fastGpioSetBits(mask);
+        else fastGpioClearBits(mask);
+    }
+    t1 = nowSec();
+    printf("fastGpioSetBits:   %7.1f ns/edge\n", (t1 - t0) * 1e9 / ITERATIONS);
+
+    fastGpioClearBits(mask);
+    fastGpioClose();
+    gpioTerminate();
+    return 0;
+}
@@ -0,0 +1,310 @@
+#include <string.h>
+#include <time.h>
+#include <math.h>
+#include "tof_hist.h"
+
+/** Replays recorded captures through the ToF histogram stage of tdc_test -H window.
+ *  Usage: hist_replay.out capture [dark_capture] [window_sec]
+ *         hist_replay.out self
+ *  capture is a data file written by tdc_test (or an older capture such as tdc_w_laser.txt);
+ *  rows are read by the TIMESTAMP (s) and DIST (m) columns, and -999 distances count as
+ *  shots without a return. Two kinds of rows of older captures are skipped:
+ *    - rows with a distance of 0 (TIME1 = 0), which hold no measurement
+ *    - rows repeating every field but the timestamp of the row before; the same TDC registers
+ *      were logged again until the next measurement replaced them, and counting each copy
+ *      stacks a single stop into a false return
+ *  dark_capture, a laser-off run such as tdc_wo_laser.txt, is recorded as the dark-count
+ *  reference first. Prints the returns of every window and the worst single tofHistAdd(),
+ *  which emits at most one histogram of the last window. With dark_capture the same file as
+ *  capture, a laser-off run replayed against itself, any return is a false alarm and the exit
+ *  status is 1.
+ *  With "self", synthetic shots with two returns of known range over a dark-count floor are
+ *  replayed instead, and the centroid and width errors are checked. Per-angle windows whose
+ *  shot counts fall below the histograms of the window before are replayed too, checking that
+ *  no tofHistAdd() emits more than one histogram and that every shot is emitted once.
+ *  Build: gcc -O2 -I.. hist_replay.c ../tof_hist.c -o hist_replay.out -lm
+ */
+
+#define LIGHT_SPEED 299792458.0
+#define BIN_NSEC 0.5       // as HIST_BIN_NSEC in tdc_test
+#define MAX_RANGE_M 300.0  // as HIST_MAX_RANGE_M in tdc_test
+#define WINDOW_SEC 1.0     // default window
+#define SELF_SHOTS 200000
+#define SELF_RATE_HZ 10000.0
+#define SELF_RANGES_M {12.34, 12.34 + 2.5} // two targets 2.5 m apart, 1.5 ns jitter
+#define SELF_JITTER_NSEC 1.5
+#define SELF_MEAN_TOL_M 0.005     // centroid bias allowed
+#define SELF_MEAN_TOL_NSEC 0.1    // width bias allowed
+#define SELF_WORST_TOL_M 0.075    // worst single-window centroid error allowed
+#define CARRY_FACETS 6
+#define CARRY_ANGLE_BINS 100      // 600 histograms per window
+#define CARRY_WINDOW_SEC 0.01
+#define CARRY_SHOTS {3000, 40, 40, 3000, 3000} // shots per window; 40 shots cannot emit ~600 histograms
+
+static uint64_t emitted_windows;
+// self mode: histograms and shots passed to countEmits()
+static uint64_t carry_emits, carry_shots;
+// self mode: centroid errors in meters and width errors in nanoseconds, summed for the bias
+static double range_err_sum, range_err_max;
+static double width_err_sum, width_err_max;
+
+double nowSec()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void printReturns(const tof_hist_t* hist, double start, uint32_t group, const uint32_t* counts,
+                         uint32_t shots, const hist_peak_t* peaks, int npeaks, void* arg)
+{
+    (void)hist, (void)group, (void)counts;
+    bool self = (arg != NULL);
+    emitted_windows++;
+    if (!self) printf("%lf: %u shots, %d returns\n", start, shots, npeaks);
+    for (int p = 0; p < npeaks; p++)
+    {
+        double range = peaks[p].tof * LIGHT_SPEED / 2;
+        if (!self)
+        {
+            printf("    %8.3lf m  amplitude %7.1lf  width %6.3lf ns  background %6.3lf/bin  p 1e%.1lf\n",
+                   range, peaks[p].amplitude, peaks[p].width * 1e9, peaks[p].background, peaks[p].log_p);
+            continue;
+        }
+        // nearest true range
+        const double* truth = (const double*)arg;
+        double range_err = (fabs(range - truth[0]) < fabs(range - truth[1])) ? range - truth[0] : range - truth[1];
+        double width_err = peaks[p].width * 1e9 - SELF_JITTER_NSEC;
+        range_err_sum += range_err;
+        width_err_sum += width_err;
+        range_err_max = fmax(range_err_max, fabs(range_err));
+        width_err_max = fmax(width_err_max, fabs(width_err));
+    }
+}
+
+// Column index of name in a CSV header row, or -1
+static int findColumn(const char* header, const char* name)
+{
+    int col = 0;
+    for (const char* p = header; p != NULL; p = strchr(p, ','), p = p ? p + 1 : NULL, col++)
+    {
+        if (strncmp(p, name, strlen(name)) == 0) return col;
+    }
+    return -1;
+}
+
+// Reads time and distance from one CSV row; false if the row has too few fields
+static bool parseRow(char* line, int time_col, int dist_col, double* time, double* dist)
+{
+    char* p = line;
+    for (int col = 0; p != NULL; col++)
+    {
+        if (col == time_col) *time = atof(p);
+        if (col == dist_col)
+        {
+            *dist = atof(p);
+            return true;
+        }
+        p = strchr(p, ',');
+        if (p != NULL) p++;
+    }
+    return false;
+}
+
+/**Feeds every row of path to the histograms, as dark shots if dark is set. Returns the rows
+ * used or -1 if the file cannot be used.
+ */
+static long replayCapture(tof_hist_t* hist, const char* path, bool dark, double* add_max)
+{
+    FILE* file = fopen(path, "r");
+    if (file == NULL)
+    {
+        perror(path);
+        return -1;
+    }
+
+    char* line = NULL;
+    char* prev = NULL;          // fields after the timestamp of the latest row used
+    size_t cap = 0, prev_cap = 0;
+    int time_col = -1, dist_col = -1;
+    long rows = 0, skipped = 0, repeats = 0;
+    while (getline(&line, &cap, file) > 0)
+    {
+        if (line[0] == '#') continue;
+        if (strncmp(line, "TIMESTAMP", 9) == 0) // header; repeated in continuous captures
+        {
+            time_col = findColumn(line, "TIMESTAMP (s)");
+            dist_col = findColumn(line, "DIST (m)");
+            continue;
+        }
+        double time = 0, dist;
+        if (time_col < 0 || dist_col < 0 || !parseRow(line, time_col, dist_col, &time, &dist)) continue;
+        if (dist == 0.0) // no measurement
+        {
+            skipped++;
+            continue;
+        }
+        const char* fields = strchr(line, ',');
+        if (fields != NULL && prev != NULL && strcmp(fields, prev) == 0) // same registers read again
+        {
+            repeats++;
+            continue;
+        }
+        if (fields != NULL)
+        {
+            size_t len = strlen(fields) + 1;
+            if (len > prev_cap)
+            {
+                char* grown = (char*)realloc(prev, len);
+                if (grown == NULL) break;
+                prev = grown;
+                prev_cap = len;
+            }
+            memcpy(prev, fields, len);
+        }
+
+        bool has_stop = (dist != -999.0);
+        double tof = 2 * dist / LIGHT_SPEED;
+        if (dark)
+        {
+            tofHistAddDark(hist, has_stop, tof);
+        }
+        else
+        {
+            double t0 = nowSec();
+            tofHistAdd(hist, time, has_stop, tof, false, 0, 0);
+            double t = nowSec() - t0;
+            if (t > *add_max) *add_max = t;
+        }
+        rows++;
+    }
+    free(line);
+    free(prev);
+    fclose(file);
+    if (time_col < 0 || dist_col < 0)
+    {
+        fprintf(stderr, "%s: no TIMESTAMP (s) and DIST (m) columns\n", path);
+        return -1;
+    }
+    if (skipped > 0 || repeats > 0)
+    {
+        printf("%s: %ld rows without a measurement and %ld repeated rows skipped\n", path, skipped, repeats);
+    }
+    return rows;
+}
+
+static void countEmits(const tof_hist_t* hist, double start, uint32_t group, const uint32_t* counts,
+                       uint32_t shots, const hist_peak_t* peaks, int npeaks, void* arg)
+{
+    (void)hist, (void)start, (void)group, (void)counts, (void)peaks, (void)npeaks, (void)arg;
+    carry_emits++;
+    carry_shots += shots;
+}
+
+/**Per-angle windows whose shot counts drop well below the histograms of the window before: each
+ * tofHistAdd() must still emit at most one histogram, with the leftovers carried into the next
+ * window's shots, and every shot must come out once. Returns fail count.
+ */
+static int carryTest(uint32_t bins)
+{
+    static const uint32_t window_shots[] = CARRY_SHOTS;
+    tof_hist_t* hist = tofHistCreate(bins, BIN_NSEC * 1e-9, 0.0, CARRY_WINDOW_SEC, CARRY_FACETS, CARRY_ANGLE_BINS,
+                                     0.0, 720.0 / CARRY_FACETS, &countEmits, NULL);
+    if (hist == NULL) return 1;
+    uint64_t added = 0, per_add_max = 0;
+    for (uint32_t w = 0; w < sizeof(window_shots) / sizeof(window_shots[0]); w++)
+    {
+        for (uint32_t i = 0; i < window_shots[w]; i++, added++)
+        {
+            double time = (w + (double)i / window_shots[w]) * CARRY_WINDOW_SEC;
+            float angle = (float)(rand() / (RAND_MAX + 1.0) * 720.0 / CARRY_FACETS);
+            uint64_t before = carry_emits;
+            tofHistAdd(hist, time, true, (rand() % bins) * BIN_NSEC * 1e-9, true, rand() % CARRY_FACETS, angle);
+            per_add_max = (carry_emits - before > per_add_max) ? carry_emits - before : per_add_max;
+        }
+    }
+    tofHistFlush(hist);
+    printf("windows of falling shot counts: at most %llu histograms per tofHistAdd, %llu of %llu shots emitted, "
+           "%llu shots past a window's end\n", (unsigned long long)per_add_max, (unsigned long long)carry_shots,
+           (unsigned long long)added, (unsigned long long)hist->overdue);
+    int fails = (per_add_max > 1) + (carry_shots != added) + (hist->overdue == 0);
+    tofHistDestroy(hist);
+    return fails;
+}
+
+// Two returns over a flat dark-count floor; returns fail count
+static int selfTest(uint32_t bins)
+{
+    static const double ranges[2] = SELF_RANGES_M;
+    tof_hist_t* hist = tofHistCreate(bins, BIN_NSEC * 1e-9, 0.0, 0.1, 0, 1, 0, 1, &printReturns, (void*)ranges);
+    srand(1);
+    double add_max = 0, t0 = nowSec();
+    for (uint32_t i = 0; i < SELF_SHOTS; i++)
+    {
+        // Box-Muller for the timing jitter
+        double u1 = (rand() + 1.0) / (RAND_MAX + 2.0), u2 = rand() / (RAND_MAX + 1.0);
+        double jitter = sqrt(-2 * log(u1)) * cos(2 * M_PI * u2) * SELF_JITTER_NSEC * 1e-9;
+        int r = rand() % 10;
+        double tof = (r < 6) ? 2 * ranges[r % 2] / LIGHT_SPEED + jitter : (rand() / (double)RAND_MAX) * bins * BIN_NSEC * 1e-9;
+
+        double t = nowSec();
+        tofHistAdd(hist, i / SELF_RATE_HZ, r < 8, tof, false, 0, 0);
+        if (nowSec() - t > add_max) add_max = nowSec() - t;
+    }
+    double elapsed = nowSec() - t0;
+    tofHistFlush(hist);
+    tofHistPrintStats(hist, stdout);
+    printf("%u shots: %.1lf ns per shot, worst %.1lf us\n", SELF_SHOTS, elapsed / SELF_SHOTS * 1e9, add_max * 1e6);
+    double returns = hist->returns ? hist->returns : 1;
+    printf("%llu windows, %llu returns\n", (unsigned long long)emitted_windows, (unsigned long long)hist->returns);
+    printf("centroid error: mean %+.4lf m, worst %.4lf m\n", range_err_sum / returns, range_err_max);
+    printf("width error: mean %+.3lf ns, worst %.3lf ns\n", width_err_sum / returns, width_err_max);
+    // ~300 stops per return per window: centroid sigma ~1.3 cm, width sigma ~0.06 ns
+    int fails = (hist->returns != 2 * emitted_windows) + (fabs(range_err_sum / returns) > SELF_MEAN_TOL_M) +
+                (fabs(width_err_sum / returns) > SELF_MEAN_TOL_NSEC) + (range_err_max > SELF_WORST_TOL_M);
+    tofHistDestroy(hist);
+    fails += carryTest(bins);
+    printf("%s\n", fails ? "FAIL" : "OK");
+    return fails;
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t bins = (uint32_t)ceil(2.0 * MAX_RANGE_M / LIGHT_SPEED / (BIN_NSEC * 1e-9));
+    if (argc < 2)
+    {
+        printf("Usage: %s capture [dark_capture] [window_sec]\n       %s self\n", argv[0], argv[0]);
+        return -1;
+    }
+    if (strcmp(argv[1], "self") == 0) return selfTest(bins);
+
+    double window_sec = (argc > 3) ? atof(argv[3]) : WINDOW_SEC;
+    tof_hist_t* hist = tofHistCreate(bins, BIN_NSEC * 1e-9, 0.0, window_sec, 0, 1, 0, 1, &printReturns, NULL);
+    if (hist == NULL)
+    {
+        perror("tofHistCreate");
+        return -1;
+    }
+
+    double add_max = 0;
+    if (argc > 2)
+    {
+        long dark_rows = replayCapture(hist, argv[2], true, &add_max);
+        if (dark_rows < 0 || tofHistUseDark(hist) < 0) return -1;
+        printf("dark-count reference: %ld shots from %s\n", dark_rows, argv[2]);
+    }
+    double t0 = nowSec();
+    long rows = replayCapture(hist, argv[1], false, &add_max);
+    double elapsed = nowSec() - t0;
+    if (rows < 0) return -1;
+    tofHistFlush(hist);
+
+    tofHistPrintStats(hist, stdout);
+    printf("%ld shots: %.1lf ns per shot including parsing, worst tofHistAdd %.1lf us\n", rows,
+           rows ? elapsed / rows * 1e9 : 0.0, add_max * 1e6);
+    // a laser-off capture against itself has nothing to find
+    bool fail = (argc > 2 && strcmp(argv[1], argv[2]) == 0 && hist->returns > 0);
+    if (fail) printf("FAIL: %llu returns from a capture replayed against itself\n", (unsigned long long)hist->returns);
+    tofHistDestroy(hist);
+    return fail ? 1 : 0;
+}
@@ -0,0 +1,204 @@
+#include <string.h>
+#include <time.h>
+#include <math.h>
+#include "pcloud.h"
+
+/** Checks the point-cloud builder of tdc_test -o.
+ *    - accuracy: random (facet, angle, range) samples are streamed through pcloudAdd(), and
+ *      every point of every chunk is compared with x, y, z computed by direct trig in double
+ *    - throughput: the same samples through a builder without outputs, i.e. the batching and
+ *      table conversion alone
+ *    - files: for PLY and PCD, batches of uneven size are written with pcloudFlush(); after
+ *      each one the header's point count must match the points in the file and the file size
+ *  Usage: pcloud_test.out [points]
+ *  Build: gcc -O2 -I.. pcloud_test.c ../pcloud.c -o pcloud_test.out -lm
+ */
+
+#define POINTS 5000000
+#define FACETS 6
+#define ANGLE0_DEG 0.0      // as MIRROR_SOS_ANGLE_DEG in tdc_test
+#define SPAN_DEG (720.0 / FACETS)
+#define FACET_ELEV_DEG {-2.5, -1.5, -0.5, 0.5, 1.5, 2.5} // a pyramidal polygon, so z is exercised
+#define MAX_RANGE_M 100.0
+#define MAX_ERR_M 50e-6     // float output alone is good to ~4 um at 100 m
+#define FILE_FLUSHES 7
+#define TEST_FILE "pcloud_test"
+
+static const float facet_elev[FACETS] = FACET_ELEV_DEG;
+
+// inputs, in the order they were added
+static uint8_t* in_facet;
+static float* in_angle;
+static float* in_range;
+static uint64_t checked;       // points compared so far
+static double err_max;
+
+double nowSec()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Point count stated by a PLY or PCD header at the start of buf (len bytes) and the header's length; false if none
+static bool parseHeader(const void* buf, size_t len, uint64_t* npoints, long* hdr_len)
+{
+    char hdr[PCLOUD_HDR_MAX + 1];
+    len = (len < PCLOUD_HDR_MAX) ? len : PCLOUD_HDR_MAX;
+    memcpy(hdr, buf, len);
+    hdr[len] = '\0';
+
+    const char* count = strstr(hdr, "element vertex ");
+    const char* end = strstr(hdr, "end_header\n");
+    if (count != NULL && end != NULL)
+    {
+        *npoints = strtoull(count + 15, NULL, 10);
+        *hdr_len = end + 11 - hdr;
+        return true;
+    }
+    count = strstr(hdr, "\nPOINTS ");
+    end = strstr(hdr, "DATA binary\n");
+    if (count != NULL && end != NULL)
+    {
+        *npoints = strtoull(count + 8, NULL, 10);
+        *hdr_len = end + 12 - hdr;
+        return true;
+    }
+    return false;
+}
+
+// Stream write function; checks the chunk's header and compares its points with direct trig
+static int checkChunk(const void* buf, size_t len, void* arg)
+{
+    (void)arg;
+    uint64_t n = 0;
+    long hdr_len = 0;
+    if (!parseHeader(buf, len, &n, &hdr_len) || len != hdr_len + n * sizeof(pcloud_point_t))
+    {
+        printf("  malformed chunk of %zu bytes\n", len);
+        err_max = INFINITY;
+        return 0;
+    }
+
+    const pcloud_point_t* points = (const pcloud_point_t*)((const uint8_t*)buf + hdr_len);
+    for (uint64_t i = 0; i < n; i++, checked++)
+    {
+        double el = facet_elev[in_facet[checked]] * M_PI / 180.0;
+        double az = in_angle[checked] * M_PI / 180.0;
+        double r = in_range[checked];
+        double dx = points[i].x - r * cos(el) * cos(az);
+        double dy = points[i].y - r * cos(el) * sin(az);
+        double dz = points[i].z - r * sin(el);
+        double err = sqrt(dx * dx + dy * dy + dz * dz);
+        if (err > err_max) err_max = err;
+        if (points[i].facet != in_facet[checked]) err_max = INFINITY;
+    }
+    return 0;
+}
+
+// Point count stated by the file's header, its length and the file size; false if unreadable
+static bool readFile(const char* path, uint64_t* npoints, long* hdr_len, long* size)
+{
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) return false;
+    char hdr[PCLOUD_HDR_MAX];
+    size_t got = fread(hdr, 1, PCLOUD_HDR_MAX, file);
+    fseek(file, 0, SEEK_END);
+    *size = ftell(file);
+    fclose(file);
+    return parseHeader(hdr, got, npoints, hdr_len);
+}
+
+// Writes FILE_FLUSHES batches of uneven size to a file of format; returns fail count
+static int fileTest(enum PCLOUD_FORMAT format, const char* path)
+{
+    pcloud_t* pc = pcloudCreate(format, FACETS, facet_elev, ANGLE0_DEG, SPAN_DEG);
+    if (pc == NULL || pcloudOpenFile(pc, path) < 0) return 1;
+
+    int fails = 0;
+    uint64_t written = 0;
+    for (int flush = 0; flush <= FILE_FLUSHES; flush++)
+    {
+        // 0, then sizes below, at and above one batch
+        uint32_t n = flush ? (uint32_t)(rand() % (3 * PCLOUD_BATCH_MAX)) + 1 : 0;
+        for (uint32_t i = 0; i < n; i++, written++)
+        {
+            pcloudAdd(pc, in_facet[i], in_angle[i], in_range[i], 0.0);
+        }
+        pcloudFlush(pc);
+
+        uint64_t npoints = 0;
+        long hdr_len = 0, size = 0;
+        bool ok = readFile(path, &npoints, &hdr_len, &size) && npoints == written &&
+                  size == hdr_len + (long)(npoints * sizeof(pcloud_point_t));
+        printf("  %s after %d flushes: header %llu points, %ld + %llu x %zu bytes = %ld, file %ld bytes%s\n", path,
+               flush, (unsigned long long)npoints, hdr_len, (unsigned long long)npoints, sizeof(pcloud_point_t),
+               hdr_len + (long)(npoints * sizeof(pcloud_point_t)), size, ok ? "" : ", MISMATCH");
+        fails += !ok;
+    }
+    pcloudDestroy(pc);
+    remove(path);
+    return fails;
+}
+
+int main(int argc, char** argv)
+{
+    uint64_t points = (argc > 1) ? strtoull(argv[1], NULL, 10) : POINTS;
+    if (points < 3 * PCLOUD_BATCH_MAX) points = 3 * PCLOUD_BATCH_MAX;
+    in_facet = (uint8_t*)malloc(points);
+    in_angle = (float*)malloc(sizeof(float) * points);
+    in_range = (float*)malloc(sizeof(float) * points);
+    if (in_facet == NULL || in_angle == NULL || in_range == NULL)
+    {
+        perror("malloc");
+        return -1;
+    }
+    srand(1);
+    for (uint64_t i = 0; i < points; i++)
+    {
+        in_facet[i] = rand() % FACETS;
+        in_angle[i] = ANGLE0_DEG + SPAN_DEG * (rand() / (double)RAND_MAX);
+        in_range[i] = MAX_RANGE_M * (rand() / (double)RAND_MAX);
+    }
+
+    // accuracy, through the stream output
+    pcloud_t* pc = pcloudCreate(PCLOUD_PLY, FACETS, facet_elev, ANGLE0_DEG, SPAN_DEG);
+    if (pc == NULL)
+    {
+        perror("pcloudCreate");
+        return -1;
+    }
+    pcloudSetStream(pc, &checkChunk, NULL);
+    for (uint64_t i = 0; i < points; i++)
+    {
+        pcloudAdd(pc, in_facet[i], in_angle[i], in_range[i], 0.0);
+    }
+    pcloudFlush(pc);
+    pcloudPrintStats(pc, stdout);
+    pcloudDestroy(pc);
+    int fails = (checked != points) + !(err_max <= MAX_ERR_M);
+    printf("%llu points checked against direct trig: max error %.1lf um (limit %.0lf um)\n",
+           (unsigned long long)checked, err_max * 1e6, MAX_ERR_M * 1e6);
+
+    // throughput of batching and conversion alone
+    pc = pcloudCreate(PCLOUD_PLY, FACETS, facet_elev, ANGLE0_DEG, SPAN_DEG);
+    if (pc == NULL) return -1;
+    double t0 = nowSec();
+    for (uint64_t i = 0; i < points; i++)
+    {
+        pcloudAdd(pc, in_facet[i], in_angle[i], in_range[i], 0.0);
+    }
+    pcloudFlush(pc);
+    double elapsed = nowSec() - t0;
+    pcloudDestroy(pc);
+    printf("conversion: %.2lf Mpts/s\n", points / elapsed * 1e-6);
+
+    fails += fileTest(PCLOUD_PLY, TEST_FILE ".ply");
+    fails += fileTest(PCLOUD_PCD, TEST_FILE ".pcd");
+
+    free(in_facet);
+    free(in_angle);
+    free(in_range);
+    printf("%s\n", fails ? "FAIL" : "OK");
+    return fails ? 1 : 0;
+}
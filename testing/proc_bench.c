@@ -0,0 +1,130 @@
+#define _GNU_SOURCE
+#include "tdc_util.h"
+#include "proc_pool.h"
+#include <string.h>
+#include <time.h>
+
+/** Compares sample processing throughput of the single-thread path with the processor pool.
+ *  Each job decodes a synthetic 17-byte TDC readout the way tdc_test does (register
+ *  conversion, ToF, distance and the CSV row), and the emit stage copies the result out as
+ *  the broadcast ring would. The emit stage also checks that jobs arrive in submission order.
+ *  Worker count 0 is the inline pool tdc_test uses by default, which should match the single
+ *  thread; workers only pay off if they beat it on the target, with its cores as isolated as
+ *  tdc_test -p leaves them. No TDC or pigpio initialisation is needed.
+ *  Usage: proc_bench.out [max_workers]
+ */
+
+#define JOBS 2000000
+#define POOL_SLOTS 1024
+#define CLK_FREQ (uint32_t)19.2e6 / 2
+
+struct BenchIn
+{
+    char raw[TDC_READOUT_LEN];
+    uint32_t id; // job number, checked by the emit stage
+};
+
+struct BenchOut
+{
+    uint32_t id;
+    uint16_t len;
+    char line[110];
+};
+
+static char sink[sizeof(struct BenchOut)]; // emit destination
+static uint64_t out_of_order;
+
+double nowSec()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+void fillReadout(struct BenchIn* in, uint32_t id)
+{
+    // plausible mode 2 register values; TIME1 varies so formatting does not repeat
+    uint32_t regs[TDC_MEAS_NUM_REGS] = {1000 + id % 5000, 3, 800, 900, 4700};
+    for (uint8_t i = 0; i < TDC_MEAS_NUM_REGS; i++)
+    {
+        char* p = in->raw + tdc_readout_idx[i];
+        p[0] = regs[i] >> 16;
+        p[1] = regs[i] >> 8;
+        p[2] = regs[i];
+    }
+    in->id = id;
+}
+
+void decode(void* in_v, void* out_v, void* arg)
+{
+    (void)arg;
+    struct BenchIn* in = (struct BenchIn*)in_v;
+    struct BenchOut* out = (struct BenchOut*)out_v;
+    uint32_t tdc_data[TDC_MEAS_NUM_REGS];
+
+    for (uint8_t i = 0; i < TDC_MEAS_NUM_REGS; i++)
+    {
+        tdc_data[i] = convertSubsetToLong(in->raw + tdc_readout_idx[i], 3, true) & 0x7FFFFF;
+    }
+    double tof = calcToF(tdc_data, 2, CLK_FREQ);
+    double dist = calcDist(tof);
+    out->len = sprintf(out->line, "%lf,%lf,%lf,%u,%u,%u,%u,%u,%u,%u\n", 1.7e9 + in->id * 2e-4, dist, tof * 1e6,
+                       tdc_data[0], tdc_data[1], tdc_data[2], tdc_data[3], tdc_data[4], 0, 2);
+    out->id = in->id;
+}
+
+void emit(void* out_v, uint64_t seq, void* arg)
+{
+    (void)arg;
+    struct BenchOut* out = (struct BenchOut*)out_v;
+    if (out->id != (uint32_t)seq) out_of_order++;
+    memcpy(sink, out, sizeof(sink));
+}
+
+int main(int argc, char** argv)
+{
+    int max_workers = (argc > 1) ? atoi(argv[1]) : 4;
+    if (max_workers > PROC_MAX_WORKERS) max_workers = PROC_MAX_WORKERS;
+
+    // single-thread path: decode and emit on the producer thread
+    struct BenchIn in;
+    struct BenchOut out;
+    double start = nowSec();
+    for (uint32_t i = 0; i < JOBS; i++)
+    {
+        fillReadout(&in, i);
+        decode(&in, &out, NULL);
+        emit(&out, i, NULL);
+    }
+    double single = JOBS / (nowSec() - start);
+    printf("single thread : %10.0f samples/s\n", single);
+
+    for (int workers = 0; workers <= max_workers; workers++)
+    {
+        out_of_order = 0;
+        proc_pool_t* pool = procPoolCreate(POOL_SLOTS, sizeof(struct BenchIn), sizeof(struct BenchOut),
+                                           workers, &decode, &emit, NULL);
+        if (pool == NULL || procPoolStart(pool, NULL) < 0)
+        {
+            printf("pool with %d workers failed to start\n", workers);
+            return -1;
+        }
+
+        start = nowSec();
+        for (uint32_t i = 0; i < JOBS; i++)
+        {
+            fillReadout((struct BenchIn*)procPoolClaim(pool), i);
+            procPoolSubmit(pool);
+        }
+        procPoolDrain(pool);
+        double rate = JOBS / (nowSec() - start);
+
+        printf("pool, %d worker%s: %10.0f samples/s (x%.2f), out of order: %llu\n", workers, workers != 1 ? "s" : " ",
+               rate, rate / single, (unsigned long long)out_of_order);
+        procPoolPrintStats(pool, stdout);
+
+        procPoolStop(pool);
+        procPoolDestroy(pool);
+    }
+    return 0;
+}
@@ -0,0 +1,125 @@
+#include <math.h>
+#include "scan_phase.h"
+
+/** Simulates a polygon mirror feeding the scan phase estimator and checks the angles it reports.
+ *  The mirror turns at from_rpm, steps to to_rpm at STEP_SEC and runs on until SIM_SEC. Its
+ *  facets are slightly unequal (FACET_ERR). SOS edges are timestamped at the 1 us resolution of
+ *  pigpio's sampling and delivered in order with up to ALERT_LATENCY_USEC of delay, like pigpio
+ *  alerts. A shot every SHOT_USEC asks for its facet and angle, which are compared with the
+ *  mirror's true position. Angles reported as valid must stay within MAX_ERR_DEG of the truth,
+ *  except:
+ *    - in the first SETTLE_SEC, while the facet widths are learned; angles are withheld until
+ *      the edges match them to within the lock limit anyway
+ *    - between the step and the delivery of the first edge after it, when no estimator can
+ *      know of the step yet; the worst error there is printed but not checked
+ *  The estimator must have locked, and be locked again at the end.
+ *  Usage: scan_phase_sim.out [from_rpm to_rpm]
+ *  Build: gcc -O2 -I.. scan_phase_sim.c ../scan_phase.c -o scan_phase_sim.out -lm
+ */
+
+#define FACETS 6
+#define FACET_ERR {0.002, -0.0015, 0.001, -0.002, 0.0005, 0.0} // facet widths relative to the mean
+#define FROM_RPM 3000.0
+#define TO_RPM 4000.0
+#define STEP_SEC 4.0
+#define SIM_SEC 8.0
+#define SETTLE_SEC 2.0          // facet widths learned; errors before this are not checked
+#define SHOT_USEC 100
+#define ALERT_LATENCY_USEC 1000
+#define TICK0 0xFFF00000u       // the tick wraps during the run
+#define MAX_ERR_DEG 2.0
+
+int main(int argc, char** argv)
+{
+    double from_rpm = (argc > 2) ? atof(argv[1]) : FROM_RPM;
+    double to_rpm = (argc > 2) ? atof(argv[2]) : TO_RPM;
+    static const double facet_err[FACETS] = FACET_ERR;
+    double bound[FACETS + 1] = {0}; // facet boundaries in revolutions
+    for (int f = 0; f < FACETS; f++)
+    {
+        bound[f + 1] = bound[f] + (1.0 + facet_err[f]) / FACETS;
+    }
+
+    scan_phase_t phase;
+    scanPhaseInit(&phase, FACETS);
+    srand(1);
+
+    // edges waiting for delivery
+    uint32_t pending[64];
+    uint32_t due[64];
+    int head = 0, tail = 0;
+    uint32_t last_due = 0;
+
+    double rev = 0.3;           // mirror position in revolutions
+    int facet_now = 1;          // facet under the beam: bound[facet_now - 1] <= frac(rev) < bound[facet_now]
+    while (facet_now < FACETS && rev >= bound[facet_now]) facet_now++;
+    long edges = 0;
+    long shots = 0, valid = 0, checked = 0, bad = 0;
+    double err_max = 0, err_max_t = 0, blind_max = 0, unlocked_sec = 0;
+    double first_valid = -1;
+    bool step_seen = false;     // an edge after the step has been delivered
+    uint32_t first_facet = 0;
+    const double sim_usec = SIM_SEC * 1e6;
+    for (uint32_t usec = 0; usec < sim_usec; usec++)
+    {
+        double t = usec * 1e-6;
+        uint32_t tick = TICK0 + usec;
+        rev += ((t < STEP_SEC) ? from_rpm : to_rpm) / 60.0 * 1e-6;
+        double frac = rev - floor(rev);
+        int facet = 1;
+        while (facet < FACETS && frac >= bound[facet]) facet++;
+        if (facet != facet_now) // SOS edge, sampled on this tick
+        {
+            if (edges++ == 0) first_facet = facet;
+            uint32_t when = usec + rand() % ALERT_LATENCY_USEC;
+            last_due = (when > last_due) ? when : last_due;
+            pending[tail % 64] = tick;
+            due[tail++ % 64] = last_due;
+            facet_now = facet;
+        }
+        while (head < tail && due[head % 64] <= usec)
+        {
+            step_seen |= (pending[head % 64] - TICK0 >= STEP_SEC * 1e6);
+            scanPhaseUpdate(&phase, pending[head++ % 64]);
+        }
+        if (usec % SHOT_USEC != 0 || edges == 0) continue;
+
+        shots++;
+        scan_angle_t angle = scanPhaseAngle(&phase, tick, 0.0);
+        if (!angle.valid)
+        {
+            if (t > SETTLE_SEC) unlocked_sec += SHOT_USEC * 1e-6;
+            continue;
+        }
+        if (valid++ == 0) first_valid = t;
+        if (t < SETTLE_SEC) continue;
+
+        // true facet counted from the first edge, and optical angle within it
+        int true_facet = (facet_now - first_facet + FACETS) % FACETS;
+        double true_deg = (frac - bound[facet_now - 1]) / (bound[facet_now] - bound[facet_now - 1]) * 720.0 / FACETS;
+        double err = ((int)angle.facet - true_facet) * 720.0 / FACETS + (angle.angle_deg - true_deg);
+        err = remainder(err, 720.0);
+        if (t >= STEP_SEC && !step_seen)
+        {
+            blind_max = fmax(blind_max, fabs(err));
+            continue;
+        }
+        checked++;
+        if (fabs(err) > MAX_ERR_DEG) bad++;
+        if (fabs(err) > err_max)
+        {
+            err_max = fabs(err);
+            err_max_t = t;
+        }
+    }
+    printf("%.0lf -> %.0lf rpm at %.1lf s: %ld edges, %llu slips, final period %.2lf us, jitter %.2lf us\n",
+           from_rpm, to_rpm, STEP_SEC, edges, (unsigned long long)phase.slips, phase.period_usec, phase.jitter_usec);
+    printf("%ld shots, %ld valid; after %.1lf s: %ld checked, worst error %.3lf deg at %.4lf s, %ld beyond %.1lf deg, "
+           "%.1lf ms without an angle\n", shots, valid, SETTLE_SEC, checked, err_max, err_max_t, bad, MAX_ERR_DEG,
+           unlocked_sec * 1e3);
+    printf("first angle at %.3lf s, worst error before the step was seen: %.3lf deg, %s at the end\n", first_valid,
+           blind_max, scanPhaseLocked(&phase) ? "locked" : "NOT locked");
+    int fails = (bad > 0) + (checked == 0) + !scanPhaseLocked(&phase);
+    printf("%s\n", fails ? "FAIL" : "OK");
+    return fails ? 1 : 0;
+}
@@ -0,0 +1,111 @@
+#include <unistd.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "sample_shm.h"
+
+/** Example client of the shared-memory sample ring published by tdc_test.
+ *  Usage: shm_reader.out [self]
+ *  Prints a summary of the samples read each second. With "self", a producer thread in this
+ *  process publishes synthetic samples instead, which checks the sequence protocol without
+ *  the acquisition program.
+ *  Build: gcc -O2 -I.. shm_reader.c ../sample_shm.c -o shm_reader.out -pthread -lrt
+ */
+
+#define READ_BATCH 256
+#define IDLE_USEC 1000
+#define SELF_SAMPLES 20000000 // samples published in self mode
+
+void* selfProducer(void* arg)
+{
+    sample_shm_t* shm = (sample_shm_t*)arg;
+    sample_shm_slot_t sample;
+    memset(&sample, 0, sizeof(sample));
+
+    for (uint32_t i = 0; i < SELF_SAMPLES; i++)
+    {
+        sample.time = i;
+        sample.raw[0] = i;
+        sample.raw[4] = ~i; // checked by the reader to catch torn copies
+        sample.flags = SAMPLE_FLAG_VALID;
+        sampleShmPublish(shm, &sample);
+    }
+    return NULL;
+}
+
+int main(int argc, char** argv)
+{
+    bool self = argc > 1 && strcmp(argv[1], "self") == 0;
+    const char* name = self ? "/tdc_samples_self" : SAMPLE_SHM_NAME;
+
+    sample_shm_t* producer = NULL;
+    pthread_t producer_tid;
+    if (self)
+    {
+        producer = sampleShmCreate(name, SAMPLE_SHM_SLOTS);
+        if (producer == NULL) return -1;
+    }
+
+    sample_shm_t* shm = sampleShmOpen(name);
+    if (shm == NULL)
+    {
+        printf("No sample ring at %s; is tdc_test running?\n", name);
+        return -1;
+    }
+    printf("Attached: %u slots, producer started at %llu usec\n",
+           shm->hdr->slot_count, (unsigned long long)shm->hdr->start_usec);
+
+    if (self)
+    {
+        pthread_create(&producer_tid, NULL, &selfProducer, producer);
+    }
+
+    static sample_shm_slot_t batch[READ_BATCH];
+    uint64_t total = 0, valid = 0, torn = 0, expected = shm->cursor;
+    uint64_t skipped = 0; // gaps in sample numbers, which must equal shm->lost
+    double dist_sum = 0;
+    time_t last_report = time(NULL);
+
+    while (1)
+    {
+        int n = sampleShmRead(shm, batch, READ_BATCH);
+        if (n < 0) break; // producer closed the ring
+        if (n == 0)
+        {
+            if (self && total + shm->lost >= SELF_SAMPLES) break;
+            usleep(IDLE_USEC);
+        }
+
+        for (int i = 0; i < n; i++)
+        {
+            uint64_t seq = atomic_load(&batch[i].seq);
+            skipped += seq - expected;
+            expected = seq + 1;
+            total++;
+            if (batch[i].flags & SAMPLE_FLAG_VALID)
+            {
+                valid++;
+                dist_sum += batch[i].dist;
+            }
+            if (self && (batch[i].raw[0] != (uint32_t)seq || batch[i].raw[4] != ~(uint32_t)seq)) torn++;
+        }
+
+        if (time(NULL) != last_report)
+        {
+            last_report = time(NULL);
+            printf("read %llu (valid %llu, mean dist %.3lf m), lost %llu\n", (unsigned long long)total,
+                   (unsigned long long)valid, valid ? dist_sum / valid : 0.0, (unsigned long long)shm->lost);
+        }
+    }
+
+    printf("total read %llu, lost %llu, gaps %llu, torn %llu\n", (unsigned long long)total,
+           (unsigned long long)shm->lost, (unsigned long long)skipped, (unsigned long long)torn);
+
+    if (self)
+    {
+        pthread_join(producer_tid, NULL);
+        sampleShmDestroy(producer);
+    }
+    sampleShmClose(shm);
+    return 0;
+}
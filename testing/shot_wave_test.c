@@ -0,0 +1,63 @@
+#include "shot_wave.h"
+
+/** Builds the shot waveform used by tdc_test.c and replays its pulse steps
+ *  on a simulated GPIO bank, printing every level change with its time.
+ *  A wave with START on the laser pin must be refused.
+ *  No pigpio calls are made, so this runs without hardware.
+ */
+
+#define LASER_PULSE_PIN 23 // as in tdc_test.c
+#define TDC_START_PIN 24
+
+int main(int argc, char** argv)
+{
+    shot_wave_t wave = {
+        .laser_pin = LASER_PULSE_PIN,
+        .start_pin = TDC_START_PIN,
+        .laser_pol = 1,
+        .pulse_count = 2,
+        .pulse_period_us = 200, // 5 kHz trigger train
+        .start_pulse = 1,
+        .start_delay_us = 25,
+        .wave_id = -1};
+    if (argc > 1) wave.pulse_period_us = atoi(argv[1]);
+
+    gpioPulse_t pulses[SHOT_WAVE_MAX_STEPS(&wave)];
+    int n = shotWaveBuild(&wave, pulses, SHOT_WAVE_MAX_STEPS(&wave));
+    printf("steps=%d shot_len=%u us\n", n, shotWaveLengthUs(&wave));
+    if (n < 0) return 1;
+
+    // replay steps on a simulated level register
+    uint32_t levels = 0;
+    uint32_t t_us = 0;
+    uint32_t start_rise_us = 0;
+    uint32_t laser_rise_us[2] = {0};
+    int laser_rises = 0;
+    for (int i = 0; i < n; i++)
+    {
+        uint32_t prev = levels;
+        levels = (levels | pulses[i].gpioOn) & ~pulses[i].gpioOff;
+
+        printf("t=%6u us laser=%d start=%d\n", t_us,
+               (levels >> LASER_PULSE_PIN) & 1, (levels >> TDC_START_PIN) & 1);
+
+        if (!(prev >> LASER_PULSE_PIN & 1) && (levels >> LASER_PULSE_PIN & 1) && laser_rises < 2)
+            laser_rise_us[laser_rises++] = t_us;
+        if (!(prev >> TDC_START_PIN & 1) && (levels >> TDC_START_PIN & 1))
+            start_rise_us = t_us;
+
+        t_us += pulses[i].usDelay;
+    }
+
+    // START on the laser pin would have no edge of its own
+    shot_wave_t shared = wave;
+    shared.start_pin = shared.laser_pin;
+    int shared_steps = shotWaveBuild(&shared, pulses, SHOT_WAVE_MAX_STEPS(&shared));
+    printf("START on the laser pin: steps=%d\n", shared_steps);
+
+    bool pass = (t_us == shotWaveLengthUs(&wave)) &&
+                (start_rise_us - laser_rise_us[wave.start_pulse] == wave.start_delay_us) &&
+                !(levels >> TDC_START_PIN & 1) && shared_steps < 0;
+    printf("%s\n", pass ? "PASS" : "FAIL");
+    return !pass;
+}
@@ -0,0 +1,112 @@
+#include <pthread.h>
+#include <pigpio.h>
+#include "sos.h"
+
+/** Off-target check of the start-of-scan seqlock.
+ *  pigpio is stubbed: sosStart() registers its alert with the gpioSetAlertFuncEx() below, and a
+ *  writer thread then calls it as pigpio's alert thread would, with active and inactive edges
+ *  PERIOD_USEC apart. A reader thread takes snapshots with sosRead() meanwhile and checks that
+ *  every one is a single edge's state:
+ *    - tick is that of edge number edges, and period_usec is PERIOD_USEC from the second edge
+ *    - the scan phase has seen the same edges and holds the same latest tick
+ *  A snapshot mixing two edges breaks one of these.
+ *  Usage: sos_seqlock_test.out [edges]
+ *  Build: gcc -O2 -I.. sos_seqlock_test.c ../sos.c ../scan_phase.c -o sos_seqlock_test.out -pthread -lm
+ *  (no -lpigpio; the functions sos.c needs are defined here)
+ */
+
+#define EDGES 20000000
+#define SOS_PIN 17
+#define SOS_LEVEL 1
+#define FACETS 6
+#define PERIOD_USEC 1667 // 6000 rpm on a hexagon
+#define TICK0 0xFFFF0000u // the tick wraps early in the run
+
+static gpioAlertFuncEx_t alert_fn;
+static void* alert_arg;
+static atomic_bool writing = true;
+
+int gpioSetMode(unsigned gpio, unsigned mode)
+{
+    (void)gpio, (void)mode;
+    return 0;
+}
+
+int gpioGlitchFilter(unsigned user_gpio, unsigned steady)
+{
+    (void)user_gpio, (void)steady;
+    return 0;
+}
+
+int gpioSetAlertFuncEx(unsigned user_gpio, gpioAlertFuncEx_t f, void* userdata)
+{
+    (void)user_gpio;
+    alert_fn = f;
+    alert_arg = userdata;
+    return 0;
+}
+
+static void* writerThread(void* arg)
+{
+    uint64_t edges = *(uint64_t*)arg;
+    uint32_t tick = TICK0;
+    for (uint64_t n = 0; n < edges; n++, tick += PERIOD_USEC)
+    {
+        alert_fn(SOS_PIN, SOS_LEVEL, tick, alert_arg);
+        alert_fn(SOS_PIN, !SOS_LEVEL, tick + PERIOD_USEC / 2, alert_arg); // ignored by sosAlert()
+    }
+    atomic_store(&writing, false);
+    return NULL;
+}
+
+int main(int argc, char** argv)
+{
+    uint64_t edges = (argc > 1) ? strtoull(argv[1], NULL, 10) : EDGES;
+    sos_t* sos = sosCreate(SOS_PIN, SOS_LEVEL, FACETS, 0);
+    if (sos == NULL || sosStart(sos) < 0 || alert_fn == NULL)
+    {
+        perror("sosStart");
+        return -1;
+    }
+
+    pthread_t writer;
+    if (pthread_create(&writer, NULL, &writerThread, &edges) != 0)
+    {
+        perror("pthread_create");
+        return -1;
+    }
+
+    uint64_t snapshots = 0, empty = 0, torn = 0;
+    sos_state_t state;
+    while (atomic_load(&writing))
+    {
+        if (!sosRead(sos, &state))
+        {
+            empty++;
+            continue;
+        }
+        snapshots++;
+        uint32_t tick = TICK0 + (uint32_t)((state.edges - 1) * PERIOD_USEC);
+        bool consistent = state.tick == tick &&
+                          state.period_usec == (state.edges > 1 ? PERIOD_USEC : 0) &&
+                          state.phase.edges == state.edges &&
+                          state.phase.last_tick == tick;
+        if (!consistent && torn++ < 10)
+        {
+            printf("  torn snapshot: edges %llu tick %u period %u phase edges %llu phase tick %u\n",
+                   (unsigned long long)state.edges, state.tick, state.period_usec,
+                   (unsigned long long)state.phase.edges, state.phase.last_tick);
+        }
+    }
+    pthread_join(writer, NULL);
+
+    sosRead(sos, &state);
+    sosPrintStats(sos, stdout);
+    bool complete = (state.edges == edges) && scanPhaseLocked(&state.phase) && state.phase.slips == 0;
+    printf("%llu edges written, %llu snapshots (%llu before the first edge), %llu torn%s\n",
+           (unsigned long long)state.edges, (unsigned long long)snapshots, (unsigned long long)empty,
+           (unsigned long long)torn, complete ? "" : ", EDGES MISSING");
+    sosDestroy(sos);
+    printf("%s\n", (torn || !complete) ? "FAIL" : "OK");
+    return (torn || !complete) ? 1 : 0;
+}
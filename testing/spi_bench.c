@@ -0,0 +1,74 @@
+#include "tdc_util.h"
+#include <time.h>
+
+/** Compares pigpio and spidev SPI backends on TDC transaction latency.
+ *  Each backend performs ITERATIONS of:
+ *    - a 2-byte CONFIG2 read (single transaction)
+ *    - the 17-byte measurement readout (two auto-increment transactions)
+ *  Usage: spi_bench.out [baud]
+ */
+
+#define TDC_CLK_PIN 4
+#define TDC_ENABLE_PIN 27
+#define TDC_INT_PIN 22
+#define TDC_CLK_FREQ (uint32_t)19.2e6 / 2
+#define ITERATIONS 10000
+
+double nowSec()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+void benchBackend(enum TDC_SPI_BACKEND backend, const char* name, int baud)
+{
+    tdc_t tdc = {
+        .enable_pin = TDC_ENABLE_PIN,
+        .int_pin = TDC_INT_PIN,
+        .clk_pin = TDC_CLK_PIN,
+        .clk_freq = TDC_CLK_FREQ,
+        .spi_backend = backend};
+    if (tdcInit(&tdc, baud) < 0)
+    {
+        printf("%s: init failed\n", name);
+        return;
+    }
+    gpioWrite(tdc.enable_pin, 0);
+    gpioDelay(3);
+    gpioWrite(tdc.enable_pin, 1);
+
+    char tx[17] = {TDC_CMD(0, 0, TDC_CONFIG2)};
+    char rx[17];
+    double t0 = nowSec();
+    for (int i = 0; i < ITERATIONS; i++)
+    {
+        tdcSpiXfer(&tdc, tx, rx, 2);
+    }
+    double t1 = nowSec();
+    printf("%-7s single 2-byte xfer:  %7.2f us\n", name, (t1 - t0) * 1e6 / ITERATIONS);
+
+    char readout_tx[17] = {[0] = TDC_CMD(1, 0, TDC_TIME1), [10] = TDC_CMD(1, 0, TDC_CALIBRATION1)};
+    const unsigned lens[2] = {10, 7};
+    t0 = nowSec();
+    for (int i = 0; i < ITERATIONS; i++)
+    {
+        tdcSpiXferBatch(&tdc, readout_tx, rx, lens, 2);
+    }
+    t1 = nowSec();
+    printf("%-7s 17-byte readout:     %7.2f us\n", name, (t1 - t0) * 1e6 / ITERATIONS);
+
+    tdcClose(&tdc);
+}
+
+int main(int argc, char** argv)
+{
+    int baud = (argc > 1) ? atoi(argv[1]) : (int)(250E6 / 64);
+    printf("baud=%d\n", baud);
+
+    benchBackend(TDC_SPI_PIGPIO, "pigpio", baud);
+    benchBackend(TDC_SPI_SPIDEV, "spidev", baud);
+
+    gpioTerminate();
+    return 0;
+}
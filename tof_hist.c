@@ -0,0 +1,497 @@
+#include "tof_hist.h"
+#include <string.h>
+#include <math.h>
+
+tof_hist_t* tofHistCreate(uint32_t bins, double bin_sec, double tof_min, double window_sec, uint32_t facets,
+                          uint32_t angle_bins, double angle0_deg, double span_deg, hist_emit_fn emit, void* arg)
+{
+    if (bins == 0 || bin_sec <= 0 || window_sec <= 0) return NULL;
+    if (facets > 0 && (angle_bins == 0 || span_deg <= 0)) return NULL;
+
+    tof_hist_t* hist = (tof_hist_t*)calloc(1, sizeof(tof_hist_t));
+    if (hist == NULL) return NULL;
+
+    hist->bins = bins;
+    hist->row = (bins + 15) & ~15u; // 16 bins per 64 byte line
+    hist->bin_sec = bin_sec;
+    hist->tof_min = tof_min;
+    hist->facets = facets;
+    hist->angle_bins = facets ? angle_bins : 1;
+    hist->angle0_deg = angle0_deg;
+    hist->angle_scale = facets ? angle_bins / span_deg : 0;
+    hist->groups = facets ? facets * angle_bins : 1;
+    hist->window_sec = window_sec;
+    hist->emit = emit;
+    hist->arg = arg;
+
+    hist->next_group = hist->groups;
+
+    hist->counts = (uint32_t*)aligned_alloc(64, sizeof(uint32_t) * hist->row * hist->groups);
+    hist->shots = (uint32_t*)calloc(hist->groups, sizeof(uint32_t));
+    hist->closed = (uint32_t*)aligned_alloc(64, sizeof(uint32_t) * hist->row * hist->groups);
+    hist->closed_shots = (uint32_t*)calloc(hist->groups, sizeof(uint32_t));
+    hist->dark = (uint32_t*)calloc(bins, sizeof(uint32_t));
+    hist->ref_counts = (uint32_t*)calloc(bins, sizeof(uint32_t));
+    hist->ref = (float*)calloc(bins, sizeof(float));
+    if (hist->counts == NULL || hist->shots == NULL || hist->closed == NULL || hist->closed_shots == NULL ||
+        hist->dark == NULL || hist->ref_counts == NULL || hist->ref == NULL)
+    {
+        tofHistDestroy(hist);
+        return NULL;
+    }
+    memset(hist->counts, 0, sizeof(uint32_t) * hist->row * hist->groups);
+    memset(hist->closed, 0, sizeof(uint32_t) * hist->row * hist->groups);
+    return hist;
+} // end tofHistCreate()
+
+// Expected background of bin b for a histogram of shots shots; mean is used without a reference
+static inline double histBackground(const tof_hist_t* hist, uint32_t b, uint32_t shots, double mean)
+{
+    return hist->ref_shots ? hist->ref[b] * shots : mean;
+}
+
+// log10 P(X >= k) for X Poisson with mean lambda; 0 (not significant) if k is not above the mean
+static double histPoissonTail(uint64_t k, double lambda)
+{
+    if (k <= lambda) return 0.0;
+    double log_term = -lambda + k * log(lambda) - lgamma(k + 1.0);
+    double term = 1.0, sum = 1.0;
+    for (uint64_t j = k; j < k + HIST_TAIL_TERMS && term > 1e-12 * sum; j++)
+    {
+        term *= lambda / (j + 1);
+        sum += term;
+    }
+    return (log_term + log(sum)) / M_LN10;
+}
+
+// log10 P(X >= k) for X binomial over n trials of probability p; 0 if k is not above the mean
+static double histBinomialTail(uint64_t k, uint64_t n, double p)
+{
+    if (k <= n * p) return 0.0;
+    double log_term = lgamma(n + 1.0) - lgamma(k + 1.0) - lgamma(n - k + 1.0) + k * log(p) + (n - k) * log1p(-p);
+    double odds = p / (1 - p), term = 1.0, sum = 1.0;
+    for (uint64_t j = k; j < n && j < k + HIST_TAIL_TERMS && term > 1e-12 * sum; j++)
+    {
+        term *= (double)(n - j) / (j + 1) * odds;
+        sum += term;
+    }
+    return (log_term + log(sum)) / M_LN10;
+}
+
+/**log10 of the chance that background alone gives at least k counts over bins whose reference
+ * holds ref counts and whose expected background is bg, for a histogram of shots shots
+ */
+static double histTail(const tof_hist_t* hist, uint64_t k, uint64_t ref, double bg, uint32_t shots)
+{
+    if (hist->ref_shots)
+    {
+        return histBinomialTail(k, k + ref, (double)shots / ((double)shots + hist->ref_shots));
+    }
+    return histPoissonTail(k, bg);
+}
+
+// Background-subtracted counts of bin b; *flagged is set if they are significant (log10 P below log_alpha)
+static inline double histNet(const tof_hist_t* hist, const uint32_t* counts, uint32_t b, uint32_t shots,
+                             double mean, double var_gain, double log_alpha, double* bg, bool* flagged)
+{
+    *bg = histBackground(hist, b, shots, mean);
+    double net = counts[b] - *bg;
+    // screen without a square root: net >= HIST_SCREEN_SIGMA sigmas, and at least half a count
+    *flagged = net >= 0.5 && net * net >= HIST_SCREEN_SIGMA * HIST_SCREEN_SIGMA * *bg * var_gain &&
+               histTail(hist, counts[b], hist->ref_counts[b], *bg, shots) <= log_alpha;
+    return net;
+}
+
+/**First bin from b on that passes the screen of histNet() and holds at least k_min counts, or
+ * bins if none does. The bins between returns are most of a histogram, so this loop keeps what
+ * it reads in locals; without a reference the screen is k_min alone.
+ */
+static uint32_t histScreen(const tof_hist_t* hist, const uint32_t* counts, uint32_t b, uint32_t shots, double screen,
+                           uint32_t k_min)
+{
+    const uint32_t bins = hist->bins;
+    if (!hist->ref_shots)
+    {
+        while (b < bins && counts[b] < k_min) b++;
+        return b;
+    }
+    const float* ref = hist->ref;
+    for (; b < bins; b++)
+    {
+        if (counts[b] < k_min) continue;
+        double bg = ref[b] * (double)shots;
+        double net = counts[b] - bg;
+        if (net >= 0.5 && net * net >= screen * bg) return b;
+    }
+    return bins;
+}
+
+int tofHistPeaks(const tof_hist_t* hist, const uint32_t* counts, uint32_t shots, hist_peak_t* peaks, int max_peaks)
+{
+    uint64_t total = 0;
+    for (uint32_t b = 0; b < hist->bins; b++) total += counts[b];
+    if (total == 0) return 0;
+
+    double mean = (double)total / hist->bins;
+    // a scaled reference carries its own Poisson noise, scaled by shots / ref_shots
+    double var_gain = hist->ref_shots ? 1.0 + (double)shots / hist->ref_shots : 1.0;
+    double log_alpha = log10(HIST_FALSE_ALARM / hist->bins); // every bin is searched
+
+    int npeaks = 0;
+    uint32_t floor_bin = 0; // first bin not yet part of a return
+    uint32_t b = 0;
+    double bg;
+    bool flagged;
+    // smallest count that can be flagged: without a reference, the one passing the screen over the
+    // mean; with one, k counts over none in the reference have a tail of p^k, and reference
+    // counts only raise it, so fewer than k_min counts cannot pass whatever the reference holds
+    const double screen = HIST_SCREEN_SIGMA * HIST_SCREEN_SIGMA * var_gain;
+    double k_min = ceil(mean + fmax(0.5, sqrt(screen * mean)) - 1e-9);
+    if (hist->ref_shots)
+    {
+        k_min = ceil(log_alpha / log10((double)shots / ((double)shots + hist->ref_shots)) - 1e-9);
+    }
+    while (b < hist->bins)
+    {
+        b = histScreen(hist, counts, b, shots, screen, (uint32_t)fmin(k_min, UINT32_MAX));
+        if (b == hist->bins) break;
+        histNet(hist, counts, b, shots, mean, var_gain, log_alpha, &bg, &flagged);
+        if (!flagged)
+        {
+            b++;
+            continue;
+        }
+
+        // cluster: flagged bins until more than HIST_MERGE_BINS unflagged bins in a row
+        uint32_t first = b, last = b;
+        for (b++; b < hist->bins && b - last <= HIST_MERGE_BINS + 1; b++)
+        {
+            histNet(hist, counts, b, shots, mean, var_gain, log_alpha, &bg, &flagged);
+            if (flagged) last = b;
+        }
+
+        uint32_t lo = (first > floor_bin + HIST_CENTROID_BINS) ? first - HIST_CENTROID_BINS : floor_bin;
+        uint32_t hi = (last + HIST_CENTROID_BINS < hist->bins) ? last + HIST_CENTROID_BINS : hist->bins - 1;
+        floor_bin = hi + 1;
+        double w_sum = 0, x_sum = 0, xx_sum = 0, bg_sum = 0, net_sum = 0;
+        uint32_t in_peak = 0;
+        uint64_t ref_sum = 0;
+        for (uint32_t i = lo; i <= hi; i++)
+        {
+            double net = histNet(hist, counts, i, shots, mean, var_gain, log_alpha, &bg, &flagged);
+            if (net > 0) // centroid and width of the counts above the background
+            {
+                double x = (double)i - first + 0.5; // relative to the cluster for precision
+                w_sum += net;
+                x_sum += net * x;
+                xx_sum += net * x * x;
+            }
+            in_peak += counts[i];
+            ref_sum += hist->ref_counts[i];
+            bg_sum += bg;
+            net_sum += net;
+        }
+        double centre = x_sum / w_sum;
+        hist_peak_t peak = {
+            .tof = hist->tof_min + (first + centre) * hist->bin_sec,
+            .amplitude = net_sum,
+            .width = sqrt(fmax(xx_sum / w_sum - centre * centre, 0.0) + 1.0 / 12) * hist->bin_sec,
+            .counts = in_peak,
+            .background = bg_sum / (hi - lo + 1),
+            .log_p = histTail(hist, in_peak, ref_sum, bg_sum, shots)};
+
+        if (peak.log_p > log_alpha) continue; // a few flagged bins over a deficit; not a target
+
+        // keep the strongest max_peaks, strongest first
+        int i = (npeaks < max_peaks) ? npeaks++ : max_peaks;
+        for (; i > 0 && peaks[i - 1].amplitude < peak.amplitude; i--)
+        {
+            if (i < max_peaks) peaks[i] = peaks[i - 1];
+        }
+        if (i < max_peaks) peaks[i] = peak;
+    }
+    return npeaks;
+} // end tofHistPeaks()
+
+// Moves next_group past histograms of the closed window that received no shots
+static inline void tofHistSkipEmpty(tof_hist_t* hist)
+{
+    while (hist->next_group < hist->groups && hist->closed_shots[hist->next_group] == 0) hist->next_group++;
+}
+
+// Emits the next histogram of the closed window that received shots; false once none is left
+static bool tofHistEmitNext(tof_hist_t* hist)
+{
+    tofHistSkipEmpty(hist);
+    if (hist->next_group == hist->groups) return false;
+
+    uint32_t g = hist->next_group++;
+    uint32_t* counts = hist->closed + (size_t)g * hist->row;
+    hist_peak_t peaks[HIST_MAX_PEAKS];
+    int npeaks = tofHistPeaks(hist, counts, hist->closed_shots[g], peaks, HIST_MAX_PEAKS);
+    if (hist->emit != NULL)
+    {
+        hist->emit(hist, hist->closed_start, g, counts, hist->closed_shots[g], peaks, npeaks, hist->arg);
+    }
+    hist->returns += npeaks;
+    memset(counts, 0, sizeof(uint32_t) * hist->bins);
+    hist->closed_shots[g] = 0;
+    tofHistSkipEmpty(hist); // so next_group == groups as soon as the window is done
+    return true;
+} // end tofHistEmitNext()
+
+// Swaps the current window into the closed buffers; the last closed window must be fully emitted
+static void tofHistClose(tof_hist_t* hist)
+{
+    uint32_t* counts = hist->closed;
+    uint32_t* shots = hist->closed_shots;
+    hist->closed = hist->counts;
+    hist->closed_shots = hist->shots;
+    hist->counts = counts;
+    hist->shots = shots;
+    hist->closed_start = hist->window_start;
+    hist->next_group = 0;
+    hist->windows++;
+    hist->open = false;
+} // end tofHistClose()
+
+void tofHistFlush(tof_hist_t* hist)
+{
+    while (tofHistEmitNext(hist));
+    if (hist->open)
+    {
+        tofHistClose(hist);
+    }
+    while (tofHistEmitNext(hist));
+} // end tofHistFlush()
+
+void tofHistAdd(tof_hist_t* hist, double time, bool has_stop, double tof, bool has_angle, uint8_t facet,
+                float angle_deg)
+{
+    tofHistEmitNext(hist); // at most one histogram of the closed window per shot
+
+    // the window ends at the first shot past its end that finds the last window emitted; until
+    // then the shots carry on into it, as fewer shots than the last window had histograms to emit
+    if (hist->open && time - hist->window_start >= hist->window_sec)
+    {
+        if (hist->next_group == hist->groups)
+        {
+            tofHistClose(hist);
+        }
+        else
+        {
+            hist->overdue++;
+        }
+    }
+    if (!hist->open)
+    {
+        hist->open = true;
+        hist->window_start = time;
+    }
+
+    int32_t group = 0;
+    if (hist->facets > 0)
+    {
+        int32_t a = (int32_t)floorf((angle_deg - hist->angle0_deg) * hist->angle_scale);
+        group = (has_angle && facet < hist->facets && a >= 0 && (uint32_t)a < hist->angle_bins)
+                    ? (int32_t)(facet * hist->angle_bins + a) : -1;
+    }
+    if (group < 0)
+    {
+        hist->unplaced++;
+    }
+    else
+    {
+        hist->shots[group]++;
+        double pos = (tof - hist->tof_min) / hist->bin_sec;
+        if (has_stop && (pos < 0 || pos >= hist->bins))
+        {
+            hist->outside++;
+        }
+        else if (has_stop)
+        {
+            hist->counts[(size_t)group * hist->row + (uint32_t)pos]++;
+            hist->stops++;
+        }
+    }
+} // end tofHistAdd()
+
+void tofHistAddDark(tof_hist_t* hist, bool has_stop, double tof)
+{
+    hist->dark_shots++;
+    if (!has_stop) return;
+
+    double pos = (tof - hist->tof_min) / hist->bin_sec;
+    if (pos >= 0 && pos < hist->bins)
+    {
+        hist->dark[(uint32_t)pos]++;
+    }
+} // end tofHistAddDark()
+
+int tofHistSetReference(tof_hist_t* hist, const uint32_t* counts, uint32_t shots)
+{
+    if (shots == 0) return -1;
+    if (counts != hist->ref_counts)
+    {
+        memcpy(hist->ref_counts, counts, sizeof(uint32_t) * hist->bins);
+    }
+    for (uint32_t b = 0; b < hist->bins; b++)
+    {
+        hist->ref[b] = (float)counts[b] / shots;
+    }
+    hist->ref_shots = shots;
+    return 0;
+} // end tofHistSetReference()
+
+int tofHistUseDark(tof_hist_t* hist)
+{
+    if (tofHistSetReference(hist, hist->dark, hist->dark_shots) < 0) return -1;
+    memset(hist->dark, 0, sizeof(uint32_t) * hist->bins);
+    hist->dark_shots = 0;
+    return 0;
+} // end tofHistUseDark()
+
+int tofHistFormatRow(const tof_hist_t* hist, char* buf, double time, uint32_t group, const uint32_t* counts,
+                     uint32_t shots)
+{
+    uint32_t first = 0, last = hist->bins;
+    while (first < last && counts[first] == 0) first++;
+    while (last > first && counts[last - 1] == 0) last--;
+
+    int facet = hist->facets ? (int)(group / hist->angle_bins) : -1;
+    double angle = hist->facets ? tofHistGroupAngle(hist, group) : -999.0;
+    int len = sprintf(buf, "%lf,%u,%d,%.4lf,%u,%u,", time, group, facet, angle, shots, first);
+    for (uint32_t b = first; b < last; b++)
+    {
+        len += sprintf(buf + len, b + 1 < last ? "%u;" : "%u", counts[b]);
+    }
+    buf[len++] = '\n';
+    buf[len] = '\0';
+    return len;
+} // end tofHistFormatRow()
+
+int tofHistSaveReference(const tof_hist_t* hist, const char* path)
+{
+    if (hist->ref_shots == 0) return -1;
+
+    char* row = (char*)malloc(HIST_ROW_MAX(hist->bins));
+    FILE* file = fopen(path, "w");
+    if (row == NULL || file == NULL)
+    {
+        perror("tofHistSaveReference");
+        free(row);
+        if (file != NULL) fclose(file);
+        return -1;
+    }
+    fprintf(file, "# REFERENCE hist_bin_ns=%.4lf hist_bins=%u tof_min_ns=%.4lf shots=%u\n", hist->bin_sec * 1e9,
+            hist->bins, hist->tof_min * 1e9, hist->ref_shots);
+    fputs(HIST_ROW_HEADER, file);
+    // per-window layout so the file loads whatever the grouping of the loading run
+    tof_hist_t layout = *hist;
+    layout.facets = 0;
+    int len = tofHistFormatRow(&layout, row, 0.0, 0, hist->ref_counts, hist->ref_shots);
+    fwrite(row, 1, len, file);
+    free(row);
+    return fclose(file) == 0 ? 0 : -1;
+} // end tofHistSaveReference()
+
+int tofHistLoadReference(tof_hist_t* hist, const char* path)
+{
+    FILE* file = fopen(path, "r");
+    if (file == NULL)
+    {
+        perror("tofHistLoadReference");
+        return -1;
+    }
+
+    uint32_t* counts = (uint32_t*)calloc(hist->bins, sizeof(uint32_t));
+    uint64_t shots = 0;
+    char* line = NULL;
+    size_t cap = 0;
+    int status = (counts != NULL) ? 0 : -1;
+    while (status == 0 && getline(&line, &cap, file) > 0)
+    {
+        if (line[0] == '#') // config records; the binning must match ours
+        {
+            const char* bin_ns = strstr(line, "hist_bin_ns=");
+            if (bin_ns != NULL && fabs(atof(bin_ns + 12) - hist->bin_sec * 1e9) > 1e-3)
+            {
+                fprintf(stderr, "tofHistLoadReference: %s has %.4lf ns bins, not %.4lf\n", path, atof(bin_ns + 12),
+                        hist->bin_sec * 1e9);
+                status = -1;
+            }
+            continue;
+        }
+
+        double time, angle;
+        uint32_t group, row_shots, first;
+        int facet, pos = 0;
+        if (sscanf(line, "%lf,%u,%d,%lf,%u,%u,%n", &time, &group, &facet, &angle, &row_shots, &first, &pos) < 6 ||
+            pos == 0)
+        {
+            continue; // header row
+        }
+        shots += row_shots;
+        char* p = line + pos;
+        for (uint32_t b = first; b < hist->bins && *p >= '0' && *p <= '9'; b++)
+        {
+            counts[b] += strtoul(p, &p, 10);
+            if (*p == ';') p++;
+        }
+    }
+    if (status == 0 && (shots == 0 || shots > UINT32_MAX))
+    {
+        fprintf(stderr, "tofHistLoadReference: no usable histogram rows in %s\n", path);
+        status = -1;
+    }
+    if (status == 0)
+    {
+        tofHistSetReference(hist, counts, (uint32_t)shots);
+    }
+    free(line);
+    free(counts);
+    fclose(file);
+    return status;
+} // end tofHistLoadReference()
+
+double tofHistGroupAngle(const tof_hist_t* hist, uint32_t group)
+{
+    if (hist->facets == 0) return 0;
+    return hist->angle0_deg + ((group % hist->angle_bins) + 0.5) / hist->angle_scale;
+} // end tofHistGroupAngle()
+
+void tofHistPrintStats(tof_hist_t* hist, FILE* stream)
+{
+    fprintf(stream, "histograms: %u x %u bins of %.3lf ns, %llu windows, %llu stops binned, %llu outside range, "
+            "%llu returns", hist->groups, hist->bins, hist->bin_sec * 1e9, (unsigned long long)hist->windows,
+            (unsigned long long)hist->stops, (unsigned long long)hist->outside, (unsigned long long)hist->returns);
+    if (hist->facets > 0)
+    {
+        fprintf(stream, ", %llu shots without angle", (unsigned long long)hist->unplaced);
+    }
+    if (hist->overdue > 0)
+    {
+        fprintf(stream, ", %llu shots past a window's end", (unsigned long long)hist->overdue);
+    }
+    if (hist->ref_shots > 0)
+    {
+        uint64_t ref_total = 0;
+        for (uint32_t b = 0; b < hist->bins; b++) ref_total += hist->ref_counts[b];
+        fprintf(stream, ", dark reference of %u shots (%.4lf counts per shot)", hist->ref_shots,
+                (double)ref_total / hist->ref_shots);
+    }
+    fprintf(stream, "\n");
+} // end tofHistPrintStats()
+
+void tofHistDestroy(tof_hist_t* hist)
+{
+    if (hist == NULL) return;
+    free(hist->counts);
+    free(hist->shots);
+    free(hist->closed);
+    free(hist->closed_shots);
+    free(hist->dark);
+    free(hist->ref_counts);
+    free(hist->ref);
+    free(hist);
+} // end tofHistDestroy()
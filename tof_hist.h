@@ -0,0 +1,179 @@
+#ifndef _TOF_HIST_H_
+#define _TOF_HIST_H_
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#define HIST_MAX_PEAKS 4        // returns reported per histogram; the strongest are kept
+#define HIST_FALSE_ALARM 1e-3   // chance of a false return per histogram; split among the bins searched
+#define HIST_SCREEN_SIGMA 2.0   // bins closer than this to their background are not tested
+#define HIST_TAIL_TERMS 1000    // terms summed for a tail probability
+#define HIST_MERGE_BINS 2       // flagged bins separated by at most this many unflagged bins form one return
+#define HIST_CENTROID_BINS 2    // bins on each side of a return included in its centroid and width
+#define HIST_ROW_HEADER "TIMESTAMP (s),GROUP,FACET,ANGLE (deg),SHOTS,FIRST_BIN,COUNTS\n"
+#define HIST_ROW_MAX(bins) (96 + 11 * (size_t)(bins)) // longest histogram row
+
+/** Time-of-flight histograms.
+ *  With a single-photon detector most stops of a shot are dark counts or ambient photons,
+ *  while the real return lands in the same ToF bin shot after shot. Rather than logging every
+ *  stop, samples are accumulated TCSPC-style into ToF histograms and only the histograms and
+ *  the peaks found in them are emitted:
+ *    - per time window: one histogram of every shot in window_sec
+ *    - per scan angle: one histogram per facet and angle bin, each accumulating the shots
+ *      that fell into it during window_sec
+ *  Counts live in one contiguous array of 32-bit bins, one cache-line aligned row per
+ *  histogram, so adding a stop touches a single cache line.
+ *
+ *  When a sample's time passes the end of the window, the window's counts are swapped into a
+ *  second buffer and accumulation carries on in the first. Each tofHistAdd() passes at most one
+ *  histogram of the closed window that received shots to the emit function, with its returns,
+ *  and clears it, so the cost of closing a window is spread over the following shots instead of
+ *  stalling one of them for every histogram at once. A window has at most as many histograms
+ *  with shots as it had shots, so the next window normally has emitted them all well before it
+ *  ends; if it has not (fewer shots, e.g. after a rate change), it stays open past its end until
+ *  the last window is done, and the shots added meanwhile are counted in overdue.
+ *  The worst tofHistAdd() is therefore one tofHistPeaks() and clear of a bins-long histogram.
+ *  For the 4003 bins of tdc_test's 300 m range that took 8-10 us (median) on the x86 host it
+ *  was developed on; it has not been timed on a Pi. The worst single add hist_replay measured
+ *  there, preemption included, was 33-86 us against 67 us between shots at full rate. The
+ *  histogram sink reads a broadcast ring of 4096 samples, so such an add delays the sink, not
+ *  the shots.
+ *
+ *  Peaks are found against an expected background per bin:
+ *    - without a reference, the histogram's mean bin count
+ *    - with a dark-count reference (laser-off shots), the reference scaled to the histogram's
+ *      shots, so structured backgrounds such as detector afterpulsing or electrical pickup at a
+ *      fixed ToF are subtracted rather than reported as returns
+ *  A bin is flagged if background alone is unlikely to have given its counts. Counts are
+ *  Poisson, and what matters is the tail probability P(counts >= k):
+ *    - without a reference, of a Poisson count with the mean as its expectation
+ *    - with one, of the binomial split of the bin's live and reference counts between the
+ *      histogram's shots and the reference's, which counts the reference's own noise
+ *  Every bin of a histogram is searched, so the probability is tested against
+ *  HIST_FALSE_ALARM / bins (a Bonferroni correction): a histogram of background alone gives a
+ *  false return with a chance of at most HIST_FALSE_ALARM, whatever its bin count. Near-zero
+ *  backgrounds, where a Gaussian test would flag a bin for one or two stray counts, need
+ *  correspondingly more. Bins within HIST_SCREEN_SIGMA Gaussian sigmas of their background
+ *  cannot pass and are skipped without evaluating the tail.
+ *
+ *  Flagged bins no more than HIST_MERGE_BINS apart are clustered into one return (one target),
+ *  found in a single pass over the bins. Over the cluster and HIST_CENTROID_BINS on each side, a
+ *  return reports the centroid of the net counts, which resolves it well below one bin, their
+ *  sum (amplitude), whose total counts must pass the same test as a bin, and their RMS width; a
+ *  width well above the bin's own (bin / sqrt(12)) indicates targets closer than the merge
+ *  distance, or a surface inclined to the beam.
+ *
+ *  The reference is recorded with tofHistAddDark() and tofHistUseDark(), or loaded from a
+ *  histogram file (rows as written by tofHistSaveReference(), e.g. a laser-off run).
+ */
+
+typedef struct HistPeak {
+    double tof;                 // centroid ToF in seconds
+    double amplitude;           // net counts of the return
+    double width;               // RMS width of the net counts in seconds
+    uint32_t counts;            // counts in the return's bins
+    double background;          // expected background counts per bin at the return
+    double log_p;               // log10 of the chance that the background alone gives the return's counts
+} hist_peak_t;
+
+struct TofHist;
+
+/**Receives one histogram of a closed window starting at time start: group (0 when histograms are
+ * per window, else facet * angle_bins + angle bin), its counts, the shots that fell into it and
+ * its returns, strongest first.
+ */
+typedef void (*hist_emit_fn)(const struct TofHist* hist, double start, uint32_t group, const uint32_t* counts,
+                             uint32_t shots, const hist_peak_t* peaks, int npeaks, void* arg);
+
+typedef struct TofHist {
+    uint32_t bins;              // bins per histogram
+    uint32_t row;               // bins between consecutive histograms; rounded up to a cache line
+    double bin_sec;             // bin width
+    double tof_min;             // ToF at the start of bin 0
+    uint32_t facets;            // 0 for one histogram per window
+    uint32_t angle_bins;        // angle bins per facet
+    float angle0_deg;           // scan angle at the start of each facet
+    float angle_scale;          // angle bins per degree
+    uint32_t groups;            // histograms
+    uint32_t* counts;           // [groups][row]
+    uint32_t* shots;            // [groups] shots per histogram this window
+    double window_sec;
+    double window_start;        // sample time at which the current window opened
+    bool open;                  // a window has received samples
+    // closed window, emitted one histogram at a time
+    uint32_t* closed;           // [groups][row]
+    uint32_t* closed_shots;     // [groups]
+    double closed_start;
+    uint32_t next_group;        // next histogram of the closed window to emit; groups once done
+    uint64_t overdue;           // shots added to a window past its end while the last one was emitted
+    hist_emit_fn emit;
+    void* arg;
+    uint64_t windows;           // windows closed
+    uint64_t returns;           // returns emitted
+    uint64_t stops;             // stops binned
+    uint64_t outside;           // stops outside the histogram's ToF range
+    uint64_t unplaced;          // shots without a scan angle (per-angle histograms only)
+    // dark-count reference
+    uint32_t* dark;             // [bins] laser-off counts being recorded
+    uint32_t dark_shots;
+    uint32_t* ref_counts;       // [bins] counts of the reference in use
+    uint32_t ref_shots;         // 0 if there is no reference
+    float* ref;                 // [bins] reference counts per shot
+} tof_hist_t;
+
+/**Allocates histograms of bins bins of bin_sec from tof_min. With facets = 0 there is one
+ * histogram per window; otherwise there is one per facet and angle bin, the angle_bins bins
+ * splitting span_deg from angle0_deg. Returns NULL on failure.
+ */
+tof_hist_t* tofHistCreate(uint32_t bins, double bin_sec, double tof_min, double window_sec, uint32_t facets,
+                          uint32_t angle_bins, double angle0_deg, double span_deg, hist_emit_fn emit, void* arg);
+
+/**Adds one shot taken at time. has_stop is false for shots without a return; has_angle is
+ * false if the shot's scan angle is unknown. Emits at most one histogram of the last closed
+ * window, and closes the current window if time is past its end and the last one is done.
+ */
+void tofHistAdd(tof_hist_t* hist, double time, bool has_stop, double tof, bool has_angle, uint8_t facet,
+                float angle_deg);
+
+// Emits and clears the closed window, then the current window
+void tofHistFlush(tof_hist_t* hist);
+
+// Finds the max_peaks strongest returns in counts (bins long, from shots shots) as described above; returns how many
+int tofHistPeaks(const tof_hist_t* hist, const uint32_t* counts, uint32_t shots, hist_peak_t* peaks, int max_peaks);
+
+// Adds one shot taken with the laser off to the dark-count reference being recorded
+void tofHistAddDark(tof_hist_t* hist, bool has_stop, double tof);
+
+// Replaces the reference with the dark shots added since the last call. Returns 0 or -1 if there are none.
+int tofHistUseDark(tof_hist_t* hist);
+
+// Replaces the reference with counts (bins long) recorded over shots shots. Returns 0 or -1.
+int tofHistSetReference(tof_hist_t* hist, const uint32_t* counts, uint32_t shots);
+
+/**Writes the reference to path as one histogram row, preceded by a record of the binning.
+ * Returns 0 or -1.
+ */
+int tofHistSaveReference(const tof_hist_t* hist, const char* path);
+
+/**Sums every histogram row of path into the reference. Rows are those of a histogram file;
+ * a file whose records state a different bin width is rejected. Returns 0 or -1.
+ */
+int tofHistLoadReference(tof_hist_t* hist, const char* path);
+
+/**Formats one histogram as a row under HIST_ROW_HEADER: the nonzero span of counts as ';'-separated
+ * values from FIRST_BIN, FACET -1 and ANGLE -999 for per-window histograms. buf must hold
+ * HIST_ROW_MAX(hist->bins) characters. Returns the row length including the newline.
+ */
+int tofHistFormatRow(const tof_hist_t* hist, char* buf, double time, uint32_t group, const uint32_t* counts,
+                     uint32_t shots);
+
+// Scan angle at the centre of a histogram group; 0 for per-window histograms
+double tofHistGroupAngle(const tof_hist_t* hist, uint32_t group);
+
+void tofHistPrintStats(tof_hist_t* hist, FILE* stream);
+
+// Frees the histograms without emitting; call tofHistFlush() first to keep the last window
+void tofHistDestroy(tof_hist_t* hist);
+
+#endif